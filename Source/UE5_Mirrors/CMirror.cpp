@@ -1,7 +1,15 @@
 #include "CMirror.h"
 #include "MirrorSubsystem.h"
+#include "MirrorActorCommon.h"
+#include "MirrorCore.h"
+#include "MirrorProjection.h"
+#include "MirrorQualityController.h"
+#include "MirrorScreenCoverage.h"
+#include "MirrorStaticReflection.h"
 #include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Components/SceneCaptureComponent2D.h"
+#include "Engine/TextureRenderTarget2D.h"
 #include "Engine/TriggerBox.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMaterialLibrary.h"
@@ -17,6 +25,8 @@ ACMirror::ACMirror()
 
 	MirrorMesh = CreateDefaultSubobject<UStaticMeshComponent>("MirrorMesh");
 	MirrorMesh->SetupAttachment(GetRootComponent());
+	// Mirrors don't reflect each other. Hiding the surface from every scene capture keeps mirrors out of each other's hidden lists.
+	MirrorMesh->SetHiddenInSceneCapture(true);
 
 	SceneCapture = CreateDefaultSubobject<USceneCaptureComponent2D>("SceneCaptureLeftEye");
 	SceneCapture->SetupAttachment(GetRootComponent());
@@ -34,12 +44,23 @@ void ACMirror::Destroyed()
 {
 	Super::Destroyed();
 
-	if (const UGameInstance* GameInstance = GetGameInstance())
+	if (MirrorSubsystem)
 	{
-		if (UMirrorSubsystem* MirrorSubsystem = GameInstance->GetSubsystem<UMirrorSubsystem>())
+		MirrorSubsystem->OnMirrorDestroyed(this);
+
+		// A leader's members keep sampling its capture until the subsystem regroups them, the target is released only then.
+		if (IsCaptureGroupLeader())
+		{
+			MirrorSubsystem->ReleaseRenderTargetAfterRegroup(RenderTarget);
+		}
+		else
 		{
-			MirrorSubsystem->OnMirrorDestroyed(this);
+			MirrorSubsystem->ReleaseRenderTarget(RenderTarget);
 		}
+
+		MirrorSubsystem->ReleaseRenderTarget(StaticReflectionTarget);
+		RenderTarget = nullptr;
+		StaticReflectionTarget = nullptr;
 	}
 }
 
@@ -49,16 +70,24 @@ void ACMirror::BeginPlay()
 
 	if (const UGameInstance* GameInstance = GetGameInstance())
 	{
-		if (UMirrorSubsystem* MirrorSubsystem = GameInstance->GetSubsystem<UMirrorSubsystem>())
+		MirrorSubsystem = GameInstance->GetSubsystem<UMirrorSubsystem>();
+		if (MirrorSubsystem)
 		{
 			MirrorSubsystem->OnMirrorCreated(this);
 		}
 	}
 
+	StatNames.Init(this);
 	InitialCaptureQuality = CaptureQuality;
 	FindActiveCamera();
 	SetupCaptureTriggers();
 
+	// A moved tile may leave its wall or join another, so the subsystem groups the mirrors again.
+	if (bShareCoplanarCapture && MirrorSubsystem)
+	{
+		MirrorMesh->TransformUpdated.AddUObject(this, &ACMirror::OnCaptureSurfaceMoved);
+	}
+
 	if (bCullingEnabled)
 	{
 		SceneCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
@@ -90,7 +119,22 @@ void ACMirror::BeginPlay()
 void ACMirror::Tick(const float DeltaTime)
 {
 	Super::Tick(DeltaTime);
-	CaptureScene();
+
+	if (bEnableDynamicCaptureResolution && DynamicCaptureCheckInterval <= 0)
+	{
+		CheckDynamicResolution();
+	}
+
+	// The subsystem evaluates all mirrors together once every actor has ticked.
+	if (MirrorSubsystem)
+	{
+		MirrorSubsystem->QueueEvaluation(this);
+	}
+	else
+	{
+		EvaluateFrame();
+		SubmitFrame();
+	}
 
 	if (bDisplayNumOfActiveTriggers)
 	{
@@ -119,22 +163,79 @@ void ACMirror::Init()
 		}
 	}
 
-	const FVector2D RenderTargetResolution = CalcRenderTargetResolution();
-	RenderTarget = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetResolution.X,
-	                                                             RenderTargetResolution.Y);
-	SceneCapture->TextureTarget = RenderTarget;
+	AllocateRenderTarget();
+	CullingCache.Invalidate();
 	SceneCapture->FOVAngle = HorizontalFov;
 
 	if (MirrorMaterial)
 	{
 		MaterialInstanceDynamic = UKismetMaterialLibrary::CreateDynamicMaterialInstance(this, MirrorMaterial);
-		MaterialInstanceDynamic->SetTextureParameterValue("RenderTarget", RenderTarget);
+		SetCaptureMaterialParameters();
 		MirrorMesh->SetMaterial(0, MaterialInstanceDynamic);
 	}
 	else
 	{
 		GEngine->AddOnScreenDebugMessage(2, 5, FColor::Red, "MirrorMaterial not set?");
 	}
+
+	// The scene behind the mirror doesn't change on a viewport resize, so the static reflection is only captured once.
+	if (bUseStaticReflection && !StaticReflectionTarget)
+	{
+		CaptureStaticReflection();
+	}
+
+	SetStaticReflectionParameters();
+}
+
+void ACMirror::CaptureStaticReflection()
+{
+	if (!bUseStaticReflection || StaticReflectionTexture || !MirrorMesh->GetStaticMesh())
+	{
+		return;
+	}
+
+	if (!StaticReflectionTarget)
+	{
+		const FIntPoint Size = FMirrorStaticReflection::CalcResolution(MirrorMesh, StaticReflectionResolution);
+		StaticReflectionTarget = MirrorSubsystem
+			                         ? MirrorSubsystem->AcquireRenderTarget(Size.X, Size.Y)
+			                         : UKismetRenderingLibrary::CreateRenderTarget2D(this, Size.X, Size.Y);
+	}
+
+	const FTransform MirrorTransform(GetActorQuat(), MirrorMesh->Bounds.Origin);
+	FMirrorStaticReflection::Capture(SceneCapture, MirrorMesh, MirrorTransform, StaticReflectionViewDistance,
+	                                 StaticReflectionTarget);
+}
+
+void ACMirror::SetStaticReflectionParameters()
+{
+	if (!bUseStaticReflection || !MaterialInstanceDynamic)
+	{
+		return;
+	}
+
+	MaterialInstanceDynamic->SetTextureParameterValue(
+		"StaticReflection", StaticReflectionTexture ? StaticReflectionTexture.Get() : StaticReflectionTarget.Get());
+
+	// A new material instance starts out with the material's default blend.
+	StaticReflectionBlend = -1;
+	UpdateStaticReflectionBlend();
+}
+
+void ACMirror::UpdateStaticReflectionBlend()
+{
+	if (!bUseStaticReflection || !ActiveCamera || !MaterialInstanceDynamic)
+	{
+		return;
+	}
+
+	const float Distance = FVector::Dist(ActiveCamera->GetComponentLocation(), GetActorLocation());
+	const float Blend = FMirrorStaticReflection::CalcBlend(Distance, CaptureMaxDistance, StaticReflectionFadeDistance);
+	if (Blend != StaticReflectionBlend)
+	{
+		StaticReflectionBlend = Blend;
+		MaterialInstanceDynamic->SetScalarParameterValue("StaticReflectionBlend", Blend);
+	}
 }
 
 void ACMirror::FindActiveCamera()
@@ -200,42 +301,366 @@ void ACMirror::SetupCaptureTriggers()
 	}
 }
 
+void ACMirror::EvaluateFrame()
+{
+	FrameEvaluation.Frame = GFrameCounter;
+	FrameEvaluation.SkipReason = FindSkipReason();
+	if (FrameEvaluation.SkipReason != EMirrorSkipReason::None)
+	{
+		return;
+	}
+
+	CalcFrameView();
+	FrameEvaluation.bIsUnchanged = bSkipUnchangedCaptures && IsCaptureUnchanged(FrameEvaluation.MirroredCameraTransform);
+
+	const FBoxSphereBounds& MirrorBounds = MirrorMesh->Bounds;
+	const float DistanceToBounds = FVector::Dist(ActiveCamera->GetComponentLocation(), MirrorBounds.Origin) -
+		MirrorBounds.SphereRadius;
+
+	FMirrorCaptureRequest& Request = FrameEvaluation.Request;
+	Request.Mirror = this;
+	Request.Distance = FMath::Max(DistanceToBounds, 1.f);
+	Request.ProjectedSize = MirrorBounds.SphereRadius / Request.Distance;
+	Request.TimeSinceLastCapture = GetWorld()->GetTimeSeconds() - LastCaptureTime;
+	Request.Cost = RenderTarget ? RenderTarget->SizeX * RenderTarget->SizeY / 1000000.f : 0;
+}
+
+void ACMirror::SubmitFrame()
+{
+	TMirrorActorCommon<ACMirror>::SubmitFrame(*this);
+}
+
+FVector2D ACMirror::CalcViewFov() const
+{
+	return FVector2D(ActiveCamera->FieldOfView,
+	                 FMirrorScreenCoverage::CalcVerticalFov(ActiveCamera->FieldOfView, FVector2D(ActiveCamera->AspectRatio, 1)));
+}
+
+bool ACMirror::IsCaptureUnchanged(const FTransform& MirroredCameraTransform) const
+{
+	return ChangeDetector.IsUnchanged(MirroredCameraTransform, SceneCapture->ShowOnlyActors,
+	                                  SceneCapture->ShowOnlyComponents,
+	                                  UnchangedCameraLocationTolerance, UnchangedCameraRotationTolerance,
+	                                  MaxUnchangedCaptureSkipTime, GetWorld()->GetTimeSeconds());
+}
+
+void ACMirror::CalcFrameView()
+{
+	FrameEvaluation.ViewFrame = GFrameCounter;
+	FrameEvaluation.MirroredCameraTransform = TMirrorCore<1>::MirrorCamera(GetActorTransform(),
+	                                                                       ActiveCamera->GetComponentTransform());
+	if (bCullingEnabled)
+	{
+		CalcCullingFrustum(FrameEvaluation.MirroredCameraTransform.GetLocation(), FrameEvaluation.CullingPlanes,
+		                   FrameEvaluation.CullingCorners);
+	}
+}
+
 void ACMirror::CaptureScene()
 {
-	if (ShouldSkipCapture())
+	MIRROR_SCOPE_CYCLE_COUNTER(CaptureScene);
+	TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(*StatNames.TraceName);
+	FMirrorCsvCaptureScope CsvCaptureScope(StatNames);
+
+	if (!ActiveCamera || !MaterialInstanceDynamic)
 	{
 		return;
 	}
 
-	const FTransform MirroredCameraTransform = MirrorCamera(ActiveCamera->GetComponentTransform());
+	LastCaptureTime = GetWorld()->GetTimeSeconds();
+	AllocationCounter.BeginCapture(GetCaptureBuffersSize());
+
+	// The view is normally worked out by this frame's evaluation already.
+	if (FrameEvaluation.ViewFrame != GFrameCounter)
+	{
+		CalcFrameView();
+	}
+
+	const FTransform MirroredCameraTransform = FrameEvaluation.MirroredCameraTransform;
 	FVector MirroredCameraLocation = MirroredCameraTransform.GetLocation();
-	MirrorCulling(MirroredCameraLocation);
+	TMirrorActorCommon<ACMirror>::MirrorCulling(*this, MirroredCameraLocation, *SceneCapture);
+	QueueAsyncCulling(MirroredCameraLocation);
 
 	SceneCapture->ClipPlaneBase = GetActorLocation();
 	SceneCapture->ClipPlaneNormal = GetActorForwardVector();
-	SceneCapture->SetWorldTransform(MirroredCameraTransform);
+	SetCaptureView(MirroredCameraTransform);
 	SceneCapture->CaptureScene();
+
+	ChangeDetector.OnCaptured(MirroredCameraTransform, SceneCapture->ShowOnlyActors,
+	                          SceneCapture->ShowOnlyComponents, LastCaptureTime);
+
+	AllocationCounter.EndCapture(GetCaptureBuffersSize(), this);
+	FMirrorStats::CountCapture(SceneCapture->ShowOnlyActors.Num(), SceneCapture->ShowOnlyComponents.Num());
+}
+
+void ACMirror::AddRenderTargetStats() const
+{
+	FMirrorStats::AddRenderTargetMemory(RenderTarget);
+	FMirrorStats::AddRenderTargetMemory(StaticReflectionTarget);
+}
+
+SIZE_T ACMirror::GetCaptureBuffersSize() const
+{
+	return CullingScratch.GetAllocatedSize() + SceneCapture->ShowOnlyActors.GetAllocatedSize() +
+		SceneCapture->ShowOnlyComponents.GetAllocatedSize();
+}
+
+void ACMirror::SetCaptureView(const FTransform& MirroredCameraTransform)
+{
+	// Group members map their part of the capture with their mesh UVs, which only line up with the off-axis projection.
+	const bool bUseOffAxis = bUseOffAxisProjection || IsCaptureGroupLeader();
+	if (!bUseOffAxis && !bCaptureVisibleRegionOnly)
+	{
+		SceneCapture->bUseCustomProjectionMatrix = false;
+		SceneCapture->SetWorldTransform(MirroredCameraTransform);
+		return;
+	}
+
+	FVector MirrorCorners[4];
+	GetCaptureCorners(MirrorCorners);
+
+	FTransform ViewTransform = MirroredCameraTransform;
+	FMatrix Projection = FMirrorProjection::CalcPerspectiveProjection(HorizontalFov, ActiveCamera->AspectRatio);
+	if (bUseOffAxis)
+	{
+		// The off-axis view looks straight through the mirror, the projection then shifts it onto the mirror's corners.
+		const FTransform OffAxisViewTransform(GetActorQuat(), MirroredCameraTransform.GetLocation());
+		if (FMirrorProjection::CalcOffAxisProjection(OffAxisViewTransform, MirrorCorners, Projection))
+		{
+			ViewTransform = OffAxisViewTransform;
+		}
+	}
+
+	if (bCaptureVisibleRegionOnly)
+	{
+		const FVector2D CameraFov(ActiveCamera->FieldOfView,
+		                          FMirrorScreenCoverage::CalcVerticalFov(ActiveCamera->FieldOfView,
+		                                                                 FVector2D(ActiveCamera->AspectRatio, 1)));
+		const FBox2D VisibleRegion = FMirrorProjection::CalcVisibleRegion(ActiveCamera->GetComponentTransform(), CameraFov,
+		                                                                  MirrorCorners, ViewTransform, Projection);
+		SetCaptureRegion(FMirrorProjection::SnapRegion(VisibleRegion, VisibleRegionStep));
+		Projection = FMirrorProjection::CropProjection(Projection, CaptureRegion);
+	}
+
+	SceneCapture->bUseCustomProjectionMatrix = true;
+	SceneCapture->CustomProjectionMatrix = Projection;
+	SceneCapture->SetWorldTransform(ViewTransform);
+}
+
+void ACMirror::SetCaptureRegion(const FBox2D& Region)
+{
+	bool bSizeChanged = false;
+	if (!TMirrorActorCommon<ACMirror>::UpdateCaptureRegion(*this, Region, bSizeChanged))
+	{
+		return;
+	}
+
+	if (bSizeChanged)
+	{
+		ResizeRenderTarget();
+	}
+
+	UpdateCaptureMaterialParameters();
+}
+
+void ACMirror::SetCaptureMaterialParameters()
+{
+	if (!MaterialInstanceDynamic)
+	{
+		return;
+	}
+
+	// A group member samples its part of the leader's capture, the same way a mirror capturing on its own samples all of it.
+	const ACMirror* CaptureOwner = CaptureGroupLeader ? CaptureGroupLeader.Get() : this;
+	const FBox2D MaterialRegion = FMirrorCaptureGroups::CalcMaterialRegion(CaptureGroupRegion, CaptureOwner->CaptureRegion);
+	MaterialInstanceDynamic->SetTextureParameterValue("RenderTarget", CaptureOwner->RenderTarget);
+	MaterialInstanceDynamic->SetScalarParameterValue("bUseMeshUVs", bUseOffAxisProjection || CaptureGroupLeader);
+	MaterialInstanceDynamic->SetVectorParameterValue(
+		"CaptureRegion", FLinearColor(MaterialRegion.Min.X, MaterialRegion.Min.Y, MaterialRegion.Max.X, MaterialRegion.Max.Y));
+}
+
+void ACMirror::UpdateCaptureMaterialParameters()
+{
+	if (!IsCaptureGroupLeader())
+	{
+		SetCaptureMaterialParameters();
+		return;
+	}
+
+	for (ACMirror* Member : CaptureGroupMembers)
+	{
+		if (IsValid(Member))
+		{
+			Member->SetCaptureMaterialParameters();
+		}
+	}
+}
+
+bool ACMirror::GetCaptureGroupSurface(FMirrorCaptureGroupSurface& OutSurface) const
+{
+	if (!bShareCoplanarCapture || !MirrorMesh->GetStaticMesh())
+	{
+		return false;
+	}
+
+	OutSurface = FMirrorCaptureGroups::MakeSurface(GetActorQuat(), MirrorMesh);
+	return true;
+}
+
+void ACMirror::OnCaptureSurfaceMoved(USceneComponent*, EUpdateTransformFlags, ETeleportType)
+{
+	MirrorSubsystem->OnCaptureGroupSurfaceMoved();
+}
+
+bool ACMirror::SetCaptureGroup(ACMirror* Leader, const FBox2D& Region)
+{
+	if (Leader != this)
+	{
+		CaptureGroupMembers.Reset();
+	}
+
+	if (CaptureGroupLeader == Leader && CaptureGroupRegion == Region)
+	{
+		return false;
+	}
+
+	CaptureGroupLeader = Leader;
+	CaptureGroupRegion = Region;
+	return true;
 }
 
-FTransform ACMirror::MirrorCamera(const FTransform& CameraTransform) const
+bool ACMirror::LeadCaptureGroup(const TConstArrayView<ACMirror*> Members, const FVector (&Corners)[4])
 {
-	const FTransform ActorTransform = GetActorTransform();
-	FVector NewCameraLocation = ActorTransform.InverseTransformPosition(CameraTransform.GetLocation());
-	NewCameraLocation.X *= -1;
-	NewCameraLocation = ActorTransform.TransformPosition(NewCameraLocation);
+	bool bChanged = CaptureGroupMembers.Num() != Members.Num();
+	for (int32 Index = 0; Index < Members.Num() && !bChanged; Index++)
+	{
+		bChanged = CaptureGroupMembers[Index] != Members[Index];
+	}
+
+	for (int32 Corner = 0; Corner < 4; Corner++)
+	{
+		bChanged |= !CaptureGroupCorners[Corner].Equals(Corners[Corner]);
+		CaptureGroupCorners[Corner] = Corners[Corner];
+	}
+
+	CaptureGroupMembers.Reset(Members.Num());
+	for (ACMirror* Member : Members)
+	{
+		CaptureGroupMembers.Add(Member);
+	}
+
+	return bChanged;
+}
+
+void ACMirror::ApplyCaptureGroup()
+{
+	// The old region and culling results were made for a different capture.
+	CaptureRegion = FBox2D(FVector2D::ZeroVector, FVector2D::UnitVector);
+	CullingCache.Invalidate();
+
+	// Before Init there is nothing to move over yet, Init picks the group up.
+	if (!MaterialInstanceDynamic)
+	{
+		return;
+	}
+
+	AllocateRenderTarget();
+	UpdateCaptureMaterialParameters();
+}
+
+bool ACMirror::IsCaptureSurfaceRendered() const
+{
+	auto WasRecentlyRendered = [this](const UStaticMeshComponent* Surface)
+	{
+		return MirrorSubsystem ? MirrorSubsystem->WasRecentlyRendered(Surface) : Surface->WasRecentlyRendered();
+	};
 
-	const FVector ActorForward = ActorTransform.GetRotation().GetForwardVector();
-	const FVector CameraForward = CameraTransform.GetRotation().GetForwardVector();
-	const FVector CameraRight = CameraTransform.GetRotation().GetRightVector();
+	if (!IsCaptureGroupLeader())
+	{
+		return WasRecentlyRendered(MirrorMesh);
+	}
 
-	const FVector MirroredCamForward = FMath::GetReflectionVector(CameraForward, ActorForward);
-	const FVector MirroredCamRight = FMath::GetReflectionVector(CameraRight, ActorForward);
-	const FRotator NewCameraRotation = UKismetMathLibrary::MakeRotFromXY(MirroredCamForward, MirroredCamRight);
-	return FTransform(NewCameraRotation, NewCameraLocation);
+	return CaptureGroupMembers.ContainsByPredicate([&WasRecentlyRendered](const ACMirror* Member)
+	{
+		return IsValid(Member) && WasRecentlyRendered(Member->MirrorMesh);
+	});
+}
+
+void ACMirror::GetCaptureCorners(FVector (&OutCorners)[4]) const
+{
+	if (!IsCaptureGroupLeader())
+	{
+		FMirrorScreenCoverage::GetMirrorCorners(MirrorMesh, OutCorners);
+		return;
+	}
+
+	for (int32 Corner = 0; Corner < 4; Corner++)
+	{
+		OutCorners[Corner] = CaptureGroupCorners[Corner];
+	}
+}
+
+float ACMirror::CalcCaptureAspectRatio() const
+{
+	if (!IsCaptureGroupLeader())
+	{
+		return FMirrorProjection::CalcMirrorAspectRatio(MirrorMesh);
+	}
+
+	const float Height = FVector::Dist(CaptureGroupCorners[0], CaptureGroupCorners[3]);
+	return Height > KINDA_SMALL_NUMBER ? FVector::Dist(CaptureGroupCorners[0], CaptureGroupCorners[1]) / Height : 1;
+}
+
+void ACMirror::AllocateRenderTarget()
+{
+	// Group members show the leader's capture and don't keep a target of their own.
+	if (CaptureGroupLeader && !IsCaptureGroupLeader())
+	{
+		if (MirrorSubsystem)
+		{
+			MirrorSubsystem->ReleaseRenderTarget(RenderTarget);
+		}
+
+		RenderTarget = nullptr;
+		SceneCapture->TextureTarget = nullptr;
+		return;
+	}
+
+	const FVector2D RenderTargetResolution = CalcRenderTargetResolution();
+	if (MirrorSubsystem)
+	{
+		// Releasing first lets a same sized request get the old target straight back.
+		MirrorSubsystem->ReleaseRenderTarget(RenderTarget);
+		RenderTarget = MirrorSubsystem->AcquireRenderTarget(RenderTargetResolution.X, RenderTargetResolution.Y);
+	}
+	else
+	{
+		RenderTarget = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetResolution.X,
+		                                                             RenderTargetResolution.Y);
+	}
+
+	SceneCapture->TextureTarget = RenderTarget;
+	ChangeDetector.Reset();
+
+	// The members sample the new target from now on.
+	if (IsCaptureGroupLeader())
+	{
+		UpdateCaptureMaterialParameters();
+	}
 }
 
 FVector2D ACMirror::CalcRenderTargetResolution() const
 {
+	// Only the captured region of the full view gets texels.
+	const FVector2D RegionSize = bCaptureVisibleRegionOnly ? CaptureRegion.GetSize() : FVector2D::UnitVector;
+
+	if (bUseOffAxisProjection || IsCaptureGroupLeader())
+	{
+		// Every texel lands on the mirror, so the pixels of a full view capture are given the mirror's shape.
+		const float NumPixels = Resolution.X * Resolution.Y * FMath::Square(CaptureQuality * FrameBudgetScale);
+		return FMirrorProjection::FitToAspectRatio(NumPixels, CalcCaptureAspectRatio()) * RegionSize;
+	}
+
 	float RenderTargetWidth;
 	float RenderTargetHeight;
 
@@ -243,22 +668,78 @@ FVector2D ACMirror::CalcRenderTargetResolution() const
 	{
 		if (ActiveCamera->AspectRatio > 1)
 		{
-			RenderTargetWidth = Resolution.X * CaptureQuality;
+			RenderTargetWidth = Resolution.X * CaptureQuality * FrameBudgetScale;
 			RenderTargetHeight = RenderTargetWidth / ActiveCamera->AspectRatio;
 		}
 		else
 		{
-			RenderTargetHeight = Resolution.Y * CaptureQuality;
+			RenderTargetHeight = Resolution.Y * CaptureQuality * FrameBudgetScale;
 			RenderTargetWidth = RenderTargetHeight * ActiveCamera->AspectRatio;
 		}
 	}
 	else
 	{
-		RenderTargetWidth = Resolution.X * CaptureQuality;
-		RenderTargetHeight = Resolution.Y * CaptureQuality;
+		RenderTargetWidth = Resolution.X * CaptureQuality * FrameBudgetScale;
+		RenderTargetHeight = Resolution.Y * CaptureQuality * FrameBudgetScale;
+	}
+
+	return FVector2D(RenderTargetWidth, RenderTargetHeight) * RegionSize;
+}
+
+void ACMirror::ResizeRenderTarget()
+{
+	if (!RenderTarget)
+	{
+		AllocateRenderTarget();
+		return;
+	}
+
+	// The target object stays the same, so the material keeps pointing at it and nothing is left for garbage collection.
+	const FVector2D RenderTargetResolution = CalcRenderTargetResolution();
+	RenderTarget->ResizeTarget(FMath::Max(FMath::RoundToInt(RenderTargetResolution.X), 1),
+	                           FMath::Max(FMath::RoundToInt(RenderTargetResolution.Y), 1));
+	ChangeDetector.Reset();
+}
+
+float ACMirror::CalcScreenCoverageQuality() const
+{
+	if (Resolution.X <= 0 || Resolution.Y <= 0)
+	{
+		return InitialCaptureQuality;
 	}
 
-	return FVector2D(RenderTargetWidth, RenderTargetHeight);
+	FVector MirrorCorners[4];
+	GetCaptureCorners(MirrorCorners);
+
+	const FVector2D Fov(ActiveCamera->FieldOfView,
+	                    FMirrorScreenCoverage::CalcVerticalFov(ActiveCamera->FieldOfView, Resolution));
+	const float CoveredPixels = FMirrorScreenCoverage::CalcCoveredPixels(ActiveCamera->GetComponentTransform(),
+	                                                                     MirrorCorners, Fov, Resolution);
+
+	// The render target has quality squared times as many texels as the screen has pixels, over the captured region.
+	const float RegionArea = bCaptureVisibleRegionOnly ? FMath::Max(CaptureRegion.GetArea(), KINDA_SMALL_NUMBER) : 1;
+	const float Quality = FMath::Sqrt(CoveredPixels * ScreenCoverageTexelDensity /
+		(Resolution.X * Resolution.Y * RegionArea));
+	return FMath::Clamp(Quality, LowestDynamicCaptureQuality, InitialCaptureQuality);
+}
+
+void ACMirror::SetFrameBudgetScale(const float QualityScale)
+{
+	const float NewFrameBudgetScale = FMirrorQualityController::GetScaleForPriority(QualityScale, FrameBudgetPriority);
+
+	// Small changes are not worth resizing the render target for, except for getting back to full quality.
+	if (NewFrameBudgetScale == FrameBudgetScale ||
+		(FMath::Abs(NewFrameBudgetScale - FrameBudgetScale) < 0.05f && NewFrameBudgetScale < 1))
+	{
+		return;
+	}
+
+	FrameBudgetScale = NewFrameBudgetScale;
+	CullingCache.Invalidate();
+	if (RenderTarget)
+	{
+		ResizeRenderTarget();
+	}
 }
 
 void ACMirror::CheckDynamicResolution()
@@ -268,34 +749,31 @@ void ACMirror::CheckDynamicResolution()
 		return;
 	}
 
-	const float DistanceSquared = FVector::DistSquared(GetActorLocation(), ActiveCamera->GetComponentLocation());
-	const float DynamicCaptureRangeStartSquared = FMath::Square(DynamicCaptureRangeStart);
-	const float DynamicCaptureRangeEndSquared = FMath::Square(DynamicCaptureRangeEnd);
-
-	float NewCaptureQuality = UKismetMathLibrary::MapRangeClamped(DistanceSquared,
-	                                                              DynamicCaptureRangeStartSquared,
-	                                                              DynamicCaptureRangeEndSquared,
-	                                                              InitialCaptureQuality,
-	                                                              LowestDynamicCaptureQuality);
+	float NewCaptureQuality;
+	if (bUseScreenCoverage)
+	{
+		NewCaptureQuality = CalcScreenCoverageQuality();
+	}
+	else
+	{
+		const float DistanceSquared = FVector::DistSquared(GetActorLocation(), ActiveCamera->GetComponentLocation());
+		const float DynamicCaptureRangeStartSquared = FMath::Square(DynamicCaptureRangeStart);
+		const float DynamicCaptureRangeEndSquared = FMath::Square(DynamicCaptureRangeEnd);
+
+		NewCaptureQuality = UKismetMathLibrary::MapRangeClamped(DistanceSquared,
+		                                                        DynamicCaptureRangeStartSquared,
+		                                                        DynamicCaptureRangeEndSquared,
+		                                                        InitialCaptureQuality,
+		                                                        LowestDynamicCaptureQuality);
+	}
 
+	NewCaptureQuality = TMirrorCore<1>::StepCaptureQuality(NewCaptureQuality, CaptureQuality, InitialCaptureQuality,
+	                                                       DynamicCaptureQualityStep, DynamicCaptureQualityHysteresis);
 
-	NewCaptureQuality = FMath::TruncToFloat(NewCaptureQuality * 10) / 10;
 	if (CaptureQuality != NewCaptureQuality)
 	{
 		CaptureQuality = NewCaptureQuality;
-		const FVector2D RenderTargetResolution = CalcRenderTargetResolution();
-		RenderTarget = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetResolution.X,
-		                                                             RenderTargetResolution.Y);
-		SceneCapture->TextureTarget = RenderTarget;
-		if (MirrorMaterial)
-		{
-			MaterialInstanceDynamic->SetTextureParameterValue("RenderTarget", RenderTarget);
-		}
-
-		if (GEngine)
-		{
-			GEngine->ForceGarbageCollection();
-		}
+		ResizeRenderTarget();
 	}
 
 	if (bDisplayDynamicCaptureQuality)
@@ -306,160 +784,138 @@ void ACMirror::CheckDynamicResolution()
 	}
 }
 
-bool ACMirror::ShouldSkipCapture() const
+EMirrorSkipReason ACMirror::FindSkipReason() const
 {
-	if ((bIsUsingCaptureTriggers && NumActiveCaptureTriggers == 0) || !MirrorMesh->WasRecentlyRendered() || !
-		ActiveCamera || !MaterialInstanceDynamic)
+	if (bIsUsingCaptureTriggers && NumActiveCaptureTriggers == 0)
 	{
-		return true;
+		return EMirrorSkipReason::Triggers;
 	}
 
-	// Stop capturing if we are beyond specified max distance.
-	const float DistanceSquared = FVector::DistSquared(ActiveCamera->GetComponentLocation(), GetActorLocation());
-	if (DistanceSquared >= CaptureMaxDistance * CaptureMaxDistance)
+	if (!IsCaptureSurfaceRendered())
 	{
-		return true;
+		return EMirrorSkipReason::NotRendered;
 	}
 
-	// Stop capturing if the camera is behind the mirror.
-	const FVector MirrorToCameraLocal = GetActorTransform().InverseTransformPositionNoScale(
-		ActiveCamera->GetComponentLocation());
-	if (MirrorToCameraLocal.X <= 0)
+	// Members of a group show their leader's capture.
+	if (CaptureGroupLeader && !IsCaptureGroupLeader())
 	{
-		return true;
+		return EMirrorSkipReason::SharedCapture;
 	}
 
-	return false;
-}
+	if (!ActiveCamera || !MaterialInstanceDynamic)
+	{
+		return EMirrorSkipReason::NotReady;
+	}
 
-void ACMirror::MirrorCulling(FVector& MirroredCameraLocation)
-{
-	if (!bCullingEnabled)
+	// Stop capturing if we are beyond specified max distance or behind the mirror.
+	const FVector CameraLocation = ActiveCamera->GetComponentLocation();
+	if (!IsCameraInCaptureDistance(CameraLocation))
 	{
-		return;
+		return EMirrorSkipReason::Distance;
 	}
 
-	FVector MirrorLocation = MirrorMesh->GetComponentLocation();
-	FVector Min;
-	FVector Max;
-	MirrorMesh->GetLocalBounds(Min, Max);
-
-	float MirrorHalfWidth = Max.Y * MirrorMesh->GetComponentScale().Y * MirrorCullingBufferMultiplier;
-	float MirrorHalfHeight = Max.Z * MirrorMesh->GetComponentScale().Z * MirrorCullingBufferMultiplier;
-
-	FVector MirrorTop = MirrorLocation + GetActorUpVector() * MirrorHalfHeight;
-	FVector MirrorBottom = MirrorLocation + GetActorUpVector() * -1 * MirrorHalfHeight;
-
-	FVector MirrorTopLeft = MirrorTop - GetActorRightVector() * MirrorHalfWidth;
-	FVector MirrorTopRight = MirrorTop + GetActorRightVector() * MirrorHalfWidth;
-	FVector MirrorBottomLeft = MirrorBottom - GetActorRightVector() * MirrorHalfWidth;
-	FVector MirrorBottomRight = MirrorBottom + GetActorRightVector() * MirrorHalfWidth;
-
-	FVector CaptureToTopLeft = (MirrorTopLeft - MirroredCameraLocation).GetSafeNormal();
-	FVector CaptureToTopRight = (MirrorTopRight - MirroredCameraLocation).GetSafeNormal();
-	FVector CaptureToBottomLeft = (MirrorBottomLeft - MirroredCameraLocation).GetSafeNormal();
-	FVector CaptureToBottomRight = (MirrorBottomRight - MirroredCameraLocation).GetSafeNormal();
-	FVector CaptureToMirror = (MirrorLocation - MirroredCameraLocation).GetSafeNormal();
-
-	//Close plane
-	FVector ClosePlaneNormal = MirrorMesh->GetForwardVector();
-	float ClosePlaneW = FVector::DotProduct(ClosePlaneNormal, MirrorTopLeft);
-	FPlane FrustumClosePlane = FPlane(ClosePlaneNormal.X, ClosePlaneNormal.Y, ClosePlaneNormal.Z, ClosePlaneW);
-
-	//Far plane
-	float FrustumDistance = MirrorCullingTraceDistance;
-	FVector FarPlanePoint = MirrorLocation + CaptureToMirror * FrustumDistance;
-	FVector FarPlaneNormal = CaptureToMirror * -1;
-	float FarPlaneW = FVector::DotProduct(FarPlaneNormal, FarPlanePoint);
-	FPlane FrustumFarPlane = FPlane(FarPlaneNormal.X, FarPlaneNormal.Y, FarPlaneNormal.Z, FarPlaneW);
-
-	// Top Plane
-	FVector TopPlaneNormal = FVector::CrossProduct(CaptureToTopRight, CaptureToTopLeft).GetSafeNormal();
-	float TopPlaneW = FVector::DotProduct(TopPlaneNormal, MirrorTopLeft);
-	FPlane FrustumTopPlane = FPlane(TopPlaneNormal.X, TopPlaneNormal.Y, TopPlaneNormal.Z, TopPlaneW);
-
-	// // Bottom Plane
-	FVector BottomPlaneNormal = FVector::CrossProduct(CaptureToBottomLeft, CaptureToBottomRight).GetSafeNormal();
-	float BottomPlaneW = FVector::DotProduct(BottomPlaneNormal, MirrorBottomLeft);
-	FPlane FrustumBottomPlane = FPlane(BottomPlaneNormal.X, BottomPlaneNormal.Y, BottomPlaneNormal.Z, BottomPlaneW);
-
-	// Left Plane
-	FVector LeftPlaneNormal = FVector::CrossProduct(CaptureToTopLeft, CaptureToBottomLeft).GetSafeNormal();
-	float LeftPlaneW = FVector::DotProduct(LeftPlaneNormal, MirrorTopLeft);
-	FPlane FrustumLeftPlane = FPlane(LeftPlaneNormal.X, LeftPlaneNormal.Y, LeftPlaneNormal.Z, LeftPlaneW);
-
-	// Right Plane
-	FVector RightPlaneNormal = FVector::CrossProduct(CaptureToBottomRight, CaptureToTopRight).GetSafeNormal();
-	float RightPlaneW = FVector::DotProduct(RightPlaneNormal, MirrorTopRight);
-	FPlane FrustumRightPlane = FPlane(RightPlaneNormal.X, RightPlaneNormal.Y, RightPlaneNormal.Z, RightPlaneW);
-
-	TArray<FPlane*> FrustumPlanes{
-		&FrustumClosePlane, &FrustumFarPlane, &FrustumTopPlane, &FrustumBottomPlane, &FrustumLeftPlane,
-		&FrustumRightPlane
-	};
+	return TMirrorCore<1>::IsCameraInFrontOfMirror(GetActorTransform(), CameraLocation, 0)
+		       ? EMirrorSkipReason::None
+		       : EMirrorSkipReason::BehindMirror;
+}
 
-	float CaptureToMirrorDist = FVector::Dist(MirroredCameraLocation, MirrorLocation);
-	float WidthAtFarPlane = UKismetMathLibrary::DegTan(HorizontalFov / 2) * (CaptureToMirrorDist +
-		FrustumDistance) * 2;
+bool ACMirror::IsCameraInCaptureDistance(const FVector& CameraLocation) const
+{
+	if (!IsCaptureGroupLeader())
+	{
+		return TMirrorCore<1>::IsCameraInCaptureDistance(GetActorTransform(), CameraLocation, CaptureMaxDistance);
+	}
 
-	if (bShowCullingPlanes)
+	// The leader captures for the whole group, so the group keeps capturing while the camera is close to any of its mirrors.
+	for (const ACMirror* Member : CaptureGroupMembers)
 	{
-		for (const FPlane* Plane : FrustumPlanes)
+		if (IsValid(Member) &&
+			TMirrorCore<1>::IsCameraInCaptureDistance(Member->GetActorTransform(), CameraLocation, CaptureMaxDistance))
 		{
-			DrawDebugSolidPlane(GetWorld(), *Plane, MirrorLocation, 2000,
-			                    FColor::Red.WithAlpha(60));
+			return true;
 		}
 	}
 
-	TArray<FHitResult> HitResults;
-	TArray<AActor*> ActorsToIgnore;
-	FVector End = MirrorLocation + SceneCapture->GetForwardVector() * FrustumDistance;
-
-	LastTraceCameraPosition = ActiveCamera->GetComponentLocation();
-	UKismetSystemLibrary::BoxTraceMulti(this, MirrorLocation,
-	                                    End, FVector(100, WidthAtFarPlane / 2, WidthAtFarPlane / 2),
-	                                    SceneCapture->GetComponentRotation(),
-	                                    UEngineTypes::ConvertToTraceType(MirrorCullingTraceChannel), false,
-	                                    ActorsToIgnore,
-	                                    EDrawDebugTrace::None, HitResults, true);
+	return false;
+}
 
-	SceneCapture->ShowOnlyActors.Empty();
-	TSet<AActor*> HandledActors;
-	for (const FHitResult& HitResult : HitResults)
+void ACMirror::QueueAsyncCulling(const FVector& MirroredCameraLocation)
+{
+	if (!bCullingEnabled || !bAsyncCulling || !MirrorSubsystem)
 	{
-		AActor* Actor = HitResult.GetActor();
-		if (HandledActors.Contains(Actor))
-		{
-			continue;
-		}
+		return;
+	}
 
-		const auto& Sphere = HitResult.GetComponent()->Bounds.GetSphere();
-		bool ShouldRender = true;
+	// Expect the camera to keep the velocity it had since the last frame. Without a capture last frame, or after a cut, expect it to stay.
+	const bool bHasVelocity = LastCullingFrame + 1 == GFrameCounter && !IsCameraCut();
+	const FVector PredictedLocation = bHasVelocity
+		                                  ? MirroredCameraLocation + (MirroredCameraLocation - LastMirroredCameraLocation)
+		                                  : MirroredCameraLocation;
+	LastMirroredCameraLocation = MirroredCameraLocation;
+	LastCullingFrame = GFrameCounter;
+
+	FMirrorCullingQuery& Query = MirrorSubsystem->QueueAsyncCulling(this);
+	FVector MirrorCorners[4];
+	CalcCullingFrustum(PredictedLocation, Query.Planes, MirrorCorners);
+	Query.MirroredCameraLocation = PredictedLocation;
+	Query.bUseBoxes = bCullWithBoxes;
+	Query.bMovableOnly = FindBakedCell(PredictedLocation) != nullptr;
+}
 
-		for (const FPlane* Plane : FrustumPlanes)
-		{
-			const float Distance = Plane->PlaneDot(Sphere.Center);
+const FMirrorVisibleSetCell* ACMirror::FindBakedCell(const FVector& MirroredCameraLocation) const
+{
+	// The sets were baked with this mirror's frustum alone. A group leader culls for the whole group, which sees more.
+	if (!bUseBakedVisibleSets || !VisibleSets.IsBaked() || IsCaptureGroupLeader())
+	{
+		return nullptr;
+	}
 
-			// If a component of an actor is outside of at least one plane by more than its bound's sphere radius, then we assume the actor is not visible in the reflection for now.
-			if (Distance < -Sphere.W)
-			{
-				ShouldRender = false;
-				break;
-			}
-		}
+	return VisibleSets.FindCell(VisibleSets.CalcCell(GetActorTransform(), MirroredCameraLocation));
+}
 
-		// If a component is visible, mark the owning actor as visible and add it to HandledActors to skip further checks for it.
-		if (ShouldRender)
-		{
-			SceneCapture->ShowOnlyActors.Add(Actor);
-			HandledActors.Add(Actor);
-		}
-	}
+bool ACMirror::IsCameraCut() const
+{
+	return PlayerController && PlayerController->PlayerCameraManager &&
+		PlayerController->PlayerCameraManager->bGameCameraCutThisFrame;
+}
 
-	for (auto Actor : DontCullActors)
+void ACMirror::CalcCullingFrustum(const FVector& MirroredCameraLocation, TArray<FPlane, TInlineAllocator<6>>& OutPlanes,
+                                  FVector (&OutCorners)[4]) const
+{
+	FVector2D MirrorHalfSize;
+	FVector MirrorCenter;
+	if (IsCaptureGroupLeader())
 	{
-		SceneCapture->ShowOnlyActors.Add(Actor);
+		// The frustum has to take in everything the group's other mirrors reflect too.
+		MirrorHalfSize = FVector2D(FVector::Dist(CaptureGroupCorners[0], CaptureGroupCorners[1]),
+		                           FVector::Dist(CaptureGroupCorners[0], CaptureGroupCorners[3])) / 2;
+		MirrorCenter = (CaptureGroupCorners[0] + CaptureGroupCorners[2]) / 2;
 	}
+	else
+	{
+		FVector Min;
+		FVector Max;
+		MirrorMesh->GetLocalBounds(Min, Max);
+
+		const FVector MirrorScale = MirrorMesh->GetComponentScale();
+		MirrorHalfSize = FVector2D(Max.Y * MirrorScale.Y, Max.Z * MirrorScale.Z);
+		MirrorCenter = MirrorMesh->GetComponentLocation();
+	}
+
+	MirrorHalfSize *= MirrorCullingBufferMultiplier;
+	const FTransform MirrorTransform(GetActorQuat(), MirrorCenter);
+	TMirrorCore<1>::CalcCullingFrustum(MirrorTransform, MirrorHalfSize, MirroredCameraLocation, 0,
+	                                   MirrorCullingTraceDistance * FrameBudgetScale, OutPlanes, OutCorners);
+}
+
+void ACMirror::BakeVisibleSets()
+{
+	TMirrorActorCommon<ACMirror>::BakeVisibleSets(
+		*this, [this](const FVector& MirroredCameraLocation, TArray<FPlane, TInlineAllocator<6>>& OutPlanes,
+		              FVector (&OutCorners)[4])
+		{
+			CalcCullingFrustum(MirroredCameraLocation, OutPlanes, OutCorners);
+		});
 }
 
 void ACMirror::OnCaptureTriggerBeginOverlap(AActor* OverlappedActor, AActor* OtherActor)
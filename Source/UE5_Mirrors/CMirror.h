@@ -2,10 +2,21 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "MirrorCaptureGroups.h"
+#include "MirrorCaptureScheduler.h"
+#include "MirrorChangeDetector.h"
+#include "MirrorCullingCache.h"
+#include "MirrorScratchBuffers.h"
+#include "MirrorStats.h"
+#include "MirrorVisibleSets.h"
 #include "CMirror.generated.h"
 
 class ATriggerBox;
 class UCameraComponent;
+class UMirrorSubsystem;
+class UTexture;
+template <typename MirrorType>
+class TMirrorActorCommon;
 
 UCLASS()
 
@@ -18,6 +29,42 @@ public:
 	virtual void Tick(const float DeltaTime) override;
 	void Init();
 
+	// Render the reflection. Called by the mirror subsystem once this mirror's capture request fits into the frame budget.
+	void CaptureScene();
+
+	// Decide on this frame's capture and work out its view. Only reads the scene, so the subsystem evaluates all mirrors in parallel.
+	void EvaluateFrame();
+
+	// Queue the capture decided on by EvaluateFrame. Game thread only.
+	void SubmitFrame();
+
+	// Called by the subsystem's frame budget. Scales capture resolution and culling distance, weighted by FrameBudgetPriority.
+	void SetFrameBudgetScale(float QualityScale);
+
+	// Adds this mirror's render targets to the render target memory of stat Mirrors.
+	void AddRenderTargetStats() const;
+
+	// The surface coplanar mirrors are grouped by. False if this mirror doesn't share its capture.
+	bool GetCaptureGroupSurface(FMirrorCaptureGroupSurface& OutSurface) const;
+
+	// Called by the subsystem as it groups coplanar mirrors. Region is where this mirror's surface lies in the leader's capture, in UV space.
+	// A null leader lets the mirror capture on its own again. Returns true if the group changed, which is then applied with ApplyCaptureGroup
+	// once every mirror of the group has been set.
+	bool SetCaptureGroup(ACMirror* Leader, const FBox2D& Region);
+
+	// Called on the leader of a group, before its members are set. Corners are the combined surface of all members.
+	bool LeadCaptureGroup(TConstArrayView<ACMirror*> Members, const FVector (&Corners)[4]);
+
+	void ApplyCaptureGroup();
+
+	// Record the static actors that can appear in this mirror for every camera cell in VisibleSetBakeExtent. Bake again after moving the mirror or changing the level.
+	UFUNCTION(CallInEditor)
+	void BakeVisibleSets();
+
+	// Capture the static reflection again, for instance after the scene behind the mirror changed. Does nothing with a baked StaticReflectionTexture.
+	UFUNCTION(BlueprintCallable)
+	void CaptureStaticReflection();
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	TObjectPtr<USceneCaptureComponent2D> SceneCapture;
 
@@ -35,11 +82,7 @@ protected:
 	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled), DisplayName="Display culling planes")
 	bool bShowCullingPlanes = false;
 
-	// Trace channel for mirror culling. Select your custom trace channel.
-	UPROPERTY(EditAnywhere)
-	TEnumAsByte<ECollisionChannel> MirrorCullingTraceChannel;
-
-	// How far will the mirror scan for objects that will be rendered.
+	// How far behind the mirror objects are still rendered. Everything beyond is culled.
 	UPROPERTY(EditAnywhere)
 	float MirrorCullingTraceDistance = 10000;
 
@@ -47,10 +90,80 @@ protected:
 	UPROPERTY(EditAnywhere, meta=(ClampMin=1, ClampMax=2))
 	float MirrorCullingBufferMultiplier = 1;
 
-	// Use this for far away actors which might not be hit by the trace. Skybox is a good example.
+	// Show only the visible components of an actor instead of the whole actor once one of its components is visible.
+	// Large actors made of many components, like buildings built from a modular kit, then only render their visible parts.
+	// Baked visible sets store components instead of actors when baked with this set, rebake them after changing it.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	bool bCullPerComponent = false;
+
+	// Test objects with their bounding boxes instead of bounding spheres. Culls more objects at a slightly higher cost.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	bool bCullWithBoxes = true;
+
+	// Reuse the culling result while the mirrored camera stays within a cell of this size in centimeters. 0 to cull on every capture.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled, ClampMin=0))
+	float CullingCacheCellSize = 25;
+
+	// Cached culling results older than this many seconds are refreshed. Primitives moving inside the reflected volume refresh them right away. 0 to keep them until the camera changes cell.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled, ClampMin=0))
+	float CullingCacheMaxAge = 0.5;
+
+	// Take static actors from the baked visible sets instead of querying for them. Movable actors are still culled on every capture.
+	// Cameras outside the baked region fall back to regular culling. Static actors spawned at runtime are not part of the sets.
+	// A mirror leading a shared coplanar capture culls regularly too, its sets only cover its own surface.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	bool bUseBakedVisibleSets = true;
+
+	// Region in front of the mirror that BakeVisibleSets samples camera locations in. X is the distance from the mirror, Y and Z are half the width and height around its center.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	FVector VisibleSetBakeExtent = FVector(2000, 1000, 300);
+
+	// Edge length of the baked camera cells in centimeters. Smaller cells cull more but take longer to bake and store more.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled, ClampMin=10))
+	float VisibleSetCellSize = 100;
+
+	UPROPERTY()
+	FMirrorVisibleSets VisibleSets;
+
+	// Run the culling query for the next capture on a worker thread, from where the mirrored camera is expected to be by then.
+	// Captures on camera cuts, or with the camera further than AsyncCullingTolerance from the prediction, are culled right away instead.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	bool bAsyncCulling = false;
+
+	// How far in centimeters the mirrored camera may end up from its predicted location for the async result to be used.
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bCullingEnabled && bAsyncCulling", ClampMin=0))
+	float AsyncCullingTolerance = 25;
+
+	// Use this for far away actors which are beyond the culling distance. Skybox is a good example.
 	UPROPERTY(EditAnywhere)
 	TArray<AActor*> DontCullActors;
 
+	// Fit the capture's projection to the mirror's corners, so it only renders what the mirror shows. The render target takes the mirror's aspect ratio.
+	// The mirror material has to sample the capture with the mesh UVs while the bUseMeshUVs parameter is set.
+	// Pair it with screen coverage dynamic resolution, so the capture gets no more texels than the mirror covers on screen.
+	UPROPERTY(EditAnywhere)
+	bool bUseOffAxisProjection = false;
+
+	// Share one capture with the other mirrors of a wall built from tiles on the same plane, which all need this set too.
+	// The tile closest to the middle of the wall captures for all of them with its own settings and the off-axis projection over the whole wall.
+	// Every tile samples its part of that capture with the mesh UVs and the CaptureRegion parameter, like an off-axis capture of its own.
+	// Moving a tile groups the tiles again, which reallocates the changed groups' captures, so tiles that move every frame shouldn't share.
+	UPROPERTY(EditAnywhere)
+	bool bShareCoplanarCapture = false;
+
+	// Only capture the part of the mirror that is on screen, so the capture cost follows how much of the mirror the camera sees.
+	// The render target then holds that region of the full capture. The mirror material has to remap its capture UVs with the CaptureRegion parameter.
+	UPROPERTY(EditAnywhere)
+	bool bCaptureVisibleRegionOnly = false;
+
+	// The captured region grows to multiples of this fraction of the full capture, which limits how often the render target is resized.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCaptureVisibleRegionOnly, ClampMin=0.01, ClampMax=1))
+	float VisibleRegionStep = 0.125;
+
+	// Number of captures the visible region has to stay smaller before the render target shrink. Growing is immediate.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCaptureVisibleRegionOnly, ClampMin=0))
+	int32 VisibleRegionShrinkDelay = 30;
+
 	// Resolution capture multiplier. 1 for full resolution capture.
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta=(ClampMin=0.1, ClampMax=1))
 	float CaptureQuality = 1;
@@ -59,31 +172,90 @@ protected:
 	UPROPERTY(EditAnywhere)
 	float CaptureMaxDistance = 5000;
 
+	// Show a static reflection instead of the live capture on distant mirrors, which stop capturing beyond CaptureMaxDistance.
+	// The mirror material has to sample the StaticReflection parameter with the mesh UVs and blend it in by StaticReflectionBlend.
+	UPROPERTY(EditAnywhere)
+	bool bUseStaticReflection = false;
+
+	// Reflection baked offline, mapped onto the mesh UVs. Without one the mirror captures its own when it initializes.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bUseStaticReflection))
+	TObjectPtr<UTexture> StaticReflectionTexture;
+
+	// Distance before CaptureMaxDistance over which the live capture fades into the static reflection. 0 to switch at once.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bUseStaticReflection, ClampMin=0))
+	float StaticReflectionFadeDistance = 500;
+
+	// How far in front of the mirror the static reflection is captured from, looking straight at the mirror.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bUseStaticReflection, ClampMin=1))
+	float StaticReflectionViewDistance = 300;
+
+	// Pixels along the longer side of the captured static reflection.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bUseStaticReflection, ClampMin=16, ClampMax=4096))
+	int32 StaticReflectionResolution = 512;
+
+	// Skip captures while neither the mirrored camera nor any actor in the show only list has moved or changed visibility since the last capture.
+	UPROPERTY(EditAnywhere)
+	bool bSkipUnchangedCaptures = false;
+
+	// Mirrored camera movement in centimeters that is still considered unchanged.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bSkipUnchangedCaptures, ClampMin=0))
+	float UnchangedCameraLocationTolerance = 0.1;
+
+	// Mirrored camera rotation in degrees that is still considered unchanged.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bSkipUnchangedCaptures, ClampMin=0))
+	float UnchangedCameraRotationTolerance = 0.05;
+
+	// Capture at least this often in seconds even if nothing changed. Without culling there is no show only list, so this is what picks up moving actors.
+	// With culling, actors entering the reflected volume are picked up right away.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bSkipUnchangedCaptures, ClampMin=0.01))
+	float MaxUnchangedCaptureSkipTime = 0.25;
+
 	// Will decrease capture resolution as camera gets further from the mirror.
 	UPROPERTY(EditAnywhere)
 	bool bEnableDynamicCaptureResolution = false;
 
-	// How often do we check and adjust the capture resolution in seconds.
+	// Base the capture resolution on how many screen pixels the mirror covers instead of its distance to the camera.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution))
+	bool bUseScreenCoverage = true;
+
+	// Render target texels per screen pixel covered by the mirror.
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bEnableDynamicCaptureResolution && bUseScreenCoverage", ClampMin=0.1))
+	float ScreenCoverageTexelDensity = 1;
+
+	// How often do we check and adjust the capture resolution in seconds. 0 to check every frame.
 	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution, ClampMin=0))
 	float DynamicCaptureCheckInterval = 1;
 
-	// Capture resolution will reach this quality at DynamicCaptureRangeEnd.
+	// Capture quality changes in steps of this size. Each change resizes the render target, which reallocates its texture.
+	// 0 to adjust it continuously, in changes of at least 5% so a check every frame doesn't reallocate on every frame.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution, ClampMin=0, ClampMax=0.5))
+	float DynamicCaptureQualityStep = 0.1;
+
+	// How far past the current quality step the target quality has to go before the resolution changes.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution, ClampMin=0, ClampMax=0.5))
+	float DynamicCaptureQualityHysteresis = 0.05;
+
+	// Capture resolution will never go below this quality. Without screen coverage it is reached at DynamicCaptureRangeEnd.
 	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution, ClampMin=0.1))
 	float LowestDynamicCaptureQuality = 0.5;
 
 	// Capture resolution will be at maximum quality within this distance.
-	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution))
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bEnableDynamicCaptureResolution && !bUseScreenCoverage"))
 	float DynamicCaptureRangeStart = 500;
 
 	// Capture resolution will be at lowest quality at and beyond this distance.
-	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution))
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bEnableDynamicCaptureResolution && !bUseScreenCoverage"))
 	float DynamicCaptureRangeEnd = 2500;
 	
 	// Capture resolution will be at lowest quality at and beyond this distance.
 	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution))
 	bool bDisplayDynamicCaptureQuality = false;
 
-	// Mirror will capture as long as we are within one of these boxes.
+	// Mirrors with a higher priority lose less quality when the subsystem's frame budget is exceeded.
+	UPROPERTY(EditAnywhere, meta=(ClampMin=0.1))
+	float FrameBudgetPriority = 1;
+
+	// Mirror will capture as long as we are within one of these boxes. Mirror zones and portals gate many mirrors at once without overlap events.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	TArray<TObjectPtr<ATriggerBox>> CaptureTriggers;
 
@@ -97,6 +269,9 @@ protected:
 	UPROPERTY()
 	TObjectPtr<UTextureRenderTarget2D> RenderTarget;
 
+	UPROPERTY()
+	TObjectPtr<UTextureRenderTarget2D> StaticReflectionTarget;
+
 	UPROPERTY()
 	TObjectPtr<UMaterialInstanceDynamic> MaterialInstanceDynamic;
 
@@ -107,22 +282,83 @@ protected:
 	TObjectPtr<UMaterial> MirrorMaterial;
 
 private:
+	// Times the private culling and skip paths on spawned mirrors.
+	friend class FMirrorBenchmark;
+	friend class TMirrorActorCommon<ACMirror>;
+
 	virtual void Destroyed() override;
 	void OnViewportResize(FViewport* Viewport, uint32);
-	void CaptureScene();
+	void OnCaptureSurfaceMoved(USceneComponent*, EUpdateTransformFlags, ETeleportType);
+	bool IsCaptureUnchanged(const FTransform& MirroredCameraTransform) const;
+	void CalcFrameView();
+	FVector2D CalcViewFov() const;
 	void CheckDynamicResolution();
-	void MirrorCulling(FVector& MirroredCameraLocation);
-	bool ShouldSkipCapture() const;
-	FTransform MirrorCamera(const FTransform& CameraTransform) const;
+	float CalcScreenCoverageQuality() const;
+	void CalcCullingFrustum(const FVector& MirroredCameraLocation, TArray<FPlane, TInlineAllocator<6>>& OutPlanes,
+	                        FVector (&OutCorners)[4]) const;
+	void QueueAsyncCulling(const FVector& MirroredCameraLocation);
+	const FMirrorVisibleSetCell* FindBakedCell(const FVector& MirroredCameraLocation) const;
+	bool IsCameraCut() const;
+	SIZE_T GetCaptureBuffersSize() const;
+	EMirrorSkipReason FindSkipReason() const;
+	bool IsCameraInCaptureDistance(const FVector& CameraLocation) const;
+	void SetCaptureView(const FTransform& MirroredCameraTransform);
+	void SetCaptureRegion(const FBox2D& Region);
+	void SetCaptureMaterialParameters();
+	void UpdateCaptureMaterialParameters();
+	bool IsCaptureGroupLeader() const { return CaptureGroupLeader.Get() == this; }
+	bool IsCaptureSurfaceRendered() const;
+	void GetCaptureCorners(FVector (&OutCorners)[4]) const;
+	float CalcCaptureAspectRatio() const;
+	void SetStaticReflectionParameters();
+	void UpdateStaticReflectionBlend();
+	void AllocateRenderTarget();
+	void ResizeRenderTarget();
 	FVector2D CalcRenderTargetResolution() const;
 	void FindActiveCamera();
 	void SetupCaptureTriggers();
 
 	float InitialCaptureQuality;
 	int32 HorizontalFov;
-	FVector LastTraceCameraPosition = FVector::ZeroVector;
 	bool bIsUsingCaptureTriggers = false;
 	int32 NumActiveCaptureTriggers = 0;
+	float LastCaptureTime = 0;
+	float FrameBudgetScale = 1;
+
+	// Region of the full capture that the render target holds, in UV space.
+	FBox2D CaptureRegion = FBox2D(FVector2D::ZeroVector, FVector2D::UnitVector);
+	int32 NumSmallerRegionCaptures = 0;
+	FMirrorChangeDetector ChangeDetector;
+
+	// Region of the leader's full capture that this mirror's surface covers, in UV space. The whole capture while capturing on its own.
+	FBox2D CaptureGroupRegion = FBox2D(FVector2D::ZeroVector, FVector2D::UnitVector);
+
+	// Leader only. The combined surface of the group's mirrors.
+	FVector CaptureGroupCorners[4] = {FVector::ZeroVector, FVector::ZeroVector, FVector::ZeroVector, FVector::ZeroVector};
+
+	// Made by EvaluateFrame and reused by the capture of the same frame.
+	struct FFrameEvaluation
+	{
+		uint64 Frame = 0;
+		uint64 ViewFrame = 0;
+		EMirrorSkipReason SkipReason = EMirrorSkipReason::None;
+		bool bIsUnchanged = false;
+		FMirrorCaptureRequest Request;
+		FTransform MirroredCameraTransform = FTransform::Identity;
+		TArray<FPlane, TInlineAllocator<6>> CullingPlanes;
+		FVector CullingCorners[4];
+	};
+
+	FFrameEvaluation FrameEvaluation;
+	FMirrorCullingCache CullingCache;
+	FMirrorCullingScratch CullingScratch;
+	FMirrorAllocationCounter AllocationCounter;
+	FMirrorStatNames StatNames;
+
+	// Last blend given to the material, so it's only set again when it changes.
+	float StaticReflectionBlend = -1;
+	FVector LastMirroredCameraLocation = FVector::ZeroVector;
+	uint64 LastCullingFrame = 0;
 
 	UFUNCTION()
 	void OnCaptureTriggerBeginOverlap(AActor* OverlappedActor, AActor* OtherActor);
@@ -132,6 +368,17 @@ private:
 	UPROPERTY()
 	TObjectPtr<APlayerController> PlayerController;
 
+	UPROPERTY()
+	TObjectPtr<UMirrorSubsystem> MirrorSubsystem;
+
+	// The mirror capturing for this one, this mirror itself if it leads its group. Null while capturing on its own.
+	UPROPERTY()
+	TObjectPtr<ACMirror> CaptureGroupLeader;
+
+	// Leader only. Every mirror of the group, the leader included.
+	UPROPERTY()
+	TArray<TObjectPtr<ACMirror>> CaptureGroupMembers;
+
 	// Editor only
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
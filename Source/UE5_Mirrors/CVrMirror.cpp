@@ -1,7 +1,16 @@
 #include "CVrMirror.h"
 #include "VrMirrorSubsystem.h"
+#include "MirrorActorCommon.h"
+#include "MirrorAsyncCulling.h"
+#include "MirrorCore.h"
+#include "MirrorProjection.h"
+#include "MirrorQualityController.h"
+#include "MirrorScreenCoverage.h"
+#include "MirrorStaticReflection.h"
 #include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Components/SceneCaptureComponent2D.h"
+#include "Engine/TextureRenderTarget2D.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMaterialLibrary.h"
 #include "Kismet/KismetMathLibrary.h"
@@ -19,6 +28,8 @@ ACVrMirror::ACVrMirror()
 
 	MirrorMesh = CreateDefaultSubobject<UStaticMeshComponent>("MirrorMesh");
 	MirrorMesh->SetupAttachment(GetRootComponent());
+	// Mirrors don't reflect each other. Hiding the surface from every scene capture keeps mirrors out of each other's hidden lists.
+	MirrorMesh->SetHiddenInSceneCapture(true);
 
 	SceneCaptureLeftEye = CreateDefaultSubobject<USceneCaptureComponent2D>("SceneCaptureLeftEye");
 	SceneCaptureLeftEye->SetupAttachment(GetRootComponent());
@@ -44,12 +55,15 @@ void ACVrMirror::Destroyed()
 {
 	Super::Destroyed();
 
-	if (const UGameInstance* GameInstance = GetGameInstance())
+	if (MirrorSubsystem)
 	{
-		if (UVrMirrorSubsystem* MirrorSubsystem = GameInstance->GetSubsystem<UVrMirrorSubsystem>())
-		{
-			MirrorSubsystem->OnMirrorDestroyed(this);
-		}
+		MirrorSubsystem->OnMirrorDestroyed(this);
+		MirrorSubsystem->ReleaseRenderTarget(RenderTargetLeftEye);
+		MirrorSubsystem->ReleaseRenderTarget(RenderTargetRightEye);
+		MirrorSubsystem->ReleaseRenderTarget(StaticReflectionTarget);
+		RenderTargetLeftEye = nullptr;
+		RenderTargetRightEye = nullptr;
+		StaticReflectionTarget = nullptr;
 	}
 }
 
@@ -59,12 +73,14 @@ void ACVrMirror::BeginPlay()
 
 	if (const UGameInstance* GameInstance = GetGameInstance())
 	{
-		if (UVrMirrorSubsystem* MirrorSubsystem = GameInstance->GetSubsystem<UVrMirrorSubsystem>())
+		MirrorSubsystem = GameInstance->GetSubsystem<UVrMirrorSubsystem>();
+		if (MirrorSubsystem)
 		{
 			MirrorSubsystem->OnMirrorCreated(this);
 		}
 	}
 
+	StatNames.Init(this);
 	InitialCaptureQuality = CaptureQuality;
 	FindActiveCamera();
 	SetupCaptureTriggers();
@@ -110,7 +126,22 @@ void ACVrMirror::PostInitializeComponents()
 void ACVrMirror::Tick(const float DeltaTime)
 {
 	Super::Tick(DeltaTime);
-	CaptureScene();
+
+	if (bEnableDynamicCaptureResolution && DynamicCaptureCheckInterval <= 0)
+	{
+		CheckDynamicResolution();
+	}
+
+	// The subsystem evaluates all mirrors together once every actor has ticked.
+	if (MirrorSubsystem)
+	{
+		MirrorSubsystem->QueueEvaluation(this);
+	}
+	else
+	{
+		EvaluateFrame();
+		SubmitFrame();
+	}
 	
 	if (bDisplayNumOfActiveTriggers)
 	{
@@ -125,28 +156,26 @@ void ACVrMirror::Init()
 	IpdHalfDistanceCm = GetIpdCm() / 2;
 	HorizontalFov = FMath::RoundToInt(GetHmdFov().X);
 
-	const int32 RenderTargetWidth = Resolution.X * CaptureQuality * (bIsMobileMultiView ? 1 : 0.5);
-	const int32 RenderTargetHeight = Resolution.Y * CaptureQuality;
-
-	RenderTargetLeftEye = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetWidth, RenderTargetHeight);
-	RenderTargetRightEye = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetWidth, RenderTargetHeight);
-
-	SceneCaptureLeftEye->TextureTarget = RenderTargetLeftEye;
+	AllocateRenderTargets();
+	CullingCache.Invalidate();
 	SceneCaptureLeftEye->FOVAngle = HorizontalFov;
-
-	SceneCaptureRightEye->TextureTarget = RenderTargetRightEye;
 	SceneCaptureRightEye->FOVAngle = HorizontalFov;
 
 	if (MirrorMaterial)
 	{
 		MaterialInstanceDynamic = UKismetMaterialLibrary::CreateDynamicMaterialInstance(this, MirrorMaterial);
 		MaterialInstanceDynamic->SetTextureParameterValue("LeftEyeRenderTarget", RenderTargetLeftEye);
-		MaterialInstanceDynamic->SetTextureParameterValue("RightEyeRenderTarget", RenderTargetRightEye);
+		// A mono mirror has no right eye target. Both eyes then sample the left one.
+		MaterialInstanceDynamic->SetTextureParameterValue("RightEyeRenderTarget",
+		                                                  bIsStereoscopic ? RenderTargetRightEye : RenderTargetLeftEye);
 		MaterialInstanceDynamic->SetScalarParameterValue("ResolutionX", Resolution.X);
 		MaterialInstanceDynamic->SetScalarParameterValue("ResolutionY", Resolution.Y);
 		MaterialInstanceDynamic->SetScalarParameterValue("Fov", HorizontalFov);
 		MaterialInstanceDynamic->SetScalarParameterValue("bIsStereoscopic", bIsStereoscopic);
 		MaterialInstanceDynamic->SetScalarParameterValue("bIsMobileMultiView", bIsMobileMultiView);
+		MaterialInstanceDynamic->SetScalarParameterValue("bUseMeshUVs", bUseOffAxisProjection);
+		MaterialInstanceDynamic->SetVectorParameterValue(
+			"CaptureRegion", FLinearColor(CaptureRegion.Min.X, CaptureRegion.Min.Y, CaptureRegion.Max.X, CaptureRegion.Max.Y));
 
 		MirrorMesh->SetMaterial(0, MaterialInstanceDynamic);
 	}
@@ -154,6 +183,66 @@ void ACVrMirror::Init()
 	{
 		GEngine->AddOnScreenDebugMessage(1, 5, FColor::Red, "MirrorMaterial not set?");
 	}
+
+	// The scene behind the mirror doesn't change on a viewport resize, so the static reflection is only captured once.
+	if (bUseStaticReflection && !StaticReflectionTarget)
+	{
+		CaptureStaticReflection();
+	}
+
+	SetStaticReflectionParameters();
+}
+
+void ACVrMirror::CaptureStaticReflection()
+{
+	if (!bUseStaticReflection || StaticReflectionTexture || !MirrorMesh->GetStaticMesh())
+	{
+		return;
+	}
+
+	if (!StaticReflectionTarget)
+	{
+		const FIntPoint Size = FMirrorStaticReflection::CalcResolution(MirrorMesh, StaticReflectionResolution);
+		StaticReflectionTarget = MirrorSubsystem
+			                         ? MirrorSubsystem->AcquireRenderTarget(Size.X, Size.Y)
+			                         : UKismetRenderingLibrary::CreateRenderTarget2D(this, Size.X, Size.Y);
+	}
+
+	// Far away both eyes see practically the same reflection, so one capture serves both of them.
+	const FTransform MirrorTransform(GetActorQuat(), MirrorMesh->Bounds.Origin);
+	FMirrorStaticReflection::Capture(SceneCaptureLeftEye, MirrorMesh, MirrorTransform, StaticReflectionViewDistance,
+	                                 StaticReflectionTarget);
+}
+
+void ACVrMirror::SetStaticReflectionParameters()
+{
+	if (!bUseStaticReflection || !MaterialInstanceDynamic)
+	{
+		return;
+	}
+
+	MaterialInstanceDynamic->SetTextureParameterValue(
+		"StaticReflection", StaticReflectionTexture ? StaticReflectionTexture.Get() : StaticReflectionTarget.Get());
+
+	// A new material instance starts out with the material's default blend.
+	StaticReflectionBlend = -1;
+	UpdateStaticReflectionBlend();
+}
+
+void ACVrMirror::UpdateStaticReflectionBlend()
+{
+	if (!bUseStaticReflection || !ActiveCamera || !MaterialInstanceDynamic)
+	{
+		return;
+	}
+
+	const float Distance = FVector::Dist(ActiveCamera->GetComponentLocation(), GetActorLocation());
+	const float Blend = FMirrorStaticReflection::CalcBlend(Distance, CaptureMaxDistance, StaticReflectionFadeDistance);
+	if (Blend != StaticReflectionBlend)
+	{
+		StaticReflectionBlend = Blend;
+		MaterialInstanceDynamic->SetScalarParameterValue("StaticReflectionBlend", Blend);
+	}
 }
 
 void ACVrMirror::FindActiveCamera()
@@ -219,13 +308,120 @@ void ACVrMirror::SetupCaptureTriggers()
 	}
 }
 
+void ACVrMirror::EvaluateFrame()
+{
+	FrameEvaluation.Frame = GFrameCounter;
+	FrameEvaluation.SkipReason = FindSkipReason();
+	if (FrameEvaluation.SkipReason != EMirrorSkipReason::None)
+	{
+		return;
+	}
+
+	CalcFrameView();
+	FrameEvaluation.bIsUnchanged = bSkipUnchangedCaptures && IsCaptureUnchanged(FrameEvaluation.MirroredCameraTransform);
+
+	const FBoxSphereBounds& MirrorBounds = MirrorMesh->Bounds;
+	const float DistanceToBounds = FVector::Dist(ActiveCamera->GetComponentLocation(), MirrorBounds.Origin) -
+		MirrorBounds.SphereRadius;
+
+	FMirrorCaptureRequest& Request = FrameEvaluation.Request;
+	Request.Mirror = this;
+	Request.Distance = FMath::Max(DistanceToBounds, 1.f);
+	Request.ProjectedSize = MirrorBounds.SphereRadius / Request.Distance;
+	Request.TimeSinceLastCapture = GetWorld()->GetTimeSeconds() - LastCaptureTime;
+	Request.Cost = RenderTargetLeftEye
+		               ? RenderTargetLeftEye->SizeX * RenderTargetLeftEye->SizeY / 1000000.f * (bIsStereoscopic ? 2 : 1)
+		               : 0;
+}
+
+void ACVrMirror::SubmitFrame()
+{
+	TMirrorActorCommon<ACVrMirror>::SubmitFrame(*this);
+}
+
+FVector2D ACVrMirror::CalcViewFov() const
+{
+	// The headset's view is wider than the camera component's, so portals are tested against the HMD's field of view.
+	const FVector2D HmdFov = GetHmdFov();
+	if (HmdFov.X > 0 && HmdFov.Y > 0)
+	{
+		return HmdFov;
+	}
+
+	return FVector2D(ActiveCamera->FieldOfView,
+	                 FMirrorScreenCoverage::CalcVerticalFov(ActiveCamera->FieldOfView, FVector2D(ActiveCamera->AspectRatio, 1)));
+}
+
+bool ACVrMirror::IsCaptureUnchanged(const FTransform& MirroredCameraTransform) const
+{
+	return ChangeDetector.IsUnchanged(MirroredCameraTransform, SceneCaptureLeftEye->ShowOnlyActors,
+	                                  SceneCaptureLeftEye->ShowOnlyComponents,
+	                                  UnchangedCameraLocationTolerance, UnchangedCameraRotationTolerance,
+	                                  MaxUnchangedCaptureSkipTime, GetWorld()->GetTimeSeconds());
+}
+
+void ACVrMirror::CalcFrameView()
+{
+	// Mono mirrors capture once from the center of the head.
+	if (bIsStereoscopic)
+	{
+		CalcFrameViews<2>();
+	}
+	else
+	{
+		CalcFrameViews<1>();
+	}
+}
+
+template <int32 NumViews>
+void ACVrMirror::CalcFrameViews()
+{
+	static_assert(NumViews <= FFrameEvaluation::MaxEyes, "Every view needs its own scene capture");
+
+	const double ViewSpacing = IpdHalfDistanceCm * 2;
+	const FTransform CameraTransform = ActiveCamera->GetComponentTransform();
+	const FTransform MirroredCameraTransform = TMirrorCore<NumViews>::MirrorCamera(GetActorTransform(), CameraTransform);
+	const auto EyeTransforms = TMirrorCore<NumViews>::CalcViewTransforms(CameraTransform, ViewSpacing);
+	const auto MirroredEyeTransforms = TMirrorCore<NumViews>::CalcViewTransforms(MirroredCameraTransform, ViewSpacing);
+
+	FrameEvaluation.ViewFrame = GFrameCounter;
+	FrameEvaluation.MirroredCameraTransform = MirroredCameraTransform;
+	FrameEvaluation.NumEyes = NumViews;
+	FMirrorScreenCoverage::GetMirrorCorners(MirrorMesh, FrameEvaluation.MirrorCorners);
+	for (int32 Eye = 0; Eye < NumViews; Eye++)
+	{
+		FrameEvaluation.EyeTransforms[Eye] = EyeTransforms[Eye];
+		CalcCaptureView(MirroredEyeTransforms[Eye], FrameEvaluation.MirrorCorners, FrameEvaluation.ViewTransforms[Eye],
+		                FrameEvaluation.Projections[Eye]);
+	}
+
+	if (bCullingEnabled)
+	{
+		CalcCullingFrustum(MirroredCameraTransform.GetLocation(), TMirrorCore<NumViews>::CalcViewMargin(ViewSpacing),
+		                   FrameEvaluation.CullingPlanes, FrameEvaluation.CullingCorners);
+	}
+}
+
 void ACVrMirror::CaptureScene()
 {
-	if (ShouldSkipCapture())
+	MIRROR_SCOPE_CYCLE_COUNTER(CaptureScene);
+	TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(*StatNames.TraceName);
+	FMirrorCsvCaptureScope CsvCaptureScope(StatNames);
+
+	if (!ActiveCamera || !MaterialInstanceDynamic)
 	{
 		return;
 	}
 
+	LastCaptureTime = GetWorld()->GetTimeSeconds();
+	AllocationCounter.BeginCapture(GetCaptureBuffersSize());
+
+	// The views are normally worked out by this frame's evaluation already.
+	if (FrameEvaluation.ViewFrame != GFrameCounter)
+	{
+		CalcFrameView();
+	}
+
 	MaterialInstanceDynamic->SetVectorParameterValue("XCameraToWorldVector", ActiveCamera->GetForwardVector());
 	MaterialInstanceDynamic->SetVectorParameterValue("YCameraToWorldVector", ActiveCamera->GetRightVector());
 	MaterialInstanceDynamic->SetVectorParameterValue("ZCameraToWorldVector", ActiveCamera->GetUpVector());
@@ -234,40 +430,72 @@ void ACVrMirror::CaptureScene()
 	const FVector ClipPlaneBase = GetActorLocation()-MirrorForwardVector;
 	const FVector ClipPlaneNormal = MirrorForwardVector;
 
-	const FTransform MirroredCameraTransform = MirrorCamera(ActiveCamera->GetComponentTransform());
-	MirrorCulling(MirroredCameraTransform);
-	TArray<FTransform> MirroredCameras;
+	const FTransform& MirroredCameraTransform = FrameEvaluation.MirroredCameraTransform;
+	TMirrorActorCommon<ACVrMirror>::MirrorCulling(*this, MirroredCameraTransform.GetLocation(), *SceneCaptureLeftEye);
 
+	// The right eye only captures for stereoscopic mirrors and always sees the same objects as the left one.
 	if (bIsStereoscopic)
 	{
-		MirroredCameras = CreateEyeOffsets(MirroredCameraTransform);
-		SceneCaptureRightEye->ClipPlaneBase = ClipPlaneBase;
-		SceneCaptureRightEye->ClipPlaneNormal = ClipPlaneNormal;
-		SceneCaptureRightEye->SetWorldTransform(MirroredCameras[1]);
-		SceneCaptureRightEye->CaptureScene();
+		SceneCaptureRightEye->ShowOnlyActors = SceneCaptureLeftEye->ShowOnlyActors;
+		SceneCaptureRightEye->ShowOnlyComponents = SceneCaptureLeftEye->ShowOnlyComponents;
+	}
+
+	QueueAsyncCulling(MirroredCameraTransform.GetLocation());
+
+	USceneCaptureComponent2D* SceneCaptures[2] = {SceneCaptureLeftEye, SceneCaptureRightEye};
+	const TStaticArray<FTransform, FFrameEvaluation::MaxEyes>& ViewTransforms = FrameEvaluation.ViewTransforms;
+	const TStaticArray<FMatrix, FFrameEvaluation::MaxEyes>& Projections = FrameEvaluation.Projections;
+
+	if (bCaptureVisibleRegionOnly)
+	{
+		FBox2D VisibleRegion(ForceInit);
+		for (int32 Eye = 0; Eye < FrameEvaluation.NumEyes; Eye++)
+		{
+			const FBox2D EyeRegion = FMirrorProjection::CalcVisibleRegion(FrameEvaluation.EyeTransforms[Eye], GetHmdFov(),
+			                                                              FrameEvaluation.MirrorCorners,
+			                                                              ViewTransforms[Eye], Projections[Eye]);
+			if (EyeRegion.bIsValid)
+			{
+				VisibleRegion += EyeRegion;
+			}
+		}
+
+		// Both eyes share one region, so their render targets keep the same size.
+		SetCaptureRegion(FMirrorProjection::SnapRegion(VisibleRegion, VisibleRegionStep));
 	}
 
-	SceneCaptureLeftEye->ClipPlaneBase = ClipPlaneBase;
-	SceneCaptureLeftEye->ClipPlaneNormal = ClipPlaneNormal;
-	SceneCaptureLeftEye->SetWorldTransform(bIsStereoscopic ? MirroredCameras[0] : MirroredCameraTransform);
-	SceneCaptureLeftEye->CaptureScene();
+	for (int32 Eye = 0; Eye < FrameEvaluation.NumEyes; Eye++)
+	{
+		USceneCaptureComponent2D* SceneCapture = SceneCaptures[Eye];
+		SceneCapture->ClipPlaneBase = ClipPlaneBase;
+		SceneCapture->ClipPlaneNormal = ClipPlaneNormal;
+		SceneCapture->bUseCustomProjectionMatrix = bUseOffAxisProjection || bCaptureVisibleRegionOnly;
+		SceneCapture->CustomProjectionMatrix = bCaptureVisibleRegionOnly
+			                                       ? FMirrorProjection::CropProjection(Projections[Eye], CaptureRegion)
+			                                       : Projections[Eye];
+		SceneCapture->SetWorldTransform(ViewTransforms[Eye]);
+		SceneCapture->CaptureScene();
+	}
+
+	ChangeDetector.OnCaptured(MirroredCameraTransform, SceneCaptureLeftEye->ShowOnlyActors,
+	                          SceneCaptureLeftEye->ShowOnlyComponents, LastCaptureTime);
+
+	AllocationCounter.EndCapture(GetCaptureBuffersSize(), this);
+	FMirrorStats::CountCapture(SceneCaptureLeftEye->ShowOnlyActors.Num(), SceneCaptureLeftEye->ShowOnlyComponents.Num());
 }
 
-FTransform ACVrMirror::MirrorCamera(const FTransform& CameraTransform) const
+void ACVrMirror::AddRenderTargetStats() const
 {
-	const FTransform ActorTransform = GetActorTransform();
-	FVector NewCameraLocation = ActorTransform.InverseTransformPosition(CameraTransform.GetLocation());
-	NewCameraLocation.X *= -1;
-	NewCameraLocation = ActorTransform.TransformPosition(NewCameraLocation);
-
-	const FVector ActorForward = ActorTransform.GetRotation().GetForwardVector();
-	const FVector CameraForward = CameraTransform.GetRotation().GetForwardVector();
-	const FVector CameraRight = CameraTransform.GetRotation().GetRightVector();
+	FMirrorStats::AddRenderTargetMemory(RenderTargetLeftEye);
+	FMirrorStats::AddRenderTargetMemory(RenderTargetRightEye);
+	FMirrorStats::AddRenderTargetMemory(StaticReflectionTarget);
+}
 
-	const FVector MirroredCamForward = FMath::GetReflectionVector(CameraForward, ActorForward);
-	const FVector MirroredCamRight = FMath::GetReflectionVector(CameraRight, ActorForward);
-	const FRotator NewCameraRotation = UKismetMathLibrary::MakeRotFromXY(MirroredCamForward, MirroredCamRight);
-	return FTransform(NewCameraRotation, NewCameraLocation);
+SIZE_T ACVrMirror::GetCaptureBuffersSize() const
+{
+	return CullingScratch.GetAllocatedSize() +
+		SceneCaptureLeftEye->ShowOnlyActors.GetAllocatedSize() + SceneCaptureLeftEye->ShowOnlyComponents.GetAllocatedSize() +
+		SceneCaptureRightEye->ShowOnlyActors.GetAllocatedSize() + SceneCaptureRightEye->ShowOnlyComponents.GetAllocatedSize();
 }
 
 FVector2D ACVrMirror::GetHmdResolution()
@@ -284,44 +512,146 @@ FVector2D ACVrMirror::GetHmdResolution()
 	return FVector2D::Zero();
 }
 
-void ACVrMirror::CheckDynamicResolution()
+FIntPoint ACVrMirror::CalcEyeRenderTargetSize() const
 {
-	if (!bEnableDynamicCaptureResolution || !ActiveCamera)
+	// The HMD resolution covers both eyes side by side, except with mobile multi-view.
+	const float EyeWidth = Resolution.X * (bIsMobileMultiView ? 1 : 0.5);
+	const float Quality = CaptureQuality * FrameBudgetScale;
+
+	// Only the captured region of the full view gets texels.
+	const FVector2D RegionSize = bCaptureVisibleRegionOnly ? CaptureRegion.GetSize() : FVector2D::UnitVector;
+
+	if (bUseOffAxisProjection)
+	{
+		// Every texel lands on the mirror, so the pixels of a full eye capture are given the mirror's shape.
+		const FVector2D Size = FMirrorProjection::FitToAspectRatio(EyeWidth * Resolution.Y * FMath::Square(Quality),
+		                                                           FMirrorProjection::CalcMirrorAspectRatio(MirrorMesh)) *
+			RegionSize;
+		return FIntPoint(FMath::Max<int32>(Size.X, 1), FMath::Max<int32>(Size.Y, 1));
+	}
+
+	return FIntPoint(FMath::Max<int32>(EyeWidth * Quality * RegionSize.X, 1),
+	                 FMath::Max<int32>(Resolution.Y * Quality * RegionSize.Y, 1));
+}
+
+void ACVrMirror::AllocateRenderTargets()
+{
+	const FIntPoint RenderTargetSize = CalcEyeRenderTargetSize();
+
+	if (MirrorSubsystem)
 	{
+		// Releasing first lets a same sized request get the old targets straight back.
+		MirrorSubsystem->ReleaseRenderTarget(RenderTargetLeftEye);
+		MirrorSubsystem->ReleaseRenderTarget(RenderTargetRightEye);
+		RenderTargetLeftEye = MirrorSubsystem->AcquireRenderTarget(RenderTargetSize.X, RenderTargetSize.Y);
+		RenderTargetRightEye = bIsStereoscopic
+			                       ? MirrorSubsystem->AcquireRenderTarget(RenderTargetSize.X, RenderTargetSize.Y)
+			                       : nullptr;
+	}
+	else
+	{
+		RenderTargetLeftEye = UKismetRenderingLibrary::CreateRenderTarget2D(
+			this, RenderTargetSize.X, RenderTargetSize.Y);
+		RenderTargetRightEye = bIsStereoscopic
+			                       ? UKismetRenderingLibrary::CreateRenderTarget2D(
+				                       this, RenderTargetSize.X, RenderTargetSize.Y)
+			                       : nullptr;
+	}
+
+	SceneCaptureLeftEye->TextureTarget = RenderTargetLeftEye;
+	SceneCaptureRightEye->TextureTarget = RenderTargetRightEye;
+	ChangeDetector.Reset();
+}
+
+void ACVrMirror::ResizeRenderTargets()
+{
+	if (!RenderTargetLeftEye || (bIsStereoscopic && !RenderTargetRightEye))
+	{
+		AllocateRenderTargets();
 		return;
 	}
 
-	const float DistanceSquared = FVector::DistSquared(GetActorLocation(), ActiveCamera->GetComponentLocation());
-	float NewCaptureQuality = UKismetMathLibrary::MapRangeClamped(DistanceSquared,
-	                                                              FMath::Square(DynamicCaptureRangeStart),
-	                                                              FMath::Square(DynamicCaptureRangeEnd),
-	                                                              InitialCaptureQuality,
-	                                                              LowestDynamicCaptureQuality);
+	// The target objects stay the same, so the material keeps pointing at them and nothing is left for garbage collection.
+	const FIntPoint RenderTargetSize = CalcEyeRenderTargetSize();
+	RenderTargetLeftEye->ResizeTarget(RenderTargetSize.X, RenderTargetSize.Y);
+	if (RenderTargetRightEye)
+	{
+		RenderTargetRightEye->ResizeTarget(RenderTargetSize.X, RenderTargetSize.Y);
+	}
+	ChangeDetector.Reset();
+}
 
+float ACVrMirror::CalcScreenCoverageQuality() const
+{
+	// Coverage is measured per eye with the HMD's own projection.
+	const FVector2D EyeResolution(Resolution.X * (bIsMobileMultiView ? 1 : 0.5), Resolution.Y);
+	const FVector2D HmdFov = GetHmdFov();
+	if (EyeResolution.X <= 0 || EyeResolution.Y <= 0 || HmdFov.X <= 0 || HmdFov.Y <= 0)
+	{
+		return InitialCaptureQuality;
+	}
 
-	NewCaptureQuality = FMath::TruncToFloat(NewCaptureQuality * 10) / 10;
-	if (CaptureQuality != NewCaptureQuality)
+	FVector MirrorCorners[4];
+	FMirrorScreenCoverage::GetMirrorCorners(MirrorMesh, MirrorCorners);
+
+	const float CoveredPixels = FMirrorScreenCoverage::CalcCoveredPixels(ActiveCamera->GetComponentTransform(),
+	                                                                     MirrorCorners, HmdFov, EyeResolution);
+
+	// Each eye's render target has quality squared times as many texels as the eye has pixels, over the captured region.
+	const float RegionArea = bCaptureVisibleRegionOnly ? FMath::Max(CaptureRegion.GetArea(), KINDA_SMALL_NUMBER) : 1;
+	const float Quality = FMath::Sqrt(CoveredPixels * ScreenCoverageTexelDensity /
+		(EyeResolution.X * EyeResolution.Y * RegionArea));
+	return FMath::Clamp(Quality, LowestDynamicCaptureQuality, InitialCaptureQuality);
+}
+
+void ACVrMirror::SetFrameBudgetScale(const float QualityScale)
+{
+	const float NewFrameBudgetScale = FMirrorQualityController::GetScaleForPriority(QualityScale, FrameBudgetPriority);
+
+	// Small changes are not worth resizing the render target for, except for getting back to full quality.
+	if (NewFrameBudgetScale == FrameBudgetScale ||
+		(FMath::Abs(NewFrameBudgetScale - FrameBudgetScale) < 0.05f && NewFrameBudgetScale < 1))
 	{
-		CaptureQuality = NewCaptureQuality;
+		return;
+	}
 
-		const int32 RenderTargetWidth = Resolution.X * CaptureQuality * (bIsMobileMultiView ? 1 : 0.5);
-		const int32 RenderTargetHeight = Resolution.Y * CaptureQuality;
+	FrameBudgetScale = NewFrameBudgetScale;
+	CullingCache.Invalidate();
+	if (RenderTargetLeftEye)
+	{
+		ResizeRenderTargets();
+	}
+}
 
-		RenderTargetLeftEye = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetWidth, RenderTargetHeight);
-		RenderTargetRightEye = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetWidth, RenderTargetHeight);
+void ACVrMirror::CheckDynamicResolution()
+{
+	if (!bEnableDynamicCaptureResolution || !ActiveCamera)
+	{
+		return;
+	}
 
-		SceneCaptureLeftEye->TextureTarget = RenderTargetLeftEye;
-		SceneCaptureRightEye->TextureTarget = RenderTargetRightEye;
-		if (MirrorMaterial)
-		{
-			MaterialInstanceDynamic->SetTextureParameterValue("LeftEyeRenderTarget", RenderTargetLeftEye);
-			MaterialInstanceDynamic->SetTextureParameterValue("RightEyeRenderTarget", RenderTargetRightEye);
-		}
+	float NewCaptureQuality;
+	if (bUseScreenCoverage)
+	{
+		NewCaptureQuality = CalcScreenCoverageQuality();
+	}
+	else
+	{
+		const float DistanceSquared = FVector::DistSquared(GetActorLocation(), ActiveCamera->GetComponentLocation());
+		NewCaptureQuality = UKismetMathLibrary::MapRangeClamped(DistanceSquared,
+		                                                        FMath::Square(DynamicCaptureRangeStart),
+		                                                        FMath::Square(DynamicCaptureRangeEnd),
+		                                                        InitialCaptureQuality,
+		                                                        LowestDynamicCaptureQuality);
+	}
 
-		if (GEngine)
-		{
-			GEngine->ForceGarbageCollection();
-		}
+	NewCaptureQuality = TMirrorCore<2>::StepCaptureQuality(NewCaptureQuality, CaptureQuality, InitialCaptureQuality,
+	                                                       DynamicCaptureQualityStep, DynamicCaptureQualityHysteresis);
+
+	if (CaptureQuality != NewCaptureQuality)
+	{
+		CaptureQuality = NewCaptureQuality;
+		ResizeRenderTargets();
 	}
 
 	if (bDisplayDynamicCaptureQuality)
@@ -332,170 +662,106 @@ void ACVrMirror::CheckDynamicResolution()
 	}
 }
 
-bool ACVrMirror::ShouldSkipCapture() const
+EMirrorSkipReason ACVrMirror::FindSkipReason() const
 {
-	if ((bIsUsingCaptureTriggers && NumActiveCaptureTriggers == 0) || !MirrorMesh->WasRecentlyRendered() || !
-		ActiveCamera
-		|| !
-		MaterialInstanceDynamic)
+	if (bIsUsingCaptureTriggers && NumActiveCaptureTriggers == 0)
 	{
-		return true;
+		return EMirrorSkipReason::Triggers;
 	}
 
-	// Stop capturing if we are beyond specified max distance.
-	const float DistanceSquared = FVector::DistSquared(ActiveCamera->GetComponentLocation(), GetActorLocation());
-	if (DistanceSquared >= CaptureMaxDistance * CaptureMaxDistance)
+	if (MirrorSubsystem ? !MirrorSubsystem->WasRecentlyRendered(MirrorMesh) : !MirrorMesh->WasRecentlyRendered())
 	{
-		return true;
+		return EMirrorSkipReason::NotRendered;
 	}
 
-	const FVector MirrorToCameraLocal = GetActorTransform().InverseTransformPositionNoScale(
-		ActiveCamera->GetComponentLocation());
+	if (!ActiveCamera || !MaterialInstanceDynamic)
+	{
+		return EMirrorSkipReason::NotReady;
+	}
 
-	// Stop capturing if we are far enough behind the mirror that neither eye can see it even when perpendicular.
-	if (MirrorToCameraLocal.X <= -IpdHalfDistanceCm)
+	// Stop capturing if we are beyond specified max distance, or far enough behind the mirror that no eye can see it.
+	const FVector CameraLocation = ActiveCamera->GetComponentLocation();
+	if (!TMirrorCore<1>::IsCameraInCaptureDistance(GetActorTransform(), CameraLocation, CaptureMaxDistance))
 	{
-		return true;
+		return EMirrorSkipReason::Distance;
 	}
 
-	return false;
+	const double ViewSpacing = IpdHalfDistanceCm * 2;
+	const bool bIsInFront = bIsStereoscopic
+		                        ? TMirrorCore<2>::IsCameraInFrontOfMirror(GetActorTransform(), CameraLocation, ViewSpacing)
+		                        : TMirrorCore<1>::IsCameraInFrontOfMirror(GetActorTransform(), CameraLocation, ViewSpacing);
+	return bIsInFront ? EMirrorSkipReason::None : EMirrorSkipReason::BehindMirror;
 }
 
-void ACVrMirror::MirrorCulling(const FTransform& MirroredCameraTransform)
+void ACVrMirror::QueueAsyncCulling(const FVector& MirroredCameraLocation)
 {
-	if (!bCullingEnabled || !MirrorCullingTraceChannel)
+	if (!bCullingEnabled || !bAsyncCulling || !MirrorSubsystem)
 	{
 		return;
 	}
 
-	FVector MirrorLocation = MirrorMesh->GetComponentLocation();
-	FVector MirroredCameraLocation = MirroredCameraTransform.GetLocation();
-	FVector Min;
-	FVector Max;
-	MirrorMesh->GetLocalBounds(Min, Max);
+	// Expect the camera to keep the velocity it had since the last frame. Without a capture last frame, or after a cut, expect it to stay.
+	const bool bHasVelocity = LastCullingFrame + 1 == GFrameCounter && !IsCameraCut();
+	const FVector PredictedLocation = bHasVelocity
+		                                  ? MirroredCameraLocation + (MirroredCameraLocation - LastMirroredCameraLocation)
+		                                  : MirroredCameraLocation;
+	LastMirroredCameraLocation = MirroredCameraLocation;
+	LastCullingFrame = GFrameCounter;
 
-	float MirrorHalfWidth = (Max.Y * MirrorMesh->GetComponentScale().Y * MirrorCullingBufferMultiplier) +
-		IpdHalfDistanceCm;
-	float MirrorHalfHeight = (Max.Z * MirrorMesh->GetComponentScale().Z * MirrorCullingBufferMultiplier) +
-		IpdHalfDistanceCm;
-
-	FVector MirrorTop = MirrorLocation + GetActorUpVector() * MirrorHalfHeight;
-	FVector MirrorBottom = MirrorLocation + GetActorUpVector() * -1 * MirrorHalfHeight;
-
-	FVector MirrorTopLeft = MirrorTop - GetActorRightVector() * MirrorHalfWidth;
-	FVector MirrorTopRight = MirrorTop + GetActorRightVector() * MirrorHalfWidth;
-	FVector MirrorBottomLeft = MirrorBottom - GetActorRightVector() * MirrorHalfWidth;
-	FVector MirrorBottomRight = MirrorBottom + GetActorRightVector() * MirrorHalfWidth;
-
-	FVector CaptureToTopLeft = (MirrorTopLeft - MirroredCameraLocation).GetSafeNormal();
-	FVector CaptureToTopRight = (MirrorTopRight - MirroredCameraLocation).GetSafeNormal();
-	FVector CaptureToBottomLeft = (MirrorBottomLeft - MirroredCameraLocation).GetSafeNormal();
-	FVector CaptureToBottomRight = (MirrorBottomRight - MirroredCameraLocation).GetSafeNormal();
-	FVector CaptureToMirror = (MirrorLocation - MirroredCameraLocation).GetSafeNormal();
-
-	//Close plane
-	FVector ClosePlaneNormal = MirrorMesh->GetForwardVector();
-	float ClosePlaneW = FVector::DotProduct(ClosePlaneNormal, MirrorTopLeft);
-	FPlane FrustumClosePlane = FPlane(ClosePlaneNormal.X, ClosePlaneNormal.Y, ClosePlaneNormal.Z, ClosePlaneW);
-
-	//Far plane
-	float FrustumDistance = MirrorCullingTraceDistance;
-	FVector FarPlanePoint = MirrorLocation + CaptureToMirror * FrustumDistance;
-	FVector FarPlaneNormal = CaptureToMirror * -1;
-	float FarPlaneW = FVector::DotProduct(FarPlaneNormal, FarPlanePoint);
-	FPlane FrustumFarPlane = FPlane(FarPlaneNormal.X, FarPlaneNormal.Y, FarPlaneNormal.Z, FarPlaneW);
-
-	// Top Plane
-	FVector TopPlaneNormal = FVector::CrossProduct(CaptureToTopRight, CaptureToTopLeft).GetSafeNormal();
-	float TopPlaneW = FVector::DotProduct(TopPlaneNormal, MirrorTopLeft);
-	FPlane FrustumTopPlane = FPlane(TopPlaneNormal.X, TopPlaneNormal.Y, TopPlaneNormal.Z, TopPlaneW);
-
-	// // Bottom Plane
-	FVector BottomPlaneNormal = FVector::CrossProduct(CaptureToBottomLeft, CaptureToBottomRight).GetSafeNormal();
-	float BottomPlaneW = FVector::DotProduct(BottomPlaneNormal, MirrorBottomLeft);
-	FPlane FrustumBottomPlane = FPlane(BottomPlaneNormal.X, BottomPlaneNormal.Y, BottomPlaneNormal.Z, BottomPlaneW);
-
-	// Left Plane
-	FVector LeftPlaneNormal = FVector::CrossProduct(CaptureToTopLeft, CaptureToBottomLeft).GetSafeNormal();
-	float LeftPlaneW = FVector::DotProduct(LeftPlaneNormal, MirrorTopLeft);
-	FPlane FrustumLeftPlane = FPlane(LeftPlaneNormal.X, LeftPlaneNormal.Y, LeftPlaneNormal.Z, LeftPlaneW);
-
-	// Right Plane
-	FVector RightPlaneNormal = FVector::CrossProduct(CaptureToBottomRight, CaptureToTopRight).GetSafeNormal();
-	float RightPlaneW = FVector::DotProduct(RightPlaneNormal, MirrorTopRight);
-	FPlane FrustumRightPlane = FPlane(RightPlaneNormal.X, RightPlaneNormal.Y, RightPlaneNormal.Z, RightPlaneW);
-
-	TArray<FPlane*> FrustumPlanes{
-		&FrustumClosePlane, &FrustumFarPlane, &FrustumTopPlane, &FrustumBottomPlane, &FrustumLeftPlane,
-		&FrustumRightPlane
-	};
-
-	float CaptureToMirrorDist = FVector::Dist(MirroredCameraLocation, MirrorLocation);
-	float WidthAtFarPlane = UKismetMathLibrary::DegTan(HorizontalFov / 2) * (CaptureToMirrorDist +
-		FrustumDistance) * 2;
-
-	if (bShowCullingPlanes)
-	{
-		for (const FPlane* Plane : FrustumPlanes)
-		{
-			DrawDebugSolidPlane(GetWorld(), *Plane, MirrorLocation, 2000,
-			                    FColor::Red.WithAlpha(60));
-		}
+	FMirrorCullingQuery* Query = MirrorSubsystem->QueueAsyncCulling(this);
+	if (!Query)
+	{
+		return;
 	}
 
-	TArray<FHitResult> HitResults;
-	TArray<AActor*> ActorsToIgnore;
-	FQuat MirroredCameraRotation = MirroredCameraTransform.GetRotation();
-	FVector End = MirrorLocation + MirroredCameraRotation.GetForwardVector() * FrustumDistance;
-
-	LastTraceCameraPosition = ActiveCamera->GetComponentLocation();
-	UKismetSystemLibrary::BoxTraceMulti(this, MirrorLocation,
-	                                    End, FVector(100, WidthAtFarPlane / 2, WidthAtFarPlane / 2),
-	                                    MirroredCameraRotation.Rotator(),
-	                                    UEngineTypes::ConvertToTraceType(MirrorCullingTraceChannel), false,
-	                                    ActorsToIgnore,
-	                                    EDrawDebugTrace::None, HitResults, true);
+	FVector MirrorCorners[4];
+	CalcCullingFrustum(PredictedLocation, IpdHalfDistanceCm, Query->Planes, MirrorCorners);
+	Query->MirroredCameraLocation = PredictedLocation;
+	Query->bUseBoxes = bCullWithBoxes;
+	Query->bMovableOnly = FindBakedCell(PredictedLocation) != nullptr;
+}
 
-	SceneCaptureLeftEye->ShowOnlyActors.Empty();
-	SceneCaptureRightEye->ShowOnlyActors.Empty();
-	TSet<AActor*> HandledActors;
-	for (const FHitResult& HitResult : HitResults)
+const FMirrorVisibleSetCell* ACVrMirror::FindBakedCell(const FVector& MirroredCameraLocation) const
+{
+	if (!bUseBakedVisibleSets || !VisibleSets.IsBaked())
 	{
-		AActor* Actor = HitResult.GetActor();
-		if (HandledActors.Contains(Actor))
-		{
-			continue;
-		}
+		return nullptr;
+	}
 
-		const auto& Sphere = HitResult.GetComponent()->Bounds.GetSphere();
-		bool ShouldRender = true;
+	return VisibleSets.FindCell(VisibleSets.CalcCell(GetActorTransform(), MirroredCameraLocation));
+}
 
-		for (const FPlane* Plane : FrustumPlanes)
-		{
-			const float Distance = Plane->PlaneDot(Sphere.Center);
+bool ACVrMirror::IsCameraCut() const
+{
+	return PlayerController && PlayerController->PlayerCameraManager &&
+		PlayerController->PlayerCameraManager->bGameCameraCutThisFrame;
+}
 
-			// If a component of an actor is outside of at least one plane by more than its bound's sphere radius, then we assume the actor is not visible in the reflection for now.
-			if (Distance < -Sphere.W)
-			{
-				ShouldRender = false;
-				break;
-			}
-		}
+void ACVrMirror::CalcCullingFrustum(const FVector& MirroredCameraLocation, const float EyeMargin,
+                                    TArray<FPlane, TInlineAllocator<6>>& OutPlanes, FVector (&OutCorners)[4]) const
+{
+	FVector Min;
+	FVector Max;
+	MirrorMesh->GetLocalBounds(Min, Max);
 
-		// If a component is visible, mark the owning actor as visible and add it to HandledActors to skip further checks for it.
-		if (ShouldRender)
-		{
-			SceneCaptureLeftEye->ShowOnlyActors.Add(Actor);
-			SceneCaptureRightEye->ShowOnlyActors.Add(Actor);
-			HandledActors.Add(Actor);
-		}
-	}
+	// Two eyes EyeMargin to either side of the mirrored camera.
+	const FVector MirrorScale = MirrorMesh->GetComponentScale();
+	const FVector2D MirrorHalfSize = FVector2D(Max.Y * MirrorScale.Y, Max.Z * MirrorScale.Z) * MirrorCullingBufferMultiplier;
+	const FTransform MirrorTransform(GetActorQuat(), MirrorMesh->GetComponentLocation());
+	TMirrorCore<2>::CalcCullingFrustum(MirrorTransform, MirrorHalfSize, MirroredCameraLocation, EyeMargin * 2,
+	                                   MirrorCullingTraceDistance * FrameBudgetScale, OutPlanes, OutCorners);
+}
 
-	for (auto Actor : DontCullActors)
-	{
-		SceneCaptureLeftEye->ShowOnlyActors.Add(Actor);
-		SceneCaptureRightEye->ShowOnlyActors.Add(Actor);
-	}
+void ACVrMirror::BakeVisibleSets()
+{
+	// The headset isn't known while baking, so the eye offset allows for a wide IPD.
+	constexpr float BakeEyeMargin = 4;
+	TMirrorActorCommon<ACVrMirror>::BakeVisibleSets(
+		*this, [this](const FVector& MirroredCameraLocation, TArray<FPlane, TInlineAllocator<6>>& OutPlanes,
+		              FVector (&OutCorners)[4])
+		{
+			CalcCullingFrustum(MirroredCameraLocation, BakeEyeMargin, OutPlanes, OutCorners);
+		});
 }
 
 FVector2D ACVrMirror::GetHmdFov()
@@ -536,22 +802,39 @@ float ACVrMirror::GetIpdCm() const
 	return 6.4;
 }
 
-TArray<FTransform> ACVrMirror::CreateEyeOffsets(const FTransform& CameraTransform) const
+void ACVrMirror::CalcCaptureView(const FTransform& MirroredEyeTransform, const FVector (&MirrorCorners)[4],
+                                 FTransform& OutViewTransform, FMatrix& OutProjection) const
 {
-	const FVector CameraLocation = CameraTransform.GetLocation();
-	const FQuat CameraRotation = CameraTransform.GetRotation();
-	const FVector RightVector = CameraRotation.GetRightVector();
-	const FVector LeftVector = CameraRotation.GetRightVector() * -1;
+	const float EyeAspectRatio = Resolution.X * (bIsMobileMultiView ? 1 : 0.5) / FMath::Max(Resolution.Y, 1.0);
+	OutViewTransform = MirroredEyeTransform;
+	OutProjection = FMirrorProjection::CalcPerspectiveProjection(HorizontalFov, EyeAspectRatio);
 
-	const FVector EyeLocationLeft = CameraLocation + LeftVector * IpdHalfDistanceCm;
-	const FVector EyeLocationRight = CameraLocation + RightVector * IpdHalfDistanceCm;
+	if (bUseOffAxisProjection)
+	{
+		// The off-axis view looks straight through the mirror, the projection then shifts it onto the mirror's corners.
+		const FTransform OffAxisViewTransform(GetActorQuat(), MirroredEyeTransform.GetLocation());
+		if (FMirrorProjection::CalcOffAxisProjection(OffAxisViewTransform, MirrorCorners, OutProjection))
+		{
+			OutViewTransform = OffAxisViewTransform;
+		}
+	}
+}
 
-	const FTransform LeftEyeTransform = FTransform(CameraTransform.GetRotation(), EyeLocationLeft);
-	const FTransform RightEyeTransform = FTransform(CameraTransform.GetRotation(), EyeLocationRight);
+void ACVrMirror::SetCaptureRegion(const FBox2D& Region)
+{
+	bool bSizeChanged = false;
+	if (!TMirrorActorCommon<ACVrMirror>::UpdateCaptureRegion(*this, Region, bSizeChanged))
+	{
+		return;
+	}
 
-	TArray EyeTransforms{LeftEyeTransform, RightEyeTransform};
+	if (bSizeChanged)
+	{
+		ResizeRenderTargets();
+	}
 
-	return EyeTransforms;
+	MaterialInstanceDynamic->SetVectorParameterValue(
+		"CaptureRegion", FLinearColor(CaptureRegion.Min.X, CaptureRegion.Min.Y, CaptureRegion.Max.X, CaptureRegion.Max.Y));
 }
 
 void ACVrMirror::OnCaptureTriggerBeginOverlap(AActor* OverlappedActor, AActor* OtherActor)
@@ -1,11 +1,22 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
 #include "GameFramework/Actor.h"
+#include "MirrorCaptureScheduler.h"
+#include "MirrorChangeDetector.h"
+#include "MirrorCullingCache.h"
+#include "MirrorScratchBuffers.h"
+#include "MirrorStats.h"
+#include "MirrorVisibleSets.h"
 #include "CVrMirror.generated.h"
 
 class UCameraComponent;
+class UVrMirrorSubsystem;
+class UTexture;
 class ATriggerBox;
+template <typename MirrorType>
+class TMirrorActorCommon;
 
 UCLASS()
 
@@ -18,6 +29,29 @@ public:
 	virtual void Tick(const float DeltaTime) override;
 	void Init();
 
+	// Render the reflection. Called by the mirror subsystem once this mirror's capture request fits into the frame budget.
+	void CaptureScene();
+
+	// Decide on this frame's capture and work out its eye views. Only reads the scene, so the subsystem evaluates all mirrors in parallel.
+	void EvaluateFrame();
+
+	// Queue the capture decided on by EvaluateFrame. Game thread only.
+	void SubmitFrame();
+
+	// Called by the subsystem's frame budget. Scales capture resolution and culling distance, weighted by FrameBudgetPriority.
+	void SetFrameBudgetScale(float QualityScale);
+
+	// Adds this mirror's render targets to the render target memory of stat Mirrors.
+	void AddRenderTargetStats() const;
+
+	// Record the static actors that can appear in this mirror for every camera cell in VisibleSetBakeExtent. Bake again after moving the mirror or changing the level.
+	UFUNCTION(CallInEditor)
+	void BakeVisibleSets();
+
+	// Capture the static reflection again, for instance after the scene behind the mirror changed. Does nothing with a baked StaticReflectionTexture.
+	UFUNCTION(BlueprintCallable)
+	void CaptureStaticReflection();
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	TObjectPtr<USceneCaptureComponent2D> SceneCaptureLeftEye;
 
@@ -47,11 +81,7 @@ protected:
 	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled), DisplayName="Display culling planes")
 	bool bShowCullingPlanes = false;
 
-	// Trace channel for mirror culling. Select your custom trace channel.
-	UPROPERTY(EditAnywhere)
-	TEnumAsByte<ECollisionChannel> MirrorCullingTraceChannel;
-
-	// How far will the mirror scan for objects that will be rendered.
+	// How far behind the mirror objects are still rendered. Everything beyond is culled.
 	UPROPERTY(EditAnywhere)
 	float MirrorCullingTraceDistance = 10000;
 
@@ -59,10 +89,72 @@ protected:
 	UPROPERTY(EditAnywhere, meta=(ClampMin=1, ClampMax=2))
 	float MirrorCullingBufferMultiplier = 1;
 
-	// Use this for far away actors which might not be hit by the trace. Skybox is a good example.
+	// Show only the visible components of an actor instead of the whole actor once one of its components is visible.
+	// Large actors made of many components, like buildings built from a modular kit, then only render their visible parts.
+	// Baked visible sets store components instead of actors when baked with this set, rebake them after changing it.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	bool bCullPerComponent = false;
+
+	// Test objects with their bounding boxes instead of bounding spheres. Culls more objects at a slightly higher cost.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	bool bCullWithBoxes = true;
+
+	// Reuse the culling result while the mirrored camera stays within a cell of this size in centimeters. 0 to cull on every capture.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled, ClampMin=0))
+	float CullingCacheCellSize = 25;
+
+	// Cached culling results older than this many seconds are refreshed. Primitives moving inside the reflected volume refresh them right away. 0 to keep them until the camera changes cell.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled, ClampMin=0))
+	float CullingCacheMaxAge = 0.5;
+
+	// Take static actors from the baked visible sets instead of querying for them. Movable actors are still culled on every capture.
+	// Cameras outside the baked region fall back to regular culling. Static actors spawned at runtime are not part of the sets.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	bool bUseBakedVisibleSets = true;
+
+	// Region in front of the mirror that BakeVisibleSets samples camera locations in. X is the distance from the mirror, Y and Z are half the width and height around its center.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	FVector VisibleSetBakeExtent = FVector(2000, 1000, 300);
+
+	// Edge length of the baked camera cells in centimeters. Smaller cells cull more but take longer to bake and store more.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled, ClampMin=10))
+	float VisibleSetCellSize = 100;
+
+	UPROPERTY()
+	FMirrorVisibleSets VisibleSets;
+
+	// Run the culling query for the next capture on a worker thread, from where the mirrored camera is expected to be by then.
+	// Captures on camera cuts, or with the camera further than AsyncCullingTolerance from the prediction, are culled right away instead.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCullingEnabled))
+	bool bAsyncCulling = false;
+
+	// How far in centimeters the mirrored camera may end up from its predicted location for the async result to be used.
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bCullingEnabled && bAsyncCulling", ClampMin=0))
+	float AsyncCullingTolerance = 25;
+
+	// Use this for far away actors which are beyond the culling distance. Skybox is a good example.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	TArray<AActor*> DontCullActors;
 
+	// Fit the capture's projection to the mirror's corners, so it only renders what the mirror shows. The render target takes the mirror's aspect ratio.
+	// The mirror material has to sample the capture with the mesh UVs while the bUseMeshUVs parameter is set.
+	// Pair it with screen coverage dynamic resolution, so the capture gets no more texels than the mirror covers on screen.
+	UPROPERTY(EditAnywhere)
+	bool bUseOffAxisProjection = false;
+
+	// Only capture the part of the mirror that either eye sees, so the capture cost follows how much of the mirror is in view.
+	// The render targets then hold that region of the full captures. The mirror material has to remap its capture UVs with the CaptureRegion parameter.
+	UPROPERTY(EditAnywhere)
+	bool bCaptureVisibleRegionOnly = false;
+
+	// The captured region grows to multiples of this fraction of the full capture, which limits how often the render targets are resized.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCaptureVisibleRegionOnly, ClampMin=0.01, ClampMax=1))
+	float VisibleRegionStep = 0.125;
+
+	// Number of captures the visible region has to stay smaller before the render targets shrink. Growing is immediate.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bCaptureVisibleRegionOnly, ClampMin=0))
+	int32 VisibleRegionShrinkDelay = 30;
+
 	// Resolution capture multiplier. 1 for full resolution capture. More than 1 is oversampling - it can increase sharpness at a high cost.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(ClampMin=0.1, ClampMax=2))
 	float CaptureQuality = 1;
@@ -71,24 +163,79 @@ protected:
 	UPROPERTY(EditAnywhere)
 	float CaptureMaxDistance = 5000;
 
+	// Show a static reflection instead of the live capture on distant mirrors, which stop capturing beyond CaptureMaxDistance.
+	// The mirror material has to sample the StaticReflection parameter with the mesh UVs and blend it in by StaticReflectionBlend.
+	UPROPERTY(EditAnywhere)
+	bool bUseStaticReflection = false;
+
+	// Reflection baked offline, mapped onto the mesh UVs. Without one the mirror captures its own when it initializes.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bUseStaticReflection))
+	TObjectPtr<UTexture> StaticReflectionTexture;
+
+	// Distance before CaptureMaxDistance over which the live capture fades into the static reflection. 0 to switch at once.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bUseStaticReflection, ClampMin=0))
+	float StaticReflectionFadeDistance = 500;
+
+	// How far in front of the mirror the static reflection is captured from, looking straight at the mirror.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bUseStaticReflection, ClampMin=1))
+	float StaticReflectionViewDistance = 300;
+
+	// Pixels along the longer side of the captured static reflection.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bUseStaticReflection, ClampMin=16, ClampMax=4096))
+	int32 StaticReflectionResolution = 512;
+
+	// Skip captures while neither the mirrored camera nor any actor in the show only list has moved or changed visibility since the last capture.
+	UPROPERTY(EditAnywhere)
+	bool bSkipUnchangedCaptures = false;
+
+	// Mirrored camera movement in centimeters that is still considered unchanged.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bSkipUnchangedCaptures, ClampMin=0))
+	float UnchangedCameraLocationTolerance = 0.1;
+
+	// Mirrored camera rotation in degrees that is still considered unchanged.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bSkipUnchangedCaptures, ClampMin=0))
+	float UnchangedCameraRotationTolerance = 0.05;
+
+	// Capture at least this often in seconds even if nothing changed. Without culling there is no show only list, so this is what picks up moving actors.
+	// With culling, actors entering the reflected volume are picked up right away.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bSkipUnchangedCaptures, ClampMin=0.01))
+	float MaxUnchangedCaptureSkipTime = 0.25;
+
 	// Will decrease capture resolution as camera gets further from the mirror.
 	UPROPERTY(EditAnywhere)
 	bool bEnableDynamicCaptureResolution = false;
 
-	// How often do we check and adjust the capture resolution in seconds.
+	// Base the capture resolution on how many screen pixels the mirror covers instead of its distance to the camera.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution))
+	bool bUseScreenCoverage = true;
+
+	// Render target texels per screen pixel covered by the mirror.
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bEnableDynamicCaptureResolution && bUseScreenCoverage", ClampMin=0.1))
+	float ScreenCoverageTexelDensity = 1;
+
+	// How often do we check and adjust the capture resolution in seconds. 0 to check every frame.
 	UPROPERTY(EditAnywhere, meta=(ClampMin=0))
 	float DynamicCaptureCheckInterval = 1;
 
-	// Capture resolution will reach this quality at DynamicCaptureRangeEnd.
+	// Capture quality changes in steps of this size. Each change resizes the render target, which reallocates its texture.
+	// 0 to adjust it continuously, in changes of at least 5% so a check every frame doesn't reallocate on every frame.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution, ClampMin=0, ClampMax=0.5))
+	float DynamicCaptureQualityStep = 0.1;
+
+	// How far past the current quality step the target quality has to go before the resolution changes.
+	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution, ClampMin=0, ClampMax=0.5))
+	float DynamicCaptureQualityHysteresis = 0.05;
+
+	// Capture resolution will never go below this quality. Without screen coverage it is reached at DynamicCaptureRangeEnd.
 	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution, ClampMin=0.1))
 	float LowestDynamicCaptureQuality = 0.5;
 
 	// Capture resolution will be at maximum quality within this distance.
-	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution))
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bEnableDynamicCaptureResolution && !bUseScreenCoverage"))
 	float DynamicCaptureRangeStart = 500;
 
 	// Capture resolution will be at lowest quality at and beyond this distance.
-	UPROPERTY(EditAnywhere, meta=(EditCondition=bEnableDynamicCaptureResolution))
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bEnableDynamicCaptureResolution && !bUseScreenCoverage"))
 	float DynamicCaptureRangeEnd = 2500;
 	
 	// Capture resolution will be at lowest quality at and beyond this distance.
@@ -99,7 +246,11 @@ protected:
 	UPROPERTY(EditAnywhere)
 	float CustomIpdCm = 0;
 
-	// Mirror will capture as long as we are within one of these boxes.
+	// Mirrors with a higher priority lose less quality when the subsystem's frame budget is exceeded.
+	UPROPERTY(EditAnywhere, meta=(ClampMin=0.1))
+	float FrameBudgetPriority = 1;
+
+	// Mirror will capture as long as we are within one of these boxes. Mirror zones and portals gate many mirrors at once without overlap events.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	TArray<TObjectPtr<ATriggerBox>> CaptureTriggers;
 
@@ -116,6 +267,9 @@ protected:
 	UPROPERTY()
 	TObjectPtr<UTextureRenderTarget2D> RenderTargetRightEye;
 
+	UPROPERTY()
+	TObjectPtr<UTextureRenderTarget2D> StaticReflectionTarget;
+
 	UPROPERTY()
 	TObjectPtr<UMaterialInstanceDynamic> MaterialInstanceDynamic;
 
@@ -126,15 +280,35 @@ protected:
 	TObjectPtr<UMaterial> MirrorMaterial;
 
 private:
+	// Times the private culling and skip paths on spawned mirrors.
+	friend class FMirrorBenchmark;
+	friend class TMirrorActorCommon<ACVrMirror>;
+
 	virtual void Destroyed() override;
 	void OnViewportResize(FViewport* Viewport, uint32);
-	void CaptureScene();
+	bool IsCaptureUnchanged(const FTransform& MirroredCameraTransform) const;
+	void CalcFrameView();
+	template <int32 NumViews>
+	void CalcFrameViews();
+	FIntPoint CalcEyeRenderTargetSize() const;
+	void AllocateRenderTargets();
+	void ResizeRenderTargets();
 	void CheckDynamicResolution();
-	void MirrorCulling(const FTransform& MirroredCameraTransform);
-	bool ShouldSkipCapture() const;
-	FTransform MirrorCamera(const FTransform& CameraTransform) const;
+	float CalcScreenCoverageQuality() const;
+	void CalcCullingFrustum(const FVector& MirroredCameraLocation, float EyeMargin,
+	                        TArray<FPlane, TInlineAllocator<6>>& OutPlanes, FVector (&OutCorners)[4]) const;
+	void QueueAsyncCulling(const FVector& MirroredCameraLocation);
+	const FMirrorVisibleSetCell* FindBakedCell(const FVector& MirroredCameraLocation) const;
+	FVector2D CalcViewFov() const;
+	bool IsCameraCut() const;
+	SIZE_T GetCaptureBuffersSize() const;
+	EMirrorSkipReason FindSkipReason() const;
 	static FVector2D GetHmdResolution();
-	TArray<FTransform> CreateEyeOffsets(const FTransform& CameraTransform) const;
+	void CalcCaptureView(const FTransform& MirroredEyeTransform, const FVector (&MirrorCorners)[4],
+	                     FTransform& OutViewTransform, FMatrix& OutProjection) const;
+	void SetCaptureRegion(const FBox2D& Region);
+	void SetStaticReflectionParameters();
+	void UpdateStaticReflectionBlend();
 	float GetIpdCm() const;
 	static FVector2D GetHmdFov();
 	void FindActiveCamera();
@@ -142,10 +316,46 @@ private:
 	int32 HorizontalFov;
 	float InitialCaptureQuality;
 	float IpdHalfDistanceCm;
-	FVector LastTraceCameraPosition = FVector::ZeroVector;
 	bool bIsMobileMultiView = false;
 	bool bIsUsingCaptureTriggers = false;
 	int32 NumActiveCaptureTriggers = 0;
+	float LastCaptureTime = 0;
+	float FrameBudgetScale = 1;
+
+	// Region of the full capture that the render targets hold, in UV space.
+	FBox2D CaptureRegion = FBox2D(FVector2D::ZeroVector, FVector2D::UnitVector);
+	int32 NumSmallerRegionCaptures = 0;
+	FMirrorChangeDetector ChangeDetector;
+
+	// Made by EvaluateFrame and reused by the capture of the same frame. Mono mirrors only use the first eye.
+	struct FFrameEvaluation
+	{
+		static constexpr int32 MaxEyes = 2;
+		uint64 Frame = 0;
+		uint64 ViewFrame = 0;
+		EMirrorSkipReason SkipReason = EMirrorSkipReason::None;
+		bool bIsUnchanged = false;
+		FMirrorCaptureRequest Request;
+		FTransform MirroredCameraTransform = FTransform::Identity;
+		int32 NumEyes = 1;
+		TStaticArray<FTransform, MaxEyes> EyeTransforms;
+		TStaticArray<FTransform, MaxEyes> ViewTransforms;
+		TStaticArray<FMatrix, MaxEyes> Projections;
+		FVector MirrorCorners[4];
+		TArray<FPlane, TInlineAllocator<6>> CullingPlanes;
+		FVector CullingCorners[4];
+	};
+
+	FFrameEvaluation FrameEvaluation;
+	FMirrorCullingCache CullingCache;
+	FMirrorCullingScratch CullingScratch;
+	FMirrorAllocationCounter AllocationCounter;
+	FMirrorStatNames StatNames;
+
+	// Last blend given to the material, so it's only set again when it changes.
+	float StaticReflectionBlend = -1;
+	FVector LastMirroredCameraLocation = FVector::ZeroVector;
+	uint64 LastCullingFrame = 0;
 
 	UFUNCTION()
 	void OnCaptureTriggerBeginOverlap(AActor* OverlappedActor, AActor* OtherActor);
@@ -155,6 +365,9 @@ private:
 	UPROPERTY()
 	TObjectPtr<APlayerController> PlayerController;
 
+	UPROPERTY()
+	TObjectPtr<UVrMirrorSubsystem> MirrorSubsystem;
+
 	// Editor only
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
@@ -0,0 +1,343 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DrawDebugHelpers.h"
+#include "MirrorAsyncCulling.h"
+#include "MirrorCullingCache.h"
+#include "MirrorPrimitiveIndex.h"
+#include "MirrorProjection.h"
+#include "MirrorScratchBuffers.h"
+#include "MirrorStats.h"
+#include "MirrorVisibleSets.h"
+#include "Components/SceneCaptureComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+
+// The parts of ACMirror and ACVrMirror that don't depend on how many views a mirror captures: submitting the frame's
+// evaluation, culling into a capture's show-only lists, baking the visible sets and holding on to the capture region.
+// Works on the mirror's members of the same names. The views and render targets stay with the actor classes.
+// Only included by the mirrors' source files, where both the mirror and its subsystem are complete types.
+template <typename MirrorType>
+class TMirrorActorCommon
+{
+public:
+	// Counts the frame's skip or requests its capture. Runs on the game thread once all mirrors have been evaluated.
+	static void SubmitFrame(MirrorType& Mirror)
+	{
+		typename MirrorType::FFrameEvaluation& FrameEvaluation = Mirror.FrameEvaluation;
+		if (FrameEvaluation.Frame != GFrameCounter)
+		{
+			return;
+		}
+
+		// Distant mirrors don't capture, so the fade to the static reflection is kept up to date even on skipped frames.
+		if (FrameEvaluation.SkipReason != EMirrorSkipReason::NotRendered)
+		{
+			Mirror.UpdateStaticReflectionBlend();
+		}
+
+		// Skips are counted here rather than in the evaluation, which runs on worker threads.
+		if (FrameEvaluation.SkipReason != EMirrorSkipReason::None)
+		{
+			FMirrorStats::CountSkippedCapture(FrameEvaluation.SkipReason);
+			return;
+		}
+
+		// Stop capturing if the mirror's zone can't be seen from the camera's zone. The zone graph updates on first use, so it's asked here.
+		if (Mirror.MirrorSubsystem && !Mirror.MirrorSubsystem->IsMirrorInVisibleZone(
+			&Mirror, Mirror.ActiveCamera->GetComponentTransform(), Mirror.CalcViewFov()))
+		{
+			FMirrorStats::CountSkippedCapture(EMirrorSkipReason::Zone);
+			return;
+		}
+
+		// The index has to have taken in this frame's moves, so it's asked here on the game thread rather than in the evaluation.
+		if (FrameEvaluation.bIsUnchanged && Mirror.bCullingEnabled && Mirror.MirrorSubsystem)
+		{
+			if (const FMirrorPrimitiveIndex* PrimitiveIndex = Mirror.MirrorSubsystem->GetPrimitiveIndex(Mirror.GetWorld()))
+			{
+				FrameEvaluation.bIsUnchanged = !Mirror.ChangeDetector.HasCulledVolumeChanged(*PrimitiveIndex);
+			}
+		}
+
+		if (FrameEvaluation.bIsUnchanged)
+		{
+			FMirrorStats::CountSkippedCapture(EMirrorSkipReason::Unchanged);
+			if (Mirror.MirrorSubsystem)
+			{
+				Mirror.MirrorSubsystem->OnUnchangedCaptureSkipped();
+			}
+			return;
+		}
+
+		if (!Mirror.MirrorSubsystem)
+		{
+			Mirror.CaptureScene();
+			return;
+		}
+
+		Mirror.MirrorSubsystem->RequestCapture(FrameEvaluation.Request);
+	}
+
+	// Fills the capture's show-only lists with what this frame's culling frustum sees.
+	static void MirrorCulling(MirrorType& Mirror, const FVector& MirroredCameraLocation, USceneCaptureComponent& Capture)
+	{
+		MIRROR_SCOPE_CYCLE_COUNTER(Culling);
+
+		UWorld* World = Mirror.GetWorld();
+		FMirrorPrimitiveIndex* PrimitiveIndex = Mirror.MirrorSubsystem ? Mirror.MirrorSubsystem->GetPrimitiveIndex(World) : nullptr;
+		if (!Mirror.bCullingEnabled || !PrimitiveIndex)
+		{
+			return;
+		}
+
+		const bool bUseCullingCache = Mirror.CullingCacheCellSize > 0;
+		const FIntVector CameraCell = bUseCullingCache
+			                              ? FMirrorCullingCache::QuantizeLocation(MirroredCameraLocation,
+			                                                                      Mirror.CullingCacheCellSize)
+			                              : FIntVector::ZeroValue;
+		const float Time = World->GetTimeSeconds();
+		if (bUseCullingCache && Mirror.CullingCache.IsValid(CameraCell, Mirror.GetActorTransform(), *PrimitiveIndex, Time,
+		                                                    Mirror.CullingCacheMaxAge))
+		{
+			return;
+		}
+
+		const TArray<FPlane, TInlineAllocator<6>>& FrustumPlanes = Mirror.FrameEvaluation.CullingPlanes;
+		const FVector (&MirrorCorners)[4] = Mirror.FrameEvaluation.CullingCorners;
+
+		if (Mirror.bShowCullingPlanes)
+		{
+			for (const FPlane& Plane : FrustumPlanes)
+			{
+				DrawDebugSolidPlane(World, Plane, Mirror.MirrorMesh->GetComponentLocation(), 2000,
+				                    FColor::Red.WithAlpha(60));
+			}
+		}
+
+		// Static actors come from the baked sets while the camera is inside the baked region, only movable ones are left to query.
+		const FMirrorVisibleSetCell* BakedCell = Mirror.FindBakedCell(MirroredCameraLocation);
+		FMirrorCullingScratch& CullingScratch = Mirror.CullingScratch;
+		CullingScratch.Reset();
+		TArray<AActor*>& BakedActors = CullingScratch.BakedActors;
+		TArray<UPrimitiveComponent*>& BakedComponents = CullingScratch.BakedComponents;
+		if (BakedCell)
+		{
+			Mirror.VisibleSets.GetActors(*BakedCell, BakedActors);
+			Mirror.VisibleSets.GetComponents(*BakedCell, BakedComponents);
+		}
+
+		TArray<UPrimitiveComponent*>& VisiblePrimitives = CullingScratch.VisiblePrimitives;
+		const FMirrorCullingQuery* AsyncQuery = Mirror.bAsyncCulling
+			                                        ? Mirror.MirrorSubsystem->GetAsyncCullingResult(&Mirror)
+			                                        : nullptr;
+		if (AsyncQuery && AsyncQuery->bMovableOnly == (BakedCell != nullptr) && !Mirror.IsCameraCut() &&
+			FVector::Dist(AsyncQuery->MirroredCameraLocation, MirroredCameraLocation) <= Mirror.AsyncCullingTolerance)
+		{
+			for (UPrimitiveComponent* Primitive : AsyncQuery->VisiblePrimitives)
+			{
+				// The query ran last frame, its primitives may have been destroyed since.
+				if (IsValid(Primitive))
+				{
+					VisiblePrimitives.Add(Primitive);
+				}
+			}
+		}
+		else
+		{
+			PrimitiveIndex->QueryFrustum(FrustumPlanes, Mirror.bCullWithBoxes, VisiblePrimitives, BakedCell != nullptr);
+		}
+
+		// A primitive is visible if its bounds are not completely outside one of the planes.
+		Capture.ShowOnlyActors.Reset();
+		Capture.ShowOnlyComponents.Reset();
+		if (Mirror.bCullPerComponent)
+		{
+			for (UPrimitiveComponent* Primitive : VisiblePrimitives)
+			{
+				Capture.ShowOnlyComponents.Add(Primitive);
+			}
+
+			for (UPrimitiveComponent* Primitive : BakedComponents)
+			{
+				Capture.ShowOnlyComponents.Add(Primitive);
+			}
+
+			// Sets baked while culling per actor hold whole actors.
+			Capture.ShowOnlyActors.Append(BakedActors);
+		}
+		else
+		{
+			// The owning actor of a visible primitive is shown as a whole. Sets baked per component are shown the same way.
+			TSet<AActor*>& VisibleActors = CullingScratch.VisibleActors;
+			VisibleActors.Append(BakedActors);
+			Capture.ShowOnlyActors.Append(BakedActors);
+			for (const TArray<UPrimitiveComponent*>* Primitives : {&VisiblePrimitives, &BakedComponents})
+			{
+				for (const UPrimitiveComponent* Primitive : *Primitives)
+				{
+					AActor* Actor = Primitive->GetOwner();
+					bool bIsAlreadyVisible = false;
+					VisibleActors.Add(Actor, &bIsAlreadyVisible);
+					if (Actor && !bIsAlreadyVisible)
+					{
+						Capture.ShowOnlyActors.Add(Actor);
+					}
+				}
+			}
+		}
+
+		for (AActor* Actor : Mirror.DontCullActors)
+		{
+			Capture.ShowOnlyActors.Add(Actor);
+		}
+
+		// Everything the frustum can see lies between the mirror and the far plane.
+		FBox CulledVolume(ForceInit);
+		for (const FVector& Corner : MirrorCorners)
+		{
+			CulledVolume += Corner;
+			CulledVolume += FMath::RayPlaneIntersection(MirroredCameraLocation, Corner - MirroredCameraLocation,
+			                                            FrustumPlanes[1]);
+		}
+
+		Mirror.ChangeDetector.OnCulled(*PrimitiveIndex, CulledVolume);
+		if (bUseCullingCache)
+		{
+			Mirror.CullingCache.Store(CameraCell, Mirror.GetActorTransform(), *PrimitiveIndex, CulledVolume, Time);
+		}
+	}
+
+	// Bakes the static primitives seen from every cell in front of the mirror. CalcCullingFrustum gives the mirror's frustum
+	// for a mirrored camera location.
+	static void BakeVisibleSets(MirrorType& Mirror,
+	                            TFunctionRef<void(const FVector&, TArray<FPlane, TInlineAllocator<6>>&, FVector (&)[4])>
+	                            CalcCullingFrustum)
+	{
+#if WITH_EDITOR
+		UWorld* World = Mirror.GetWorld();
+		const float CellSize = Mirror.VisibleSetCellSize;
+		if (!World || !Mirror.MirrorMesh || CellSize <= 0)
+		{
+			return;
+		}
+
+		// The subsystem only exists during play, so the bake builds its own index.
+		FMirrorPrimitiveIndex PrimitiveIndex;
+		PrimitiveIndex.Build(World);
+
+		Mirror.Modify();
+		FMirrorVisibleSets& VisibleSets = Mirror.VisibleSets;
+		VisibleSets.Reset();
+		VisibleSets.CellSize = CellSize;
+
+		const FTransform MirrorTransform = Mirror.GetActorTransform();
+		const FVector& BakeExtent = Mirror.VisibleSetBakeExtent;
+		const FIntVector MinCell(0, FMath::FloorToInt(-BakeExtent.Y / CellSize), FMath::FloorToInt(-BakeExtent.Z / CellSize));
+		const FIntVector MaxCell(FMath::CeilToInt(BakeExtent.X / CellSize) - 1, FMath::CeilToInt(BakeExtent.Y / CellSize) - 1,
+		                         FMath::CeilToInt(BakeExtent.Z / CellSize) - 1);
+
+		TMap<AActor*, int32> ActorIndices;
+		TMap<UPrimitiveComponent*, int32> ComponentIndices;
+		TSet<AActor*> CellActors;
+		TSet<UPrimitiveComponent*> CellComponents;
+		TArray<UPrimitiveComponent*> VisiblePrimitives;
+		TArray<FPlane, TInlineAllocator<6>> FrustumPlanes;
+		FVector MirrorCorners[4];
+
+		for (int32 CellX = MinCell.X; CellX <= MaxCell.X; CellX++)
+		{
+			for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; CellY++)
+			{
+				for (int32 CellZ = MinCell.Z; CellZ <= MaxCell.Z; CellZ++)
+				{
+					CellActors.Reset();
+					CellComponents.Reset();
+
+					// Cameras on a 3x3x3 lattice over the cell, its corners included.
+					for (int32 Sample = 0; Sample < 27; Sample++)
+					{
+						const FVector CellFraction(Sample % 3 / 2.f, Sample / 3 % 3 / 2.f, Sample / 9 / 2.f);
+						const FVector LocalCameraLocation = (FVector(CellX, CellY, CellZ) + CellFraction) * CellSize;
+
+						// Cameras behind the mirror don't capture, the closest ones in front of it stand in for them.
+						const FVector MirroredCameraLocation = MirrorTransform.TransformPositionNoScale(
+							FVector(-FMath::Max(LocalCameraLocation.X, 1.0), LocalCameraLocation.Y, LocalCameraLocation.Z));
+
+						CalcCullingFrustum(MirroredCameraLocation, FrustumPlanes, MirrorCorners);
+						VisiblePrimitives.Reset();
+						PrimitiveIndex.QueryFrustum(FrustumPlanes, Mirror.bCullWithBoxes, VisiblePrimitives);
+
+						// Movable primitives are culled at runtime.
+						for (UPrimitiveComponent* Primitive : VisiblePrimitives)
+						{
+							if (Primitive->Mobility == EComponentMobility::Movable || !Primitive->GetOwner())
+							{
+								continue;
+							}
+
+							if (Mirror.bCullPerComponent)
+							{
+								CellComponents.Add(Primitive);
+							}
+							else
+							{
+								CellActors.Add(Primitive->GetOwner());
+							}
+						}
+					}
+
+					if (CellActors.Num() == 0 && CellComponents.Num() == 0)
+					{
+						continue;
+					}
+
+					FMirrorVisibleSetCell& Cell = VisibleSets.Cells.Add(FIntVector(CellX, CellY, CellZ));
+					FMirrorVisibleSets::AddIndices(CellActors, VisibleSets.Actors, ActorIndices, Cell.ActorIndices);
+					FMirrorVisibleSets::AddIndices(CellComponents, VisibleSets.Components, ComponentIndices,
+					                               Cell.ComponentIndices);
+				}
+			}
+		}
+
+		const FString BakeResult = FString::Printf(TEXT("%s: baked %d cells with %d actors and %d components."),
+		                                           *Mirror.GetActorNameOrLabel(), VisibleSets.Cells.Num(),
+		                                           VisibleSets.Actors.Num(), VisibleSets.Components.Num());
+		GEngine->AddOnScreenDebugMessage(-1, 5, FColor::Green, BakeResult);
+#endif
+	}
+
+	// Takes the region of the full capture that is visible. Shrinking reallocates the render targets, so a smaller region is
+	// only taken once it has stayed smaller for VisibleRegionShrinkDelay captures, until then the current region is moved over it.
+	// False if the capture region stays as it is. Moving the region around doesn't change the render targets' size.
+	static bool UpdateCaptureRegion(MirrorType& Mirror, const FBox2D& Region, bool& bOutSizeChanged)
+	{
+		// A mirror that is not seen at all keeps its last region.
+		if (!Region.bIsValid)
+		{
+			return false;
+		}
+
+		FBox2D NewRegion = Region;
+		const FVector2D Size = Region.GetSize();
+		const FVector2D CurrentSize = Mirror.CaptureRegion.GetSize();
+		const bool bFitsCurrent = Size.X <= CurrentSize.X + KINDA_SMALL_NUMBER && Size.Y <= CurrentSize.Y + KINDA_SMALL_NUMBER;
+		if (bFitsCurrent && !Size.Equals(CurrentSize) && ++Mirror.NumSmallerRegionCaptures <= Mirror.VisibleRegionShrinkDelay)
+		{
+			NewRegion = FMirrorProjection::CoverRegion(Mirror.CaptureRegion, Region);
+		}
+		else
+		{
+			Mirror.NumSmallerRegionCaptures = 0;
+		}
+
+		if (NewRegion == Mirror.CaptureRegion)
+		{
+			return false;
+		}
+
+		bOutSizeChanged = !NewRegion.GetSize().Equals(CurrentSize);
+		Mirror.CaptureRegion = NewRegion;
+		return true;
+	}
+};
@@ -0,0 +1,89 @@
+#include "MirrorAsyncCulling.h"
+#include "MirrorStats.h"
+#include "MirrorPrimitiveIndex.h"
+
+FMirrorAsyncCulling::~FMirrorAsyncCulling()
+{
+	Wait();
+}
+
+FMirrorCullingQuery& FMirrorAsyncCulling::AddQuery(const AActor* Mirror)
+{
+	FMirrorCullingQuery& Query = PendingQueries.FindOrAdd(Mirror);
+	NumPendingQueries += Query.bIsQueued ? 0 : 1;
+	Query.bIsQueued = true;
+	Query.Planes.Reset();
+	Query.VisiblePrimitives.Reset();
+	return Query;
+}
+
+void FMirrorAsyncCulling::Launch(FMirrorPrimitiveIndex& PrimitiveIndex)
+{
+	Wait();
+
+	// Swapping keeps both maps and the result arrays of their queries allocated from one launch to the next.
+	Swap(Queries, PendingQueries);
+	for (TPair<TObjectKey<AActor>, FMirrorCullingQuery>& Pair : PendingQueries)
+	{
+		Pair.Value.bIsQueued = false;
+	}
+
+	const bool bHasQueries = NumPendingQueries > 0;
+	NumPendingQueries = 0;
+	if (!bHasQueries)
+	{
+		return;
+	}
+
+	// The index's scratch buffers are shared, so the queries run one after another in a single task.
+	Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, &PrimitiveIndex]()
+	{
+		MIRROR_SCOPE_CYCLE_COUNTER(AsyncCulling);
+
+		for (TPair<TObjectKey<AActor>, FMirrorCullingQuery>& Pair : Queries)
+		{
+			FMirrorCullingQuery& Query = Pair.Value;
+			if (Query.bIsQueued)
+			{
+				PrimitiveIndex.QueryFrustum(Query.Planes, Query.bUseBoxes, Query.VisiblePrimitives, Query.bMovableOnly);
+			}
+		}
+	});
+}
+
+void FMirrorAsyncCulling::Wait()
+{
+	if (Task.IsValid())
+	{
+		Task.Wait();
+		Task = UE::Tasks::FTask();
+	}
+}
+
+const FMirrorCullingQuery* FMirrorAsyncCulling::FindResult(const AActor* Mirror)
+{
+	Wait();
+	const FMirrorCullingQuery* Query = Queries.Find(Mirror);
+	return Query && Query->bIsQueued ? Query : nullptr;
+}
+
+void FMirrorAsyncCulling::DiscardResults()
+{
+	Wait();
+	Queries.Reset();
+	for (auto It = PendingQueries.CreateIterator(); It; ++It)
+	{
+		if (!It->Value.bIsQueued)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FMirrorAsyncCulling::Reset()
+{
+	Wait();
+	Queries.Empty();
+	PendingQueries.Empty();
+	NumPendingQueries = 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+#include "UObject/ObjectKey.h"
+
+class FMirrorPrimitiveIndex;
+class UPrimitiveComponent;
+
+// A mirror's culling query for the next frame, made from where its mirrored camera is expected to be.
+struct FMirrorCullingQuery
+{
+	TArray<FPlane, TInlineAllocator<6>> Planes;
+	FVector MirroredCameraLocation = FVector::ZeroVector;
+	bool bUseBoxes = true;
+	bool bMovableOnly = false;
+
+	// Queries stay in their map between launches to keep their memory, only queued ones are run.
+	bool bIsQueued = false;
+
+	// Filled by the task. Primitives may have been destroyed since, but not garbage collected.
+	TArray<UPrimitiveComponent*> VisiblePrimitives;
+};
+
+// Runs the culling queries of all mirrors on a worker thread between two frames, so their captures find the results ready.
+// The primitive index is read by the task, so it must not be changed before Wait returns.
+class UE5_MIRRORS_API FMirrorAsyncCulling
+{
+public:
+	~FMirrorAsyncCulling();
+
+	// Replaces the query already added for this mirror.
+	FMirrorCullingQuery& AddQuery(const AActor* Mirror);
+	bool HasPendingQueries() const { return NumPendingQueries > 0; }
+
+	// Starts the queries added since the last launch. The results of the last launch are dropped.
+	void Launch(FMirrorPrimitiveIndex& PrimitiveIndex);
+
+	void Wait();
+
+	// Waits for the running queries. Null if none was launched for this mirror.
+	const FMirrorCullingQuery* FindResult(const AActor* Mirror);
+
+	// Garbage collection may free the primitives the results point to. Also forgets mirrors that stopped queueing.
+	void DiscardResults();
+
+	void Reset();
+
+private:
+	TMap<TObjectKey<AActor>, FMirrorCullingQuery> PendingQueries;
+	TMap<TObjectKey<AActor>, FMirrorCullingQuery> Queries;
+	UE::Tasks::FTask Task;
+	int32 NumPendingQueries = 0;
+};
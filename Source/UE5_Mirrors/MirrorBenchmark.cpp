@@ -0,0 +1,502 @@
+#include "MirrorBenchmark.h"
+#include "CMirror.h"
+#include "CVrMirror.h"
+#include "MirrorActorCommon.h"
+#include "MirrorCore.h"
+#include "MirrorPrimitiveIndex.h"
+#include "MirrorSubsystem.h"
+#include "VrMirrorSubsystem.h"
+#include "Camera/CameraActor.h"
+#include "Camera/CameraComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Dom/JsonObject.h"
+#include "Dom/JsonValue.h"
+#include "Engine/GameInstance.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMirrorBenchmark, Log, All);
+
+static FAutoConsoleCommandWithWorldAndArgs MirrorBenchmarkCommand(
+	TEXT("Mirrors.Benchmark"),
+	TEXT("Time the mirror CPU paths on a spawned scene and write the results to Saved/Profiling/Mirrors. ")
+	TEXT("Args: NumMirrors= NumVrMirrors= StaticProps= DynamicProps= NumFrames= Warmup= PropExtent= Seed= Baseline= Tolerance="),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		FMirrorBenchmarkSettings Settings;
+		Settings.Parse(*FString::Join(Args, TEXT(" ")));
+
+		// Unattended runs exit with a failure code, so a regression fails the job that ran them.
+		if (!FMirrorBenchmark(Settings).Run(World) && FApp::IsUnattended())
+		{
+			FPlatformMisc::RequestExitWithStatus(false, 1);
+		}
+	}));
+
+void FMirrorBenchmarkSettings::Parse(const TCHAR* Args)
+{
+	FParse::Value(Args, TEXT("NumMirrors="), NumMirrors);
+	FParse::Value(Args, TEXT("NumVrMirrors="), NumVrMirrors);
+	FParse::Value(Args, TEXT("StaticProps="), NumStaticProps);
+	FParse::Value(Args, TEXT("DynamicProps="), NumDynamicProps);
+	FParse::Value(Args, TEXT("NumFrames="), NumFrames);
+	FParse::Value(Args, TEXT("Warmup="), NumWarmupFrames);
+	FParse::Value(Args, TEXT("PropExtent="), PropExtent);
+	FParse::Value(Args, TEXT("Seed="), Seed);
+	FParse::Value(Args, TEXT("Baseline="), BaselinePath);
+	FParse::Value(Args, TEXT("Tolerance="), RegressionTolerance);
+
+	NumMirrors = FMath::Max(NumMirrors, 0);
+	NumVrMirrors = FMath::Max(NumVrMirrors, 0);
+	NumStaticProps = FMath::Max(NumStaticProps, 0);
+	NumDynamicProps = FMath::Max(NumDynamicProps, 0);
+	NumFrames = FMath::Max(NumFrames, 1);
+	NumWarmupFrames = FMath::Max(NumWarmupFrames, 0);
+	PropExtent = FMath::Max(PropExtent, 200.f);
+}
+
+FMirrorBenchmark::FMirrorBenchmark(const FMirrorBenchmarkSettings& InSettings)
+	: Settings(InSettings)
+{
+}
+
+template <typename FunctionType>
+void FMirrorBenchmark::TimeOperation(const EOperation Operation, const bool bRecord, FunctionType&& Function)
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	Function();
+	const double TimeMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+
+	if (bRecord)
+	{
+		Results[Operation].FrameTimesMs.Add(TimeMs);
+	}
+}
+
+const TCHAR* FMirrorBenchmark::GetOperationName(const EOperation Operation)
+{
+	switch (Operation)
+	{
+	case Registration: return TEXT("Registration");
+	case SkipCapture: return TEXT("SkipCapture");
+	case MirrorCamera: return TEXT("MirrorCamera");
+	case MirrorCulling: return TEXT("MirrorCulling");
+	case VrRegistration: return TEXT("VrRegistration");
+	case VrSkipCapture: return TEXT("VrSkipCapture");
+	case VrMirrorCamera: return TEXT("VrMirrorCamera");
+	case VrMirrorCulling: return TEXT("VrMirrorCulling");
+	default: return TEXT("Unknown");
+	}
+}
+
+bool FMirrorBenchmark::Run(UWorld* InWorld)
+{
+	if (!InWorld || !InWorld->IsGameWorld())
+	{
+		UE_LOG(LogMirrorBenchmark, Error, TEXT("Mirrors.Benchmark needs a game world."));
+		return false;
+	}
+
+	SpawnScene(InWorld);
+	for (int32 Frame = 0; Frame < Settings.NumWarmupFrames + Settings.NumFrames; Frame++)
+	{
+		RunFrame(Frame, Frame >= Settings.NumWarmupFrames);
+	}
+
+	DestroyScene();
+
+	Summarize();
+	CompareWithBaseline();
+	WriteResults();
+
+	for (const FOperationResult& Result : Results)
+	{
+		if (Result.bRegressed)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FMirrorBenchmark::SpawnScene(UWorld* InWorld)
+{
+	World = InWorld;
+	if (const UGameInstance* GameInstance = World->GetGameInstance())
+	{
+		MirrorSubsystem = GameInstance->GetSubsystem<UMirrorSubsystem>();
+		VrMirrorSubsystem = GameInstance->GetSubsystem<UVrMirrorSubsystem>();
+	}
+
+	FRandomStream Random(Settings.Seed);
+	UStaticMesh* CubeMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+
+	// The mirrors stand in a wall on the YZ plane facing +X. A scaled cube gives them a 200 by 300 mirror surface.
+	const int32 NumAllMirrors = Settings.NumMirrors + Settings.NumVrMirrors;
+	const int32 NumColumns = FMath::Max(FMath::CeilToInt(FMath::Sqrt(static_cast<float>(NumAllMirrors))), 1);
+	const int32 NumRows = FMath::Max(FMath::DivideAndRoundUp(NumAllMirrors, NumColumns), 1);
+	WallCenter = FVector(0, (NumColumns - 1) * MirrorSpacing * 0.5, (NumRows - 1) * MirrorSpacing * 0.5);
+	WallHalfWidth = NumColumns * MirrorSpacing * 0.5;
+	const FVector MirrorMeshScale(0.01, 2, 3);
+
+	Camera = World->SpawnActor<ACameraActor>();
+	UCameraComponent* CameraComponent = Camera->GetCameraComponent();
+
+	for (int32 Index = 0; Index < NumAllMirrors; Index++)
+	{
+		const FTransform MirrorTransform(FVector(0, (Index % NumColumns) * MirrorSpacing, (Index / NumColumns) * MirrorSpacing));
+		if (Index < Settings.NumMirrors)
+		{
+			ACMirror* Mirror = World->SpawnActorDeferred<ACMirror>(ACMirror::StaticClass(), MirrorTransform);
+			Mirror->bCullingEnabled = true;
+			Mirror->CullingCacheCellSize = 0;
+			Mirror->bUseBakedVisibleSets = false;
+			Mirror->bAsyncCulling = false;
+			Mirror->MirrorMesh->SetStaticMesh(CubeMesh);
+			Mirror->MirrorMesh->SetRelativeScale3D(MirrorMeshScale);
+			Mirror->FinishSpawning(MirrorTransform);
+			Mirror->ActiveCamera = CameraComponent;
+			Mirrors.Add(Mirror);
+		}
+		else
+		{
+			ACVrMirror* Mirror = World->SpawnActorDeferred<ACVrMirror>(ACVrMirror::StaticClass(), MirrorTransform);
+			Mirror->bIsStereoscopic = true;
+			Mirror->bCullingEnabled = true;
+			Mirror->CullingCacheCellSize = 0;
+			Mirror->bUseBakedVisibleSets = false;
+			Mirror->bAsyncCulling = false;
+			Mirror->MirrorMesh->SetStaticMesh(CubeMesh);
+			Mirror->MirrorMesh->SetRelativeScale3D(MirrorMeshScale);
+			Mirror->FinishSpawning(MirrorTransform);
+			// Init would read this from the HMD, which a headless run doesn't have.
+			Mirror->IpdHalfDistanceCm = 3.2f;
+			Mirror->ActiveCamera = CameraComponent;
+			VrMirrors.Add(Mirror);
+		}
+	}
+
+	// Props are scattered in the box in front of the wall that the reflections look into.
+	const float HalfExtent = Settings.PropExtent * 0.5f;
+	for (int32 Index = 0; Index < Settings.NumStaticProps + Settings.NumDynamicProps; Index++)
+	{
+		const bool bIsDynamic = Index >= Settings.NumStaticProps;
+		const FVector Location = WallCenter + FVector(Random.FRandRange(100, Settings.PropExtent),
+		                                              Random.FRandRange(-HalfExtent, HalfExtent),
+		                                              Random.FRandRange(-HalfExtent, HalfExtent));
+		AStaticMeshActor* Prop = World->SpawnActor<AStaticMeshActor>(Location, FRotator(0, Random.FRandRange(0, 360), 0));
+		UStaticMeshComponent* PropMesh = Prop->GetStaticMeshComponent();
+
+		// Static components only take a new mesh while they are movable.
+		PropMesh->SetMobility(EComponentMobility::Movable);
+		PropMesh->SetStaticMesh(CubeMesh);
+		PropMesh->SetWorldScale3D(FVector(Random.FRandRange(0.2f, 2.f)));
+		PropMesh->SetMobility(bIsDynamic ? EComponentMobility::Movable : EComponentMobility::Static);
+		(bIsDynamic ? DynamicProps : StaticProps).Add(Prop);
+	}
+
+	// The props got their meshes after they were spawned, so the index is built again with all of them in place.
+	if (FMirrorPrimitiveIndex* PrimitiveIndex = MirrorSubsystem ? MirrorSubsystem->GetPrimitiveIndex(World) : nullptr)
+	{
+		PrimitiveIndex->Build(World);
+	}
+
+	UE_LOG(LogMirrorBenchmark, Display, TEXT("Spawned %d mirrors, %d VR mirrors, %d static and %d dynamic props."),
+	       Mirrors.Num(), VrMirrors.Num(), StaticProps.Num(), DynamicProps.Num());
+}
+
+void FMirrorBenchmark::DestroyScene()
+{
+	for (ACMirror* Mirror : Mirrors)
+	{
+		Mirror->Destroy();
+	}
+
+	for (ACVrMirror* Mirror : VrMirrors)
+	{
+		Mirror->Destroy();
+	}
+
+	for (AStaticMeshActor* Prop : StaticProps)
+	{
+		Prop->Destroy();
+	}
+
+	for (AStaticMeshActor* Prop : DynamicProps)
+	{
+		Prop->Destroy();
+	}
+
+	Camera->Destroy();
+	Mirrors.Empty();
+	VrMirrors.Empty();
+	StaticProps.Empty();
+	DynamicProps.Empty();
+	Camera = nullptr;
+}
+
+void FMirrorBenchmark::RunFrame(const int32 Frame, const bool bRecord)
+{
+	// The camera sweeps along the wall, so every frame culls different frustums.
+	const double Phase = static_cast<double>(Frame) / Settings.NumFrames * UE_DOUBLE_TWO_PI;
+	const FVector CameraLocation = WallCenter + FVector(600, FMath::Sin(Phase) * WallHalfWidth, FMath::Cos(Phase) * 100);
+	Camera->SetActorLocationAndRotation(CameraLocation, (WallCenter - CameraLocation).Rotation());
+	const FTransform CameraTransform = Camera->GetCameraComponent()->GetComponentTransform();
+
+	// Dynamic props bob up and down, so the primitive index has moves to take in.
+	const FVector PropOffset(0, 0, Frame % 2 == 0 ? 10 : -10);
+	for (AStaticMeshActor* Prop : DynamicProps)
+	{
+		Prop->AddActorWorldOffset(PropOffset);
+	}
+
+	TimeOperation(Registration, bRecord, [this]()
+	{
+		if (!MirrorSubsystem)
+		{
+			return;
+		}
+
+		for (ACMirror* Mirror : Mirrors)
+		{
+			MirrorSubsystem->OnMirrorDestroyed(Mirror);
+			MirrorSubsystem->OnMirrorCreated(Mirror);
+		}
+	});
+
+	TimeOperation(VrRegistration, bRecord, [this]()
+	{
+		if (!VrMirrorSubsystem)
+		{
+			return;
+		}
+
+		for (ACVrMirror* Mirror : VrMirrors)
+		{
+			VrMirrorSubsystem->OnMirrorDestroyed(Mirror);
+			VrMirrorSubsystem->OnMirrorCreated(Mirror);
+		}
+	});
+
+	// Without a renderer no mirror was recently rendered, so this mostly measures the early out.
+	TimeOperation(SkipCapture, bRecord, [this]()
+	{
+		for (const ACMirror* Mirror : Mirrors)
+		{
+			Sink += static_cast<double>(Mirror->FindSkipReason());
+		}
+	});
+
+	TimeOperation(VrSkipCapture, bRecord, [this]()
+	{
+		for (const ACVrMirror* Mirror : VrMirrors)
+		{
+			Sink += static_cast<double>(Mirror->FindSkipReason());
+		}
+	});
+
+	TimeOperation(MirrorCamera, bRecord, [this, &CameraTransform]()
+	{
+		for (const ACMirror* Mirror : Mirrors)
+		{
+			Sink += TMirrorCore<1>::MirrorCamera(Mirror->GetActorTransform(), CameraTransform).GetLocation().X;
+		}
+	});
+
+	TimeOperation(VrMirrorCamera, bRecord, [this, &CameraTransform]()
+	{
+		for (const ACVrMirror* Mirror : VrMirrors)
+		{
+			const FTransform MirroredCameraTransform = TMirrorCore<2>::MirrorCamera(Mirror->GetActorTransform(), CameraTransform);
+			const TMirrorCore<2>::FViewTransforms EyeTransforms = TMirrorCore<2>::CalcViewTransforms(
+				MirroredCameraTransform, Mirror->IpdHalfDistanceCm * 2);
+			Sink += EyeTransforms[0].GetLocation().X + EyeTransforms[1].GetLocation().X;
+		}
+	});
+
+	// The captures get their frustums from the frame's evaluation, which needs a rendered mirror. They're worked out here instead.
+	TArray<FVector> MirroredCameraLocations;
+	for (ACMirror* Mirror : Mirrors)
+	{
+		const FVector MirroredCameraLocation = TMirrorCore<1>::MirrorCamera(Mirror->GetActorTransform(), CameraTransform).
+			GetLocation();
+		Mirror->CalcCullingFrustum(MirroredCameraLocation, Mirror->FrameEvaluation.CullingPlanes,
+		                           Mirror->FrameEvaluation.CullingCorners);
+		MirroredCameraLocations.Add(MirroredCameraLocation);
+	}
+
+	TArray<FTransform> MirroredCameraTransforms;
+	for (ACVrMirror* Mirror : VrMirrors)
+	{
+		const FTransform MirroredCameraTransform = TMirrorCore<2>::MirrorCamera(Mirror->GetActorTransform(), CameraTransform);
+		Mirror->CalcCullingFrustum(MirroredCameraTransform.GetLocation(),
+		                           TMirrorCore<2>::CalcViewMargin(Mirror->IpdHalfDistanceCm * 2),
+		                           Mirror->FrameEvaluation.CullingPlanes, Mirror->FrameEvaluation.CullingCorners);
+		MirroredCameraTransforms.Add(MirroredCameraTransform);
+	}
+
+	TimeOperation(MirrorCulling, bRecord, [this, &MirroredCameraLocations]()
+	{
+		// A frame's first culling takes in the prop moves, so it's part of the cost.
+		if (FMirrorPrimitiveIndex* PrimitiveIndex = MirrorSubsystem ? MirrorSubsystem->GetPrimitiveIndex(World) : nullptr)
+		{
+			PrimitiveIndex->Update();
+		}
+
+		for (int32 Index = 0; Index < Mirrors.Num(); Index++)
+		{
+			TMirrorActorCommon<ACMirror>::MirrorCulling(*Mirrors[Index], MirroredCameraLocations[Index],
+			                                            *Mirrors[Index]->SceneCapture);
+		}
+	});
+
+	TimeOperation(VrMirrorCulling, bRecord, [this, &MirroredCameraTransforms]()
+	{
+		for (int32 Index = 0; Index < VrMirrors.Num(); Index++)
+		{
+			TMirrorActorCommon<ACVrMirror>::MirrorCulling(*VrMirrors[Index], MirroredCameraTransforms[Index].GetLocation(),
+			                                              *VrMirrors[Index]->SceneCaptureLeftEye);
+		}
+	});
+}
+
+void FMirrorBenchmark::Summarize()
+{
+	for (FOperationResult& Result : Results)
+	{
+		if (Result.FrameTimesMs.IsEmpty())
+		{
+			continue;
+		}
+
+		TArray<double> SortedTimesMs = Result.FrameTimesMs;
+		SortedTimesMs.Sort();
+
+		double TotalMs = 0;
+		for (const double TimeMs : SortedTimesMs)
+		{
+			TotalMs += TimeMs;
+		}
+
+		Result.MeanMs = TotalMs / SortedTimesMs.Num();
+		Result.MedianMs = SortedTimesMs[SortedTimesMs.Num() / 2];
+		Result.P95Ms = SortedTimesMs[FMath::FloorToInt((SortedTimesMs.Num() - 1) * 0.95)];
+		Result.MaxMs = SortedTimesMs.Last();
+	}
+}
+
+void FMirrorBenchmark::CompareWithBaseline()
+{
+	if (Settings.BaselinePath.IsEmpty())
+	{
+		return;
+	}
+
+	FString BaselineJson;
+	TSharedPtr<FJsonObject> Baseline;
+	const TArray<TSharedPtr<FJsonValue>>* BaselineOperations = nullptr;
+	if (!FFileHelper::LoadFileToString(BaselineJson, *Settings.BaselinePath) ||
+		!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(BaselineJson), Baseline) || !Baseline.IsValid() ||
+		!Baseline->TryGetArrayField(TEXT("Operations"), BaselineOperations))
+	{
+		UE_LOG(LogMirrorBenchmark, Error, TEXT("Could not read the baseline %s."), *Settings.BaselinePath);
+		return;
+	}
+
+	for (const TSharedPtr<FJsonValue>& Value : *BaselineOperations)
+	{
+		const TSharedPtr<FJsonObject>* Operation = nullptr;
+		FString Name;
+		double BaselineMedianMs = 0;
+		if (!Value->TryGetObject(Operation) || !(*Operation)->TryGetStringField(TEXT("Name"), Name) ||
+			!(*Operation)->TryGetNumberField(TEXT("MedianMs"), BaselineMedianMs))
+		{
+			continue;
+		}
+
+		for (int32 Index = 0; Index < NumOperations; Index++)
+		{
+			if (Name != GetOperationName(static_cast<EOperation>(Index)))
+			{
+				continue;
+			}
+
+			FOperationResult& Result = Results[Index];
+			Result.bHasBaseline = true;
+			Result.BaselineMedianMs = BaselineMedianMs;
+			Result.bRegressed = BaselineMedianMs > 0 &&
+				Result.MedianMs > BaselineMedianMs * (1 + Settings.RegressionTolerance / 100);
+			if (Result.bRegressed)
+			{
+				UE_LOG(LogMirrorBenchmark, Error, TEXT("%s regressed, median %.4f ms against %.4f ms in the baseline."),
+				       *Name, Result.MedianMs, BaselineMedianMs);
+			}
+		}
+	}
+}
+
+void FMirrorBenchmark::WriteResults() const
+{
+	const TSharedRef<FJsonObject> SettingsObject = MakeShared<FJsonObject>();
+	SettingsObject->SetNumberField(TEXT("NumMirrors"), Settings.NumMirrors);
+	SettingsObject->SetNumberField(TEXT("NumVrMirrors"), Settings.NumVrMirrors);
+	SettingsObject->SetNumberField(TEXT("NumStaticProps"), Settings.NumStaticProps);
+	SettingsObject->SetNumberField(TEXT("NumDynamicProps"), Settings.NumDynamicProps);
+	SettingsObject->SetNumberField(TEXT("NumFrames"), Settings.NumFrames);
+	SettingsObject->SetNumberField(TEXT("PropExtent"), Settings.PropExtent);
+	SettingsObject->SetNumberField(TEXT("Seed"), Settings.Seed);
+
+	TArray<TSharedPtr<FJsonValue>> Operations;
+	FString Csv = TEXT("Operation,MeanMs,MedianMs,P95Ms,MaxMs,BaselineMedianMs,Regressed\n");
+	bool bRegressed = false;
+	for (int32 Index = 0; Index < NumOperations; Index++)
+	{
+		const FOperationResult& Result = Results[Index];
+		const TCHAR* Name = GetOperationName(static_cast<EOperation>(Index));
+
+		const TSharedRef<FJsonObject> Operation = MakeShared<FJsonObject>();
+		Operation->SetStringField(TEXT("Name"), Name);
+		Operation->SetNumberField(TEXT("MeanMs"), Result.MeanMs);
+		Operation->SetNumberField(TEXT("MedianMs"), Result.MedianMs);
+		Operation->SetNumberField(TEXT("P95Ms"), Result.P95Ms);
+		Operation->SetNumberField(TEXT("MaxMs"), Result.MaxMs);
+		if (Result.bHasBaseline)
+		{
+			Operation->SetNumberField(TEXT("BaselineMedianMs"), Result.BaselineMedianMs);
+			Operation->SetBoolField(TEXT("bRegressed"), Result.bRegressed);
+		}
+		Operations.Add(MakeShared<FJsonValueObject>(Operation));
+
+		Csv += FString::Printf(TEXT("%s,%.4f,%.4f,%.4f,%.4f,%s,%d\n"), Name, Result.MeanMs, Result.MedianMs,
+		                       Result.P95Ms, Result.MaxMs,
+		                       Result.bHasBaseline ? *FString::Printf(TEXT("%.4f"), Result.BaselineMedianMs) : TEXT(""),
+		                       Result.bRegressed ? 1 : 0);
+		bRegressed |= Result.bRegressed;
+
+		UE_LOG(LogMirrorBenchmark, Display, TEXT("%-16s mean %.4f ms, median %.4f ms, p95 %.4f ms, max %.4f ms"), Name,
+		       Result.MeanMs, Result.MedianMs, Result.P95Ms, Result.MaxMs);
+	}
+
+	const TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetObjectField(TEXT("Settings"), SettingsObject);
+	Root->SetArrayField(TEXT("Operations"), Operations);
+	Root->SetBoolField(TEXT("bRegressed"), bRegressed);
+
+	FString Json;
+	FJsonSerializer::Serialize(Root, TJsonWriterFactory<>::Create(&Json));
+
+	const FString Directory = FPaths::ProfilingDir() / TEXT("Mirrors");
+	const FString BasePath = Directory / (TEXT("Benchmark-") + FDateTime::Now().ToString());
+	IFileManager::Get().MakeDirectory(*Directory, true);
+	FFileHelper::SaveStringToFile(Json, *(BasePath + TEXT(".json")));
+	FFileHelper::SaveStringToFile(Csv, *(BasePath + TEXT(".csv")));
+	UE_LOG(LogMirrorBenchmark, Display, TEXT("Wrote %s.json and .csv"), *BasePath);
+}
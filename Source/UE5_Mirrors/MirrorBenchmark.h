@@ -0,0 +1,106 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ACameraActor;
+class ACMirror;
+class ACVrMirror;
+class AStaticMeshActor;
+class UMirrorSubsystem;
+class UVrMirrorSubsystem;
+class UWorld;
+
+// Scene and run settings of Mirrors.Benchmark. Each can be passed to the command as Name=Value.
+struct UE5_MIRRORS_API FMirrorBenchmarkSettings
+{
+	int32 NumMirrors = 16;
+	int32 NumVrMirrors = 4;
+	int32 NumStaticProps = 2000;
+	int32 NumDynamicProps = 200;
+	int32 NumFrames = 120;
+
+	// Frames run before timing starts. The first frame builds the primitive index.
+	int32 NumWarmupFrames = 5;
+
+	// Props are scattered in front of the mirrors up to this distance.
+	float PropExtent = 5000;
+	int32 Seed = 1;
+
+	// JSON results of an earlier run to compare against.
+	FString BaselinePath;
+
+	// Median frame time increase in percent over the baseline that counts as a regression.
+	float RegressionTolerance = 10;
+
+	void Parse(const TCHAR* Args);
+};
+
+// Times the CPU side of mirrors on a procedurally spawned scene, one sample per operation and frame. Nothing is rendered,
+// so it runs headless: -game -nullrhi -unattended -ExecCmds="Mirrors.Benchmark NumFrames=300 Baseline=<path>, Quit"
+// Results go to Saved/Profiling/Mirrors as JSON and CSV. Regressions against the baseline are logged as errors and make
+// unattended runs exit with code 1. The UE5_Mirrors.Benchmark automation test runs it too, taking the settings from the command line.
+class UE5_MIRRORS_API FMirrorBenchmark
+{
+public:
+	explicit FMirrorBenchmark(const FMirrorBenchmarkSettings& InSettings);
+
+	// Spawns the scene into World, runs it and destroys it again. False if any operation regressed against the baseline.
+	bool Run(UWorld* InWorld);
+
+private:
+	enum EOperation
+	{
+		Registration,
+		SkipCapture,
+		MirrorCamera,
+		MirrorCulling,
+		VrRegistration,
+		VrSkipCapture,
+		VrMirrorCamera,
+		VrMirrorCulling,
+		NumOperations
+	};
+
+	struct FOperationResult
+	{
+		TArray<double> FrameTimesMs;
+		double MeanMs = 0;
+		double MedianMs = 0;
+		double P95Ms = 0;
+		double MaxMs = 0;
+		double BaselineMedianMs = 0;
+		bool bHasBaseline = false;
+		bool bRegressed = false;
+	};
+
+	// Distance between neighbouring mirrors of the spawned mirror wall.
+	static constexpr float MirrorSpacing = 400;
+
+	static const TCHAR* GetOperationName(EOperation Operation);
+
+	void SpawnScene(UWorld* InWorld);
+	void DestroyScene();
+	void RunFrame(int32 Frame, bool bRecord);
+	void Summarize();
+	void CompareWithBaseline();
+	void WriteResults() const;
+
+	template <typename FunctionType>
+	void TimeOperation(EOperation Operation, bool bRecord, FunctionType&& Function);
+
+	FMirrorBenchmarkSettings Settings;
+	FOperationResult Results[NumOperations];
+	double Sink = 0;
+
+	// The run doesn't let garbage collection happen, so the scene can be held by plain pointers.
+	UWorld* World = nullptr;
+	UMirrorSubsystem* MirrorSubsystem = nullptr;
+	UVrMirrorSubsystem* VrMirrorSubsystem = nullptr;
+	ACameraActor* Camera = nullptr;
+	TArray<ACMirror*> Mirrors;
+	TArray<ACVrMirror*> VrMirrors;
+	TArray<AStaticMeshActor*> StaticProps;
+	TArray<AStaticMeshActor*> DynamicProps;
+	FVector WallCenter = FVector::ZeroVector;
+	double WallHalfWidth = 0;
+};
@@ -0,0 +1,37 @@
+#include "MirrorBenchmark.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/CommandLine.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Needs a running game: -game -nullrhi -ExecCmds="Automation RunTests UE5_Mirrors.Benchmark; Quit" -Baseline=<path>
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMirrorBenchmarkTest, "UE5_Mirrors.Benchmark",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FMirrorBenchmarkTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = nullptr;
+	for (const FWorldContext& Context : GEngine->GetWorldContexts())
+	{
+		if (Context.World() && Context.World()->IsGameWorld())
+		{
+			World = Context.World();
+			break;
+		}
+	}
+
+	if (!World)
+	{
+		AddError(TEXT("The mirror benchmark needs a running game world."));
+		return false;
+	}
+
+	FMirrorBenchmarkSettings Settings;
+	Settings.Parse(FCommandLine::Get());
+	TestTrue(TEXT("No operation regressed against the baseline"), FMirrorBenchmark(Settings).Run(World));
+	return true;
+}
+
+#endif
@@ -0,0 +1,425 @@
+#include "MirrorBoundsTree.h"
+
+float FMirrorBoundsTree::SurfaceArea(const FVector3f& Min, const FVector3f& Max)
+{
+	const FVector3f Size = Max - Min;
+	return 2 * (Size.X * Size.Y + Size.Y * Size.Z + Size.Z * Size.X);
+}
+
+int32 FMirrorBoundsTree::ClassifyBox(const FVector3f& Min, const FVector3f& Max, TConstArrayView<FVector4f> Planes)
+{
+	const FVector3f Center = (Min + Max) * 0.5f;
+	const FVector3f Extent = (Max - Min) * 0.5f;
+
+	bool bIntersects = false;
+	for (const FVector4f& Plane : Planes)
+	{
+		const float Distance = Plane.X * Center.X + Plane.Y * Center.Y + Plane.Z * Center.Z - Plane.W;
+		const float Radius = FMath::Abs(Plane.X) * Extent.X + FMath::Abs(Plane.Y) * Extent.Y +
+			FMath::Abs(Plane.Z) * Extent.Z;
+
+		if (Distance < -Radius)
+		{
+			return -1;
+		}
+
+		if (Distance < Radius)
+		{
+			bIntersects = true;
+		}
+	}
+
+	return bIntersects ? 0 : 1;
+}
+
+int32 FMirrorBoundsTree::Insert(const FBox& Bounds, const int32 UserIndex)
+{
+	const int32 LeafId = AllocateNode();
+	FNode& Leaf = Nodes[LeafId];
+	Leaf.Min = FVector3f(Bounds.Min) - FVector3f(Margin);
+	Leaf.Max = FVector3f(Bounds.Max) + FVector3f(Margin);
+	Leaf.UserIndex = UserIndex;
+	Leaf.Height = 0;
+
+	InsertLeaf(LeafId);
+	NumLeaves++;
+	return LeafId;
+}
+
+void FMirrorBoundsTree::Remove(const int32 LeafId)
+{
+	check(Nodes.IsValidIndex(LeafId) && Nodes[LeafId].IsLeaf());
+
+	RemoveLeaf(LeafId);
+	FreeNode(LeafId);
+	NumLeaves--;
+}
+
+bool FMirrorBoundsTree::Move(const int32 LeafId, const FBox& Bounds)
+{
+	check(Nodes.IsValidIndex(LeafId) && Nodes[LeafId].IsLeaf());
+
+	const FVector3f Min(Bounds.Min);
+	const FVector3f Max(Bounds.Max);
+	FNode& Leaf = Nodes[LeafId];
+	if (Leaf.Min.X <= Min.X && Leaf.Min.Y <= Min.Y && Leaf.Min.Z <= Min.Z &&
+		Leaf.Max.X >= Max.X && Leaf.Max.Y >= Max.Y && Leaf.Max.Z >= Max.Z)
+	{
+		return false;
+	}
+
+	RemoveLeaf(LeafId);
+	Nodes[LeafId].Min = Min - FVector3f(Margin);
+	Nodes[LeafId].Max = Max + FVector3f(Margin);
+	InsertLeaf(LeafId);
+	return true;
+}
+
+void FMirrorBoundsTree::QueryFrustum(TConstArrayView<FVector4f> Planes, TArray<int32>& OutUserIndices) const
+{
+	if (Root == INDEX_NONE)
+	{
+		return;
+	}
+
+	// Nodes fully in front of every plane are pushed with their index negated, so their subtree is collected without further tests.
+	TArray<int32, TInlineAllocator<128>> Stack;
+	Stack.Add(Root);
+
+	while (Stack.Num() > 0)
+	{
+		const int32 StackEntry = Stack.Pop(false);
+		const bool bIsInside = StackEntry < 0;
+		const int32 NodeId = bIsInside ? -StackEntry - 1 : StackEntry;
+		const FNode& Node = Nodes[NodeId];
+
+		int32 Classification = 1;
+		if (!bIsInside)
+		{
+			Classification = ClassifyBox(Node.Min, Node.Max, Planes);
+			if (Classification < 0)
+			{
+				continue;
+			}
+		}
+
+		if (Node.IsLeaf())
+		{
+			OutUserIndices.Add(Node.UserIndex);
+			continue;
+		}
+
+		if (Classification > 0)
+		{
+			Stack.Add(-Node.Child1 - 1);
+			Stack.Add(-Node.Child2 - 1);
+		}
+		else
+		{
+			Stack.Add(Node.Child1);
+			Stack.Add(Node.Child2);
+		}
+	}
+}
+
+void FMirrorBoundsTree::Reset()
+{
+	Nodes.Reset();
+	Root = INDEX_NONE;
+	FreeList = INDEX_NONE;
+	NumLeaves = 0;
+}
+
+int32 FMirrorBoundsTree::AllocateNode()
+{
+	int32 NodeId;
+	if (FreeList != INDEX_NONE)
+	{
+		NodeId = FreeList;
+		FreeList = Nodes[NodeId].Parent;
+	}
+	else
+	{
+		NodeId = Nodes.AddUninitialized();
+	}
+
+	FNode& Node = Nodes[NodeId];
+	Node.Min = FVector3f::ZeroVector;
+	Node.Max = FVector3f::ZeroVector;
+	Node.Parent = INDEX_NONE;
+	Node.Child1 = INDEX_NONE;
+	Node.Child2 = INDEX_NONE;
+	Node.Height = 0;
+	Node.UserIndex = INDEX_NONE;
+	return NodeId;
+}
+
+void FMirrorBoundsTree::FreeNode(const int32 NodeId)
+{
+	Nodes[NodeId].Parent = FreeList;
+	Nodes[NodeId].Height = -1;
+	FreeList = NodeId;
+}
+
+void FMirrorBoundsTree::InsertLeaf(const int32 LeafId)
+{
+	if (Root == INDEX_NONE)
+	{
+		Root = LeafId;
+		Nodes[Root].Parent = INDEX_NONE;
+		return;
+	}
+
+	const FVector3f LeafMin = Nodes[LeafId].Min;
+	const FVector3f LeafMax = Nodes[LeafId].Max;
+
+	// Descend towards the sibling that grows the least in surface area.
+	int32 Index = Root;
+	while (!Nodes[Index].IsLeaf())
+	{
+		const FNode& Node = Nodes[Index];
+		const float Area = SurfaceArea(Node.Min, Node.Max);
+		const float CombinedArea = SurfaceArea(Node.Min.ComponentMin(LeafMin), Node.Max.ComponentMax(LeafMax));
+
+		// Cost of making a new parent for this node and the leaf.
+		const float Cost = 2 * CombinedArea;
+
+		// Minimum cost of pushing the leaf further down the tree.
+		const float InheritanceCost = 2 * (CombinedArea - Area);
+
+		auto ChildCost = [this, &LeafMin, &LeafMax, InheritanceCost](const int32 ChildId)
+		{
+			const FNode& Child = Nodes[ChildId];
+			const float NewArea = SurfaceArea(Child.Min.ComponentMin(LeafMin), Child.Max.ComponentMax(LeafMax));
+			if (Child.IsLeaf())
+			{
+				return NewArea + InheritanceCost;
+			}
+
+			return NewArea - SurfaceArea(Child.Min, Child.Max) + InheritanceCost;
+		};
+
+		const float Cost1 = ChildCost(Node.Child1);
+		const float Cost2 = ChildCost(Node.Child2);
+		if (Cost < Cost1 && Cost < Cost2)
+		{
+			break;
+		}
+
+		Index = Cost1 < Cost2 ? Node.Child1 : Node.Child2;
+	}
+
+	const int32 Sibling = Index;
+	const int32 OldParent = Nodes[Sibling].Parent;
+	const int32 NewParent = AllocateNode();
+
+	FNode& Parent = Nodes[NewParent];
+	Parent.Parent = OldParent;
+	Parent.Min = LeafMin.ComponentMin(Nodes[Sibling].Min);
+	Parent.Max = LeafMax.ComponentMax(Nodes[Sibling].Max);
+	Parent.Height = Nodes[Sibling].Height + 1;
+	Parent.Child1 = Sibling;
+	Parent.Child2 = LeafId;
+
+	if (OldParent != INDEX_NONE)
+	{
+		if (Nodes[OldParent].Child1 == Sibling)
+		{
+			Nodes[OldParent].Child1 = NewParent;
+		}
+		else
+		{
+			Nodes[OldParent].Child2 = NewParent;
+		}
+	}
+	else
+	{
+		Root = NewParent;
+	}
+
+	Nodes[Sibling].Parent = NewParent;
+	Nodes[LeafId].Parent = NewParent;
+
+	Refit(Nodes[LeafId].Parent);
+}
+
+void FMirrorBoundsTree::RemoveLeaf(const int32 LeafId)
+{
+	if (LeafId == Root)
+	{
+		Root = INDEX_NONE;
+		return;
+	}
+
+	const int32 Parent = Nodes[LeafId].Parent;
+	const int32 GrandParent = Nodes[Parent].Parent;
+	const int32 Sibling = Nodes[Parent].Child1 == LeafId ? Nodes[Parent].Child2 : Nodes[Parent].Child1;
+
+	if (GrandParent != INDEX_NONE)
+	{
+		if (Nodes[GrandParent].Child1 == Parent)
+		{
+			Nodes[GrandParent].Child1 = Sibling;
+		}
+		else
+		{
+			Nodes[GrandParent].Child2 = Sibling;
+		}
+
+		Nodes[Sibling].Parent = GrandParent;
+		FreeNode(Parent);
+		Refit(GrandParent);
+	}
+	else
+	{
+		Root = Sibling;
+		Nodes[Sibling].Parent = INDEX_NONE;
+		FreeNode(Parent);
+	}
+}
+
+void FMirrorBoundsTree::Refit(int32 NodeId)
+{
+	while (NodeId != INDEX_NONE)
+	{
+		NodeId = Balance(NodeId);
+
+		FNode& Node = Nodes[NodeId];
+		const FNode& Child1 = Nodes[Node.Child1];
+		const FNode& Child2 = Nodes[Node.Child2];
+		Node.Height = 1 + FMath::Max(Child1.Height, Child2.Height);
+		Node.Min = Child1.Min.ComponentMin(Child2.Min);
+		Node.Max = Child1.Max.ComponentMax(Child2.Max);
+
+		NodeId = Node.Parent;
+	}
+}
+
+int32 FMirrorBoundsTree::Balance(const int32 NodeId)
+{
+	FNode& A = Nodes[NodeId];
+	if (A.IsLeaf() || A.Height < 2)
+	{
+		return NodeId;
+	}
+
+	const int32 IdB = A.Child1;
+	const int32 IdC = A.Child2;
+	FNode& B = Nodes[IdB];
+	FNode& C = Nodes[IdC];
+	const int32 BalanceFactor = C.Height - B.Height;
+
+	// Rotate C up.
+	if (BalanceFactor > 1)
+	{
+		const int32 IdF = C.Child1;
+		const int32 IdG = C.Child2;
+		FNode& F = Nodes[IdF];
+		FNode& G = Nodes[IdG];
+
+		C.Child1 = NodeId;
+		C.Parent = A.Parent;
+		A.Parent = IdC;
+
+		if (C.Parent != INDEX_NONE)
+		{
+			if (Nodes[C.Parent].Child1 == NodeId)
+			{
+				Nodes[C.Parent].Child1 = IdC;
+			}
+			else
+			{
+				Nodes[C.Parent].Child2 = IdC;
+			}
+		}
+		else
+		{
+			Root = IdC;
+		}
+
+		if (F.Height > G.Height)
+		{
+			C.Child2 = IdF;
+			A.Child2 = IdG;
+			G.Parent = NodeId;
+			A.Min = B.Min.ComponentMin(G.Min);
+			A.Max = B.Max.ComponentMax(G.Max);
+			C.Min = A.Min.ComponentMin(F.Min);
+			C.Max = A.Max.ComponentMax(F.Max);
+			A.Height = 1 + FMath::Max(B.Height, G.Height);
+			C.Height = 1 + FMath::Max(A.Height, F.Height);
+		}
+		else
+		{
+			C.Child2 = IdG;
+			A.Child2 = IdF;
+			F.Parent = NodeId;
+			A.Min = B.Min.ComponentMin(F.Min);
+			A.Max = B.Max.ComponentMax(F.Max);
+			C.Min = A.Min.ComponentMin(G.Min);
+			C.Max = A.Max.ComponentMax(G.Max);
+			A.Height = 1 + FMath::Max(B.Height, F.Height);
+			C.Height = 1 + FMath::Max(A.Height, G.Height);
+		}
+
+		return IdC;
+	}
+
+	// Rotate B up.
+	if (BalanceFactor < -1)
+	{
+		const int32 IdD = B.Child1;
+		const int32 IdE = B.Child2;
+		FNode& D = Nodes[IdD];
+		FNode& E = Nodes[IdE];
+
+		B.Child1 = NodeId;
+		B.Parent = A.Parent;
+		A.Parent = IdB;
+
+		if (B.Parent != INDEX_NONE)
+		{
+			if (Nodes[B.Parent].Child1 == NodeId)
+			{
+				Nodes[B.Parent].Child1 = IdB;
+			}
+			else
+			{
+				Nodes[B.Parent].Child2 = IdB;
+			}
+		}
+		else
+		{
+			Root = IdB;
+		}
+
+		if (D.Height > E.Height)
+		{
+			B.Child2 = IdD;
+			A.Child1 = IdE;
+			E.Parent = NodeId;
+			A.Min = C.Min.ComponentMin(E.Min);
+			A.Max = C.Max.ComponentMax(E.Max);
+			B.Min = A.Min.ComponentMin(D.Min);
+			B.Max = A.Max.ComponentMax(D.Max);
+			A.Height = 1 + FMath::Max(C.Height, E.Height);
+			B.Height = 1 + FMath::Max(A.Height, D.Height);
+		}
+		else
+		{
+			B.Child2 = IdE;
+			A.Child1 = IdD;
+			D.Parent = NodeId;
+			A.Min = C.Min.ComponentMin(D.Min);
+			A.Max = C.Max.ComponentMax(D.Max);
+			B.Min = A.Min.ComponentMin(E.Min);
+			B.Max = A.Max.ComponentMax(E.Max);
+			A.Height = 1 + FMath::Max(C.Height, D.Height);
+			B.Height = 1 + FMath::Max(A.Height, E.Height);
+		}
+
+		return IdB;
+	}
+
+	return NodeId;
+}
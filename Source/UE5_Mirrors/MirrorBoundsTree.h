@@ -0,0 +1,60 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Dynamic bounding volume hierarchy over axis aligned boxes. Leaves store slightly enlarged boxes so small movements don't restructure the tree.
+class UE5_MIRRORS_API FMirrorBoundsTree
+{
+public:
+	// Returns the id of the new leaf. UserIndex is handed back by queries.
+	int32 Insert(const FBox& Bounds, int32 UserIndex);
+	void Remove(int32 LeafId);
+
+	// Returns true if the leaf's enlarged box no longer contained the new bounds and the leaf had to be reinserted.
+	bool Move(int32 LeafId, const FBox& Bounds);
+
+	// Appends the user index of every leaf whose box is not completely behind one of the planes. Planes face inwards.
+	void QueryFrustum(TConstArrayView<FVector4f> Planes, TArray<int32>& OutUserIndices) const;
+
+	void Reset();
+
+	int32 GetNumLeaves() const { return NumLeaves; }
+
+	// How much leaf boxes are enlarged on each side, in centimeters.
+	float Margin = 20;
+
+private:
+	struct FNode
+	{
+		FVector3f Min;
+		FVector3f Max;
+
+		// Next free node while the node is in the free list.
+		int32 Parent;
+		int32 Child1;
+		int32 Child2;
+
+		// 0 for leaves, -1 for free nodes.
+		int32 Height;
+		int32 UserIndex;
+
+		bool IsLeaf() const { return Child1 == INDEX_NONE; }
+	};
+
+	static float SurfaceArea(const FVector3f& Min, const FVector3f& Max);
+
+	// Returns -1 if the box is behind at least one plane, 1 if it is in front of all of them and 0 if it straddles one.
+	static int32 ClassifyBox(const FVector3f& Min, const FVector3f& Max, TConstArrayView<FVector4f> Planes);
+
+	int32 AllocateNode();
+	void FreeNode(int32 NodeId);
+	void InsertLeaf(int32 LeafId);
+	void RemoveLeaf(int32 LeafId);
+	int32 Balance(int32 NodeId);
+	void Refit(int32 NodeId);
+
+	TArray<FNode> Nodes;
+	int32 Root = INDEX_NONE;
+	int32 FreeList = INDEX_NONE;
+	int32 NumLeaves = 0;
+};
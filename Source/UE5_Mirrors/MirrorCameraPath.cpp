@@ -0,0 +1,328 @@
+#include "MirrorCameraPath.h"
+#include "MirrorSubsystem.h"
+#include "Camera/CameraActor.h"
+#include "Camera/CameraComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMirrorCameraPath, Log, All);
+
+static FAutoConsoleCommandWithWorldAndArgs MirrorRecordCameraPathCommand(
+	TEXT("Mirrors.RecordCameraPath"),
+	TEXT("Record the active camera until Mirrors.StopCameraPath. Args: <Name>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UMirrorSubsystem* MirrorSubsystem = UGameInstance::GetSubsystem<UMirrorSubsystem>(
+			World ? World->GetGameInstance() : nullptr))
+		{
+			MirrorSubsystem->GetCameraPathPlayer().StartRecording(Args.Num() > 0 ? Args[0] : TEXT("CameraPath"));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs MirrorReplayCameraPathCommand(
+	TEXT("Mirrors.ReplayCameraPath"),
+	TEXT("Replay a recorded camera path and log what the mirrors did on each frame. Args: <Name> [Quit]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UMirrorSubsystem* MirrorSubsystem = UGameInstance::GetSubsystem<UMirrorSubsystem>(
+			World ? World->GetGameInstance() : nullptr))
+		{
+			const bool bQuitWhenDone = Args.Num() > 1 && Args[1].Equals(TEXT("Quit"), ESearchCase::IgnoreCase);
+			MirrorSubsystem->GetCameraPathPlayer().StartReplay(Args.Num() > 0 ? Args[0] : TEXT("CameraPath"),
+			                                                   bQuitWhenDone);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs MirrorStopCameraPathCommand(
+	TEXT("Mirrors.StopCameraPath"),
+	TEXT("Save the camera path being recorded, or end a replay early."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UMirrorSubsystem* MirrorSubsystem = UGameInstance::GetSubsystem<UMirrorSubsystem>(
+			World ? World->GetGameInstance() : nullptr))
+		{
+			MirrorSubsystem->GetCameraPathPlayer().Stop();
+		}
+	}));
+
+FMirrorCameraPathPlayer::~FMirrorCameraPathPlayer()
+{
+	Stop();
+}
+
+FString FMirrorCameraPathPlayer::GetPathFileName(const FString& PathName)
+{
+	return FPaths::ProjectSavedDir() / TEXT("Mirrors") / TEXT("CameraPaths") / (PathName + TEXT(".campath"));
+}
+
+void FMirrorCameraPathPlayer::StartRecording(const FString& PathName)
+{
+	Stop();
+	State = EState::Recording;
+	Name = PathName;
+	Frames.Reset();
+	UE_LOG(LogMirrorCameraPath, Display, TEXT("Recording camera path %s."), *Name);
+}
+
+bool FMirrorCameraPathPlayer::StartReplay(const FString& PathName, const bool bInQuitWhenDone)
+{
+	Stop();
+
+	const TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*GetPathFileName(PathName)));
+	if (!Reader)
+	{
+		UE_LOG(LogMirrorCameraPath, Error, TEXT("No camera path %s."), *GetPathFileName(PathName));
+		return false;
+	}
+
+	*Reader << Frames;
+	if (Reader->IsError() || Frames.IsEmpty())
+	{
+		UE_LOG(LogMirrorCameraPath, Error, TEXT("Camera path %s is empty or broken."), *PathName);
+		Frames.Reset();
+		return false;
+	}
+
+	State = EState::Replaying;
+	Name = PathName;
+	bQuitWhenDone = bInQuitWhenDone;
+	ReplayFrame = 0;
+	LastPlaceFrame = 0;
+	ReplayLog.Reset(Frames.Num());
+	FMirrorStats::SetCountingFrames(true);
+	SetFixedDeltaTime(Frames[0].DeltaTime);
+	UE_LOG(LogMirrorCameraPath, Display, TEXT("Replaying camera path %s, %d frames."), *Name, Frames.Num());
+	return true;
+}
+
+void FMirrorCameraPathPlayer::Stop()
+{
+	if (State == EState::Recording)
+	{
+		State = EState::Idle;
+		const FString FileName = GetPathFileName(Name);
+		const TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*FileName));
+		if (Writer)
+		{
+			*Writer << Frames;
+			UE_LOG(LogMirrorCameraPath, Display, TEXT("Saved %d frames to %s."), Frames.Num(), *FileName);
+		}
+		else
+		{
+			UE_LOG(LogMirrorCameraPath, Error, TEXT("Could not write %s."), *FileName);
+		}
+	}
+	else if (State == EState::Replaying)
+	{
+		FinishReplay();
+	}
+}
+
+void FMirrorCameraPathPlayer::PlaceReplayCamera(UWorld* World)
+{
+	if (State != EState::Replaying || ReplayFrame >= Frames.Num() || LastPlaceFrame == GFrameCounter || !World)
+	{
+		return;
+	}
+
+	LastPlaceFrame = GFrameCounter;
+	if (!ReplayCamera.IsValid())
+	{
+		APlayerController* PlayerController = World->GetFirstPlayerController();
+		if (!PlayerController)
+		{
+			return;
+		}
+
+		// The replay is seen through the lens it was recorded with.
+		ACameraActor* Camera = World->SpawnActor<ACameraActor>();
+		UCameraComponent* CameraComponent = Camera->GetCameraComponent();
+		if (UCameraComponent* PawnCamera = FindActiveCamera(World))
+		{
+			CameraComponent->SetFieldOfView(PawnCamera->FieldOfView);
+			CameraComponent->SetAspectRatio(PawnCamera->AspectRatio);
+			CameraComponent->SetConstraintAspectRatio(PawnCamera->bConstrainAspectRatio);
+			RestoreCamera = PawnCamera;
+		}
+
+		ReplayCamera = Camera;
+		ReplayPlayerController = PlayerController;
+		RestoreViewTarget = PlayerController->GetViewTarget();
+		PlayerController->SetViewTarget(Camera);
+		OnViewCameraChanged.Broadcast(CameraComponent);
+	}
+
+	// Placed before anything ticks, so the camera manager and the mirrors both see this frame's camera.
+	const FMirrorCameraPathFrame& Frame = Frames[ReplayFrame];
+	UCameraComponent* CameraComponent = ReplayCamera->GetCameraComponent();
+	ReplayCamera->SetActorLocationAndRotation(FVector(Frame.Location), FQuat(Frame.Rotation));
+
+	FMinimalViewInfo ViewInfo;
+	CameraComponent->GetCameraView(0, ViewInfo);
+	FMatrix ViewMatrix;
+	FMatrix ProjectionMatrix;
+	FMatrix ViewProjectionMatrix;
+	UGameplayStatics::GetViewProjectionMatrix(ViewInfo, ViewMatrix, ProjectionMatrix, ViewProjectionMatrix);
+	GetViewFrustumBounds(ReplayFrustum, ViewProjectionMatrix, false);
+}
+
+void FMirrorCameraPathPlayer::Update(const UWorld* World)
+{
+	if (State == EState::Idle || LastUpdateFrame == GFrameCounter)
+	{
+		return;
+	}
+
+	LastUpdateFrame = GFrameCounter;
+	if (State == EState::Recording)
+	{
+		if (const UCameraComponent* Camera = FindActiveCamera(World))
+		{
+			FMirrorCameraPathFrame& Frame = Frames.AddDefaulted_GetRef();
+			Frame.Location = FVector3f(Camera->GetComponentLocation());
+			Frame.Rotation = FQuat4f(Camera->GetComponentQuat());
+			Frame.DeltaTime = FApp::GetDeltaTime();
+		}
+		return;
+	}
+
+	// A replay started during this frame waits for its camera to be placed at the start of the next one.
+	if (ReplayFrame < Frames.Num() && LastPlaceFrame != GFrameCounter)
+	{
+		return;
+	}
+
+	// Everything counted since the last update belongs to the frame replayed before this one.
+	const FMirrorFrameCounts Counts = FMirrorStats::TakeFrameCounts();
+	if (ReplayFrame > 0)
+	{
+		ReplayLog.Add(Counts);
+	}
+
+	if (ReplayFrame >= Frames.Num())
+	{
+		FinishReplay();
+		return;
+	}
+
+	// The next engine frame advances by the time the next recorded frame took.
+	ReplayFrame++;
+	if (ReplayFrame < Frames.Num())
+	{
+		SetFixedDeltaTime(Frames[ReplayFrame].DeltaTime);
+	}
+}
+
+bool FMirrorCameraPathPlayer::WasRecentlyRendered(const UPrimitiveComponent* Component) const
+{
+	if (State != EState::Replaying || !ReplayCamera.IsValid())
+	{
+		return Component->WasRecentlyRendered();
+	}
+
+	return ReplayFrustum.IntersectBox(Component->Bounds.Origin, Component->Bounds.BoxExtent);
+}
+
+UCameraComponent* FMirrorCameraPathPlayer::FindActiveCamera(const UWorld* World)
+{
+	// Same camera the mirrors pick in FindActiveCamera.
+	const APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+	const APawn* PlayerPawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+	if (!PlayerPawn)
+	{
+		return nullptr;
+	}
+
+	TArray<UCameraComponent*> Cameras;
+	PlayerPawn->GetComponents(Cameras);
+	UCameraComponent** FoundCamera = Cameras.FindByPredicate([](const UCameraComponent* Camera)
+	{
+		return Camera->IsActive();
+	});
+	return FoundCamera ? *FoundCamera : nullptr;
+}
+
+void FMirrorCameraPathPlayer::SetFixedDeltaTime(const float DeltaTime)
+{
+	if (!bHasFixedTimeStep)
+	{
+		bRestoreUseFixedTimeStep = FApp::UseFixedTimeStep();
+		RestoreFixedDeltaTime = FApp::GetFixedDeltaTime();
+		bHasFixedTimeStep = true;
+	}
+
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(FMath::Max(DeltaTime, UE_KINDA_SMALL_NUMBER));
+}
+
+void FMirrorCameraPathPlayer::FinishReplay()
+{
+	State = EState::Idle;
+	FMirrorStats::SetCountingFrames(false);
+	if (ACameraActor* Camera = ReplayCamera.Get())
+	{
+		if (APlayerController* PlayerController = ReplayPlayerController.Get())
+		{
+			PlayerController->SetViewTarget(RestoreViewTarget.IsValid() ? RestoreViewTarget.Get() : PlayerController->GetPawn());
+		}
+
+		Camera->Destroy();
+		OnViewCameraChanged.Broadcast(RestoreCamera.Get());
+	}
+
+	ReplayCamera.Reset();
+	ReplayPlayerController.Reset();
+	RestoreViewTarget.Reset();
+	RestoreCamera.Reset();
+	if (bHasFixedTimeStep)
+	{
+		FApp::SetUseFixedTimeStep(bRestoreUseFixedTimeStep);
+		FApp::SetFixedDeltaTime(RestoreFixedDeltaTime);
+		bHasFixedTimeStep = false;
+	}
+
+	WriteReplayLog();
+	if (bQuitWhenDone)
+	{
+		RequestEngineExit(TEXT("Mirror camera path replay finished"));
+	}
+}
+
+void FMirrorCameraPathPlayer::WriteReplayLog() const
+{
+	FString Csv = TEXT("Frame,DeltaTime,Captures,SkippedCaptures,ShowOnlyActors,ShowOnlyComponents,MirrorMs\n");
+	FMirrorFrameCounts Total;
+	double MaxMirrorTimeMs = 0;
+	for (int32 Frame = 0; Frame < ReplayLog.Num(); Frame++)
+	{
+		const FMirrorFrameCounts& Counts = ReplayLog[Frame];
+		Csv += FString::Printf(TEXT("%d,%.4f,%d,%d,%d,%d,%.4f\n"), Frame, Frames[Frame].DeltaTime, Counts.NumCaptures,
+		                       Counts.NumSkippedCaptures, Counts.NumShowOnlyActors, Counts.NumShowOnlyComponents,
+		                       Counts.MirrorTimeMs);
+
+		Total.NumCaptures += Counts.NumCaptures;
+		Total.NumShowOnlyActors += Counts.NumShowOnlyActors;
+		Total.MirrorTimeMs += Counts.MirrorTimeMs;
+		MaxMirrorTimeMs = FMath::Max(MaxMirrorTimeMs, Counts.MirrorTimeMs);
+	}
+
+	const FString FileName = FPaths::ProfilingDir() / TEXT("Mirrors") /
+		FString::Printf(TEXT("%s-Replay-%s.csv"), *Name, *FDateTime::Now().ToString());
+	FFileHelper::SaveStringToFile(Csv, *FileName);
+
+	const int32 NumFrames = FMath::Max(ReplayLog.Num(), 1);
+	UE_LOG(LogMirrorCameraPath, Display,
+	       TEXT("Replayed %s: %d frames, %d captures, %.1f show only actors per capture, mirror time mean %.3f ms, max %.3f ms. Log: %s"),
+	       *Name, ReplayLog.Num(), Total.NumCaptures,
+	       Total.NumCaptures > 0 ? static_cast<float>(Total.NumShowOnlyActors) / Total.NumCaptures : 0.f,
+	       Total.MirrorTimeMs / NumFrames, MaxMirrorTimeMs, *FileName);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvexVolume.h"
+#include "MirrorStats.h"
+
+class ACameraActor;
+class APlayerController;
+class UCameraComponent;
+class UPrimitiveComponent;
+class UWorld;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMirrorViewCameraChanged, UCameraComponent*);
+
+// The camera of one engine frame. Single precision keeps a minute of recording at 60 fps under 120 KB.
+struct FMirrorCameraPathFrame
+{
+	FVector3f Location = FVector3f::ZeroVector;
+	FQuat4f Rotation = FQuat4f::Identity;
+	float DeltaTime = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FMirrorCameraPathFrame& Frame)
+	{
+		return Ar << Frame.Location << Frame.Rotation << Frame.DeltaTime;
+	}
+};
+
+// Records the active camera into a file under Saved/Mirrors/CameraPaths and plays it back, one recorded frame per engine frame.
+// Playback runs on a fixed time step of the recorded frame times, so mirror captures, culling and quality changes repeat exactly,
+// and logs per frame capture counts, show only list sizes and mirror time to Saved/Profiling/Mirrors.
+// A replay views the level through a camera actor of its own, placed before any actor ticks, so neither the pawn nor the
+// camera manager can move the view away from the recording.
+class UE5_MIRRORS_API FMirrorCameraPathPlayer
+{
+public:
+	~FMirrorCameraPathPlayer();
+
+	void StartRecording(const FString& PathName);
+	bool StartReplay(const FString& PathName, bool bInQuitWhenDone);
+
+	// Saves a recording or ends a replay early. Either way the time step is given back to the engine.
+	void Stop();
+
+	bool IsRecording() const { return State == EState::Recording; }
+	bool IsReplaying() const { return State == EState::Replaying; }
+
+	// Call before actors tick. Places the replay camera for this frame and makes it the view target.
+	void PlaceReplayCamera(UWorld* World);
+
+	// Call once all actors have ticked and before mirrors are evaluated. Only the first call of a frame does anything.
+	void Update(const UWorld* World);
+
+	// While replaying, whether the replayed camera sees the component. Headless replays render nothing, so the component's
+	// own WasRecentlyRendered would never be true. Otherwise the component's WasRecentlyRendered.
+	bool WasRecentlyRendered(const UPrimitiveComponent* Component) const;
+
+	// Called with the replay camera when a replay starts and with the camera it replaced when the replay ends.
+	FOnMirrorViewCameraChanged OnViewCameraChanged;
+
+	static FString GetPathFileName(const FString& PathName);
+
+private:
+	enum class EState : uint8
+	{
+		Idle,
+		Recording,
+		Replaying
+	};
+
+	static UCameraComponent* FindActiveCamera(const UWorld* World);
+	void SetFixedDeltaTime(float DeltaTime);
+	void FinishReplay();
+	void WriteReplayLog() const;
+
+	EState State = EState::Idle;
+	FString Name;
+	TArray<FMirrorCameraPathFrame> Frames;
+	int32 ReplayFrame = 0;
+	uint64 LastUpdateFrame = 0;
+	uint64 LastPlaceFrame = 0;
+	bool bQuitWhenDone = false;
+
+	// The camera actor the replay is viewed through, and what it took over from.
+	TWeakObjectPtr<ACameraActor> ReplayCamera;
+	TWeakObjectPtr<APlayerController> ReplayPlayerController;
+	TWeakObjectPtr<AActor> RestoreViewTarget;
+	TWeakObjectPtr<UCameraComponent> RestoreCamera;
+
+	// The replay camera's view of the current frame.
+	FConvexVolume ReplayFrustum;
+
+	// The engine's time step before a replay took it over.
+	bool bRestoreUseFixedTimeStep = false;
+	double RestoreFixedDeltaTime = 0;
+	bool bHasFixedTimeStep = false;
+
+	// One row per replayed frame, what the mirrors did with the camera of that frame.
+	TArray<FMirrorFrameCounts> ReplayLog;
+};
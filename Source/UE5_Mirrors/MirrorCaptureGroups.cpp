@@ -0,0 +1,167 @@
+#include "MirrorCaptureGroups.h"
+#include "MirrorScreenCoverage.h"
+#include "Components/PrimitiveComponent.h"
+
+FMirrorCaptureGroupSurface FMirrorCaptureGroups::MakeSurface(const FQuat& MirrorRotation,
+                                                             const UPrimitiveComponent* MirrorMesh)
+{
+	FMirrorCaptureGroupSurface Surface;
+	FMirrorScreenCoverage::GetMirrorCorners(MirrorMesh, Surface.Corners);
+	Surface.Transform = FTransform(MirrorRotation, (Surface.Corners[0] + Surface.Corners[2]) / 2);
+	return Surface;
+}
+
+void FMirrorCaptureGroups::FindGroups(const TConstArrayView<FMirrorCaptureGroupSurface> Surfaces,
+                                      const FMirrorCaptureGroupSettings& Settings, TArray<FMirrorCaptureGroup>& OutGroups)
+{
+	OutGroups.Reset();
+
+	TBitArray<> Grouped(false, Surfaces.Num());
+	TArray<int32, TInlineAllocator<8>> Members;
+	TArray<FBox2D, TInlineAllocator<8>> MemberBounds;
+	for (int32 Seed = 0; Seed < Surfaces.Num(); Seed++)
+	{
+		if (Grouped[Seed])
+		{
+			continue;
+		}
+
+		// Grow the group from the seed, one neighbour at a time, until no other surface is close enough to a member.
+		const FTransform& SeedTransform = Surfaces[Seed].Transform;
+		Members.Reset();
+		MemberBounds.Reset();
+		Members.Add(Seed);
+		MemberBounds.Add(CalcPlaneBounds(SeedTransform, Surfaces[Seed]));
+
+		bool bHasGrown = true;
+		while (bHasGrown)
+		{
+			bHasGrown = false;
+			for (int32 Other = Seed + 1; Other < Surfaces.Num(); Other++)
+			{
+				if (Grouped[Other] || Members.Contains(Other) || !IsCoplanar(Surfaces[Seed], Surfaces[Other], Settings))
+				{
+					continue;
+				}
+
+				const FBox2D OtherBounds = CalcPlaneBounds(SeedTransform, Surfaces[Other]).ExpandBy(Settings.MaxGap);
+				if (MemberBounds.ContainsByPredicate([&OtherBounds](const FBox2D& Bounds)
+				{
+					return Bounds.Intersect(OtherBounds);
+				}))
+				{
+					Members.Add(Other);
+					MemberBounds.Add(CalcPlaneBounds(SeedTransform, Surfaces[Other]));
+					bHasGrown = true;
+				}
+			}
+		}
+
+		if (Members.Num() < 2)
+		{
+			continue;
+		}
+
+		// The leader decides on the group's captures, so the one in the middle stands in for the group best.
+		FBox2D SeedGroupBounds(ForceInit);
+		for (const FBox2D& Bounds : MemberBounds)
+		{
+			SeedGroupBounds += Bounds;
+		}
+
+		const FVector2D GroupCenter = SeedGroupBounds.GetCenter();
+		int32 LeaderIndex = 0;
+		double ClosestDistanceSquared = MAX_dbl;
+		for (int32 Index = 0; Index < Members.Num(); Index++)
+		{
+			const double DistanceSquared = FVector2D::DistSquared(MemberBounds[Index].GetCenter(), GroupCenter);
+			if (DistanceSquared < ClosestDistanceSquared)
+			{
+				ClosestDistanceSquared = DistanceSquared;
+				LeaderIndex = Index;
+			}
+		}
+
+		Members.Swap(0, LeaderIndex);
+
+		// The leader captures with its own rotation, so the group lives on the leader's plane.
+		const FTransform& LeaderTransform = Surfaces[Members[0]].Transform;
+		FBox2D GroupBounds(ForceInit);
+		for (int32 Index = 0; Index < Members.Num(); Index++)
+		{
+			MemberBounds[Index] = CalcPlaneBounds(LeaderTransform, Surfaces[Members[Index]]);
+			GroupBounds += MemberBounds[Index];
+		}
+
+		const FVector2D GroupSize = GroupBounds.GetSize();
+		if (GroupSize.X <= KINDA_SMALL_NUMBER || GroupSize.Y <= KINDA_SMALL_NUMBER)
+		{
+			continue;
+		}
+
+		for (const int32 Member : Members)
+		{
+			Grouped[Member] = true;
+		}
+
+		FMirrorCaptureGroup& Group = OutGroups.AddDefaulted_GetRef();
+		Group.Members = Members;
+
+		// Capture U follows the plane's Y and V runs down its Z, the same as the off-axis projection lays out the corners.
+		for (const FBox2D& Bounds : MemberBounds)
+		{
+			Group.Regions.Add(FBox2D(FVector2D((Bounds.Min.X - GroupBounds.Min.X) / GroupSize.X,
+			                                   (GroupBounds.Max.Y - Bounds.Max.Y) / GroupSize.Y),
+			                         FVector2D((Bounds.Max.X - GroupBounds.Min.X) / GroupSize.X,
+			                                   (GroupBounds.Max.Y - Bounds.Min.Y) / GroupSize.Y)));
+		}
+
+		Group.Corners[0] = LeaderTransform.TransformPositionNoScale(FVector(0, GroupBounds.Min.X, GroupBounds.Max.Y));
+		Group.Corners[1] = LeaderTransform.TransformPositionNoScale(FVector(0, GroupBounds.Max.X, GroupBounds.Max.Y));
+		Group.Corners[2] = LeaderTransform.TransformPositionNoScale(FVector(0, GroupBounds.Max.X, GroupBounds.Min.Y));
+		Group.Corners[3] = LeaderTransform.TransformPositionNoScale(FVector(0, GroupBounds.Min.X, GroupBounds.Min.Y));
+	}
+}
+
+FBox2D FMirrorCaptureGroups::CalcMaterialRegion(const FBox2D& Region, const FBox2D& CapturedRegion)
+{
+	// The material samples (UV - Min) / (Max - Min). With the member's mesh UVs first moved to its region of the group capture,
+	// and from there into the captured part of it, that is the region below.
+	const FVector2D RegionSize = Region.GetSize();
+	if (RegionSize.X <= KINDA_SMALL_NUMBER || RegionSize.Y <= KINDA_SMALL_NUMBER)
+	{
+		return CapturedRegion;
+	}
+
+	const FVector2D Min = (CapturedRegion.Min - Region.Min) / RegionSize;
+	return FBox2D(Min, Min + CapturedRegion.GetSize() / RegionSize);
+}
+
+bool FMirrorCaptureGroups::IsCoplanar(const FMirrorCaptureGroupSurface& Surface, const FMirrorCaptureGroupSurface& Other,
+                                      const FMirrorCaptureGroupSettings& Settings)
+{
+	// Members also have to agree on their right vector, or their mesh UVs wouldn't line up with the group capture.
+	const FQuat Rotation = Surface.Transform.GetRotation();
+	const FQuat OtherRotation = Other.Transform.GetRotation();
+	const double MinCos = FMath::Cos(FMath::DegreesToRadians(Settings.AngleTolerance));
+	if ((Rotation.GetForwardVector() | OtherRotation.GetForwardVector()) < MinCos ||
+		(Rotation.GetRightVector() | OtherRotation.GetRightVector()) < MinCos)
+	{
+		return false;
+	}
+
+	const FVector Offset = Other.Transform.GetLocation() - Surface.Transform.GetLocation();
+	return FMath::Abs(Offset | Rotation.GetForwardVector()) <= Settings.DistanceTolerance;
+}
+
+FBox2D FMirrorCaptureGroups::CalcPlaneBounds(const FTransform& Transform, const FMirrorCaptureGroupSurface& Surface)
+{
+	FBox2D Bounds(ForceInit);
+	for (const FVector& Corner : Surface.Corners)
+	{
+		const FVector LocalCorner = Transform.InverseTransformPositionNoScale(Corner);
+		Bounds += FVector2D(LocalCorner.Y, LocalCorner.Z);
+	}
+
+	return Bounds;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPrimitiveComponent;
+
+// A mirror's reflecting surface as the grouping sees it.
+struct FMirrorCaptureGroupSurface
+{
+	// The mirror's rotation, at the center of its surface.
+	FTransform Transform = FTransform::Identity;
+
+	// World space corners in the winding order of FMirrorScreenCoverage::GetMirrorCorners.
+	FVector Corners[4];
+};
+
+// Mirrors sharing one capture. The leader captures for all of them with an off-axis projection through Corners.
+struct FMirrorCaptureGroup
+{
+	// Indices into the surfaces the group was found in. The first one is the leader, the member closest to the group's center.
+	TArray<int32, TInlineAllocator<8>> Members;
+
+	// Where each member's surface lies in the group capture, in UV space. Same order as Members.
+	TArray<FBox2D, TInlineAllocator<8>> Regions;
+
+	// The combined surface of all members on the leader's plane, in winding order.
+	FVector Corners[4];
+};
+
+struct FMirrorCaptureGroupSettings
+{
+	// How far apart the planes of two mirrors may be, in centimeters.
+	float DistanceTolerance = 1;
+
+	// How much two mirrors may be turned against each other, in degrees.
+	float AngleTolerance = 0.5;
+
+	// Largest gap between neighbouring mirrors of a group, in centimeters. Far apart mirrors on the same plane capture on their own,
+	// as a capture over both would mostly render the wall between them.
+	float MaxGap = 10;
+};
+
+// Finds mirrors whose surfaces lie on the same plane, facing the same way, so one capture can serve all of them.
+// With the off-axis projection every point of the plane is at the same depth, so a member's part of the group capture
+// only depends on where it sits on the plane, not on the camera.
+class UE5_MIRRORS_API FMirrorCaptureGroups
+{
+public:
+	static FMirrorCaptureGroupSurface MakeSurface(const FQuat& MirrorRotation, const UPrimitiveComponent* MirrorMesh);
+
+	// Groups of two or more surfaces. Surfaces that share nothing are left out.
+	static void FindGroups(TConstArrayView<FMirrorCaptureGroupSurface> Surfaces, const FMirrorCaptureGroupSettings& Settings,
+	                       TArray<FMirrorCaptureGroup>& OutGroups);
+
+	// The region a member's material remaps its mesh UVs with, for a member at Region of a group capture
+	// whose render target holds CapturedRegion of it. A mirror capturing on its own has the whole capture as its region.
+	static FBox2D CalcMaterialRegion(const FBox2D& Region, const FBox2D& CapturedRegion);
+
+private:
+	static bool IsCoplanar(const FMirrorCaptureGroupSurface& Surface, const FMirrorCaptureGroupSurface& Other,
+	                       const FMirrorCaptureGroupSettings& Settings);
+
+	// Bounds of the surface on the plane of Transform, in its local Y and Z.
+	static FBox2D CalcPlaneBounds(const FTransform& Transform, const FMirrorCaptureGroupSurface& Surface);
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MirrorCaptureScheduler.h"
+#include "MirrorRenderTargetPool.h"
+#include "MirrorStats.h"
+#include "Async/ParallelFor.h"
+
+// The per frame work both mirror subsystems do for their own mirror type: evaluating the mirrors that ticked, ranking
+// their capture requests against the budget and executing the ones that fit. The subsystems own the mirror lists, the
+// budget settings and the frame budget, and flush the loop once all actors have ticked.
+template <typename MirrorType>
+class TMirrorCaptureLoop
+{
+public:
+	void QueueEvaluation(MirrorType* Mirror)
+	{
+		PendingEvaluations.Add(Mirror);
+	}
+
+	void RequestCapture(const FMirrorCaptureRequest& Request)
+	{
+		CaptureScheduler.AddRequest(Request);
+	}
+
+	void OnUnchangedCaptureSkipped()
+	{
+		NumUnchangedCaptureSkipsThisFrame++;
+	}
+
+	// Evaluates the queued mirrors, then captures the highest ranked requests that fit into the budget. A quality scale
+	// below 1 lowers the number of captures, fewer captures per frame spread the mirrors over more frames.
+	void Execute(FMirrorCaptureBudget Budget, const float QualityScale, const int32 MirrorsPerEvaluationTask)
+	{
+		EvaluateMirrors(MirrorsPerEvaluationTask);
+
+		const int32 NumRequests = CaptureScheduler.GetNumPending();
+		if (QualityScale < 1)
+		{
+			const int32 MaxCaptures = Budget.MaxCaptures > 0 ? Budget.MaxCaptures : NumRequests;
+			Budget.MaxCaptures = FMath::Max(FMath::CeilToInt(MaxCaptures * QualityScale), 1);
+		}
+
+		const TArrayView<const FMirrorCaptureRequest> SelectedCaptures = CaptureScheduler.SelectCaptures(Budget);
+		for (const FMirrorCaptureRequest& Request : SelectedCaptures)
+		{
+			if (MirrorType* Mirror = Cast<MirrorType>(Request.Mirror.Get()))
+			{
+				Mirror->CaptureScene();
+			}
+		}
+
+		NumDeferredCaptures = NumRequests - SelectedCaptures.Num();
+		CaptureScheduler.Reset();
+		MIRROR_INC_COUNTER(Deferred, NumDeferredCaptures);
+
+		NumUnchangedCaptureSkips = NumUnchangedCaptureSkipsThisFrame;
+		NumUnchangedCaptureSkipsThisFrame = 0;
+	}
+
+	static void SetFrameBudgetScale(const TArray<MirrorType*>& Mirrors, const float QualityScale)
+	{
+		for (MirrorType* Mirror : Mirrors)
+		{
+			if (Mirror)
+			{
+				Mirror->SetFrameBudgetScale(QualityScale);
+			}
+		}
+	}
+
+	static void AddRenderTargetStats(const TArray<MirrorType*>& Mirrors, const FMirrorRenderTargetPool& RenderTargetPool)
+	{
+#if STATS || CSV_PROFILER
+		for (const MirrorType* Mirror : Mirrors)
+		{
+			if (Mirror)
+			{
+				Mirror->AddRenderTargetStats();
+			}
+		}
+
+		FMirrorStats::AddPooledRenderTargetMemory(RenderTargetPool.GetFreeMemory());
+#endif
+	}
+
+	void Reset()
+	{
+		CaptureScheduler.Reset();
+		PendingEvaluations.Reset();
+	}
+
+	int32 GetNumDeferredCaptures() const { return NumDeferredCaptures; }
+	int32 GetNumUnchangedCaptureSkips() const { return NumUnchangedCaptureSkips; }
+
+private:
+	void EvaluateMirrors(const int32 MirrorsPerEvaluationTask)
+	{
+		MIRROR_SCOPE_CYCLE_COUNTER(EvaluateMirrors);
+
+		// A mirror may have been destroyed by an actor ticking after it.
+		PendingEvaluations.RemoveAll([](const MirrorType* Mirror) { return !IsValid(Mirror); });
+
+		// Evaluating a mirror only reads the scene and writes to the mirror itself, so they can all run at once.
+		ParallelFor(TEXT("MirrorEvaluation"), PendingEvaluations.Num(), FMath::Max(MirrorsPerEvaluationTask, 1),
+		            [this](const int32 Index)
+		            {
+			            PendingEvaluations[Index]->EvaluateFrame();
+		            });
+
+		for (MirrorType* Mirror : PendingEvaluations)
+		{
+			Mirror->SubmitFrame();
+		}
+
+		PendingEvaluations.Reset();
+	}
+
+	TArray<MirrorType*> PendingEvaluations;
+	FMirrorCaptureScheduler CaptureScheduler;
+	int32 NumDeferredCaptures = 0;
+	int32 NumUnchangedCaptureSkips = 0;
+	int32 NumUnchangedCaptureSkipsThisFrame = 0;
+};
@@ -0,0 +1,48 @@
+#include "MirrorCaptureScheduler.h"
+
+void FMirrorCaptureScheduler::AddRequest(const FMirrorCaptureRequest& Request)
+{
+	PendingRequests.Add(Request);
+}
+
+TArrayView<const FMirrorCaptureRequest> FMirrorCaptureScheduler::SelectCaptures(const FMirrorCaptureBudget& Budget)
+{
+	for (FMirrorCaptureRequest& Request : PendingRequests)
+	{
+		// Staleness grows the priority so mirrors that keep losing to closer ones still get refreshed eventually.
+		Request.Priority = Request.ProjectedSize * (1 + Request.TimeSinceLastCapture * Budget.StalenessWeight);
+	}
+
+	PendingRequests.Sort([](const FMirrorCaptureRequest& A, const FMirrorCaptureRequest& B)
+	{
+		return A.Priority > B.Priority;
+	});
+
+	int32 NumSelected = 0;
+	float SelectedCost = 0;
+	for (const FMirrorCaptureRequest& Request : PendingRequests)
+	{
+		if (NumSelected > 0)
+		{
+			if (Budget.MaxCaptures > 0 && NumSelected >= Budget.MaxCaptures)
+			{
+				break;
+			}
+
+			if (Budget.MaxCost > 0 && SelectedCost + Request.Cost > Budget.MaxCost)
+			{
+				break;
+			}
+		}
+
+		SelectedCost += Request.Cost;
+		NumSelected++;
+	}
+
+	return TArrayView<const FMirrorCaptureRequest>(PendingRequests.GetData(), NumSelected);
+}
+
+void FMirrorCaptureScheduler::Reset()
+{
+	PendingRequests.Reset();
+}
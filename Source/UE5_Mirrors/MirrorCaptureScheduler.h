@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// A mirror asking to be captured this frame, along with the data used to rank it against other mirrors.
+struct FMirrorCaptureRequest
+{
+	TWeakObjectPtr<AActor> Mirror;
+
+	// Distance from the active camera to the mirror's bounds.
+	float Distance = 0;
+
+	// Mirror bounds radius divided by distance. Roughly how large the mirror appears on screen.
+	float ProjectedSize = 0;
+
+	// Seconds since this mirror was last captured.
+	float TimeSinceLastCapture = 0;
+
+	// Estimated cost of the capture in captured megapixels.
+	float Cost = 0;
+
+	float Priority = 0;
+};
+
+struct FMirrorCaptureBudget
+{
+	// Maximum number of captures executed per frame. 0 for unlimited.
+	int32 MaxCaptures = 0;
+
+	// Maximum summed capture cost per frame. 0 for unlimited.
+	float MaxCost = 0;
+
+	// How much each second without a capture raises a mirror's priority.
+	float StalenessWeight = 1;
+};
+
+// Collects capture requests during the frame and picks the ones that fit into the frame's budget.
+class UE5_MIRRORS_API FMirrorCaptureScheduler
+{
+public:
+	void AddRequest(const FMirrorCaptureRequest& Request);
+
+	// Ranks pending requests by priority and returns the highest ranked ones that fit into the budget.
+	// At least one request is always selected so a single expensive mirror can't starve itself.
+	TArrayView<const FMirrorCaptureRequest> SelectCaptures(const FMirrorCaptureBudget& Budget);
+
+	void Reset();
+
+	int32 GetNumPending() const { return PendingRequests.Num(); }
+
+private:
+	TArray<FMirrorCaptureRequest> PendingRequests;
+};
@@ -0,0 +1,202 @@
+#include "MirrorChangeDetector.h"
+#include "MirrorPrimitiveIndex.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "GameFramework/Actor.h"
+#include "Particles/ParticleSystemComponent.h"
+
+uint32 FMirrorChangeDetector::RenderStateGeneration = 0;
+TMap<TObjectKey<UPrimitiveComponent>, uint32> FMirrorChangeDetector::PrimitiveRenderStateGenerations;
+FDelegateHandle FMirrorChangeDetector::RenderStateDirtyHandle;
+int32 FMirrorChangeDetector::NumRenderStateTrackers = 0;
+
+bool FMirrorChangeDetector::IsUnchanged(const FTransform& MirroredCameraTransform,
+                                        const TArray<TObjectPtr<AActor>>& ShownActors,
+                                        const TArray<TWeakObjectPtr<UPrimitiveComponent>>& ShownComponents,
+                                        const float LocationTolerance, const float RotationToleranceDegrees,
+                                        const float MaxSkipTime, const float Time) const
+{
+	if (!bHasCapture)
+	{
+		return false;
+	}
+
+	if (Time - LastCaptureTime >= MaxSkipTime)
+	{
+		return false;
+	}
+
+	const float LocationDeltaSquared = FVector::DistSquared(MirroredCameraTransform.GetLocation(),
+	                                                        LastCameraTransform.GetLocation());
+	if (LocationDeltaSquared > FMath::Square(LocationTolerance))
+	{
+		return false;
+	}
+
+	const float RotationDelta = MirroredCameraTransform.GetRotation().AngularDistance(LastCameraTransform.GetRotation());
+	if (RotationDelta > FMath::DegreesToRadians(RotationToleranceDegrees))
+	{
+		return false;
+	}
+
+	return !HasRenderStateChanged(ShownActors, ShownComponents, LastRenderStateGeneration) &&
+		HashRenderState(ShownActors, ShownComponents) == LastRenderStateHash;
+}
+
+void FMirrorChangeDetector::OnCaptured(const FTransform& MirroredCameraTransform,
+                                       const TArray<TObjectPtr<AActor>>& ShownActors,
+                                       const TArray<TWeakObjectPtr<UPrimitiveComponent>>& ShownComponents,
+                                       const float Time)
+{
+	LastCameraTransform = MirroredCameraTransform;
+	LastRenderStateHash = HashRenderState(ShownActors, ShownComponents);
+	LastRenderStateGeneration = RenderStateGeneration;
+	LastCaptureTime = Time;
+	bHasCapture = true;
+}
+
+void FMirrorChangeDetector::OnCulled(const FMirrorPrimitiveIndex& Index, const FBox& CulledVolume)
+{
+	LastCulledVolume = CulledVolume;
+	LastCullingRevision = Index.GetRevision();
+}
+
+bool FMirrorChangeDetector::HasCulledVolumeChanged(const FMirrorPrimitiveIndex& Index) const
+{
+	return LastCulledVolume.IsValid && Index.HasChangedSince(LastCullingRevision, LastCulledVolume);
+}
+
+void FMirrorChangeDetector::Reset()
+{
+	bHasCapture = false;
+}
+
+uint32 FMirrorChangeDetector::HashRenderState(const TArray<TObjectPtr<AActor>>& Actors,
+                                              const TArray<TWeakObjectPtr<UPrimitiveComponent>>& Components)
+{
+	uint32 Hash = 0;
+	for (const AActor* Actor : Actors)
+	{
+		Hash = HashActorRenderState(Actor, Hash);
+	}
+
+	for (const TWeakObjectPtr<UPrimitiveComponent>& Component : Components)
+	{
+		Hash = HashPrimitiveRenderState(Component.Get(), Hash);
+	}
+
+	return Hash;
+}
+
+uint32 FMirrorChangeDetector::HashActorRenderState(const AActor* Actor, uint32 Hash)
+{
+	if (!Actor)
+	{
+		return Hash;
+	}
+
+	Hash = HashCombine(Hash, GetTypeHash(Actor));
+	Hash = HashCombine(Hash, Actor->IsHidden());
+
+	Actor->ForEachComponent<UPrimitiveComponent>(false, [&Hash](const UPrimitiveComponent* Primitive)
+	{
+		Hash = HashPrimitiveRenderState(Primitive, Hash);
+	});
+
+	return Hash;
+}
+
+uint32 FMirrorChangeDetector::HashPrimitiveRenderState(const UPrimitiveComponent* Primitive, uint32 Hash)
+{
+	if (!Primitive)
+	{
+		return Hash;
+	}
+
+	const FBoxSphereBounds& Bounds = Primitive->Bounds;
+	const FQuat Rotation = Primitive->GetComponentQuat();
+	Hash = FCrc::MemCrc32(&Bounds.Origin, sizeof(Bounds.Origin), Hash);
+	Hash = FCrc::MemCrc32(&Bounds.BoxExtent, sizeof(Bounds.BoxExtent), Hash);
+	Hash = FCrc::MemCrc32(&Rotation, sizeof(Rotation), Hash);
+	Hash = HashCombine(Hash, Primitive->IsVisible());
+	return Hash;
+}
+
+bool FMirrorChangeDetector::HasRenderStateChanged(const UPrimitiveComponent* Primitive, const uint32 SinceGeneration)
+{
+	if (!Primitive)
+	{
+		return false;
+	}
+
+	if (Primitive->IsA<USkinnedMeshComponent>() || Primitive->IsA<UFXSystemComponent>())
+	{
+		return true;
+	}
+
+	const uint32* Generation = PrimitiveRenderStateGenerations.Find(TObjectKey<UPrimitiveComponent>(Primitive));
+	return Generation && *Generation > SinceGeneration;
+}
+
+bool FMirrorChangeDetector::HasRenderStateChanged(const TArray<TObjectPtr<AActor>>& Actors,
+                                                  const TArray<TWeakObjectPtr<UPrimitiveComponent>>& Components,
+                                                  const uint32 SinceGeneration)
+{
+	for (const AActor* Actor : Actors)
+	{
+		bool bChanged = false;
+		if (Actor)
+		{
+			Actor->ForEachComponent<UPrimitiveComponent>(false, [&bChanged, SinceGeneration](const UPrimitiveComponent* Primitive)
+			{
+				bChanged = bChanged || HasRenderStateChanged(Primitive, SinceGeneration);
+			});
+		}
+
+		if (bChanged)
+		{
+			return true;
+		}
+	}
+
+	return Components.ContainsByPredicate([SinceGeneration](const TWeakObjectPtr<UPrimitiveComponent>& Component)
+	{
+		return HasRenderStateChanged(Component.Get(), SinceGeneration);
+	});
+}
+
+void FMirrorChangeDetector::StartTrackingRenderState()
+{
+	if (NumRenderStateTrackers++ == 0)
+	{
+		RenderStateDirtyHandle = UActorComponent::MarkRenderStateDirtyEvent.AddStatic(&FMirrorChangeDetector::OnRenderStateDirty);
+	}
+}
+
+void FMirrorChangeDetector::StopTrackingRenderState()
+{
+	if (--NumRenderStateTrackers == 0)
+	{
+		UActorComponent::MarkRenderStateDirtyEvent.Remove(RenderStateDirtyHandle);
+		PrimitiveRenderStateGenerations.Empty();
+	}
+}
+
+void FMirrorChangeDetector::PruneRenderStateGenerations()
+{
+	for (auto It = PrimitiveRenderStateGenerations.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().ResolveObjectPtr())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FMirrorChangeDetector::OnRenderStateDirty(UActorComponent& Component)
+{
+	if (const UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(&Component))
+	{
+		PrimitiveRenderStateGenerations.Add(TObjectKey<UPrimitiveComponent>(Primitive), ++RenderStateGeneration);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+class FMirrorPrimitiveIndex;
+class UActorComponent;
+class UPrimitiveComponent;
+
+// Remembers what the last capture of a mirror saw, so captures can be skipped while nothing in the reflection changes.
+class UE5_MIRRORS_API FMirrorChangeDetector
+{
+public:
+	// True if the mirrored camera moved less than the given tolerances and no shown actor or component changed since the last capture.
+	bool IsUnchanged(const FTransform& MirroredCameraTransform, const TArray<TObjectPtr<AActor>>& ShownActors,
+	                 const TArray<TWeakObjectPtr<UPrimitiveComponent>>& ShownComponents, float LocationTolerance,
+	                 float RotationToleranceDegrees, float MaxSkipTime, float Time) const;
+
+	void OnCaptured(const FTransform& MirroredCameraTransform, const TArray<TObjectPtr<AActor>>& ShownActors,
+	                const TArray<TWeakObjectPtr<UPrimitiveComponent>>& ShownComponents, float Time);
+
+	// The shown lists only change when the mirror culls again, so mirrors that cull also remember the volume their culling
+	// looked into. A primitive entering it then counts as a change even though it isn't shown yet.
+	void OnCulled(const FMirrorPrimitiveIndex& Index, const FBox& CulledVolume);
+
+	// True if the index saw a primitive change inside the last culled volume. False while the mirror hasn't culled.
+	bool HasCulledVolumeChanged(const FMirrorPrimitiveIndex& Index) const;
+
+	// Forget the last capture, e.g. after the render target was recreated.
+	void Reset();
+
+	// Hashes the bounds, rotation and visibility of every primitive of the actor.
+	static uint32 HashActorRenderState(const AActor* Actor, uint32 Hash);
+
+	// Render state changes, like a new material or mesh, are picked up from UActorComponent::MarkRenderStateDirtyEvent.
+	// Material parameter changes don't mark the render state dirty and are not picked up.
+	// Tracking runs while at least one mirror subsystem is alive. Prune drops the entries of destroyed components.
+	static void StartTrackingRenderState();
+	static void StopTrackingRenderState();
+	static void PruneRenderStateGenerations();
+
+private:
+	static uint32 HashRenderState(const TArray<TObjectPtr<AActor>>& Actors,
+	                              const TArray<TWeakObjectPtr<UPrimitiveComponent>>& Components);
+	static uint32 HashPrimitiveRenderState(const UPrimitiveComponent* Primitive, uint32 Hash);
+
+	// True if the primitive's render state was marked dirty after the given generation. Skinned meshes and particle systems
+	// update their render data every frame without marking it dirty, so they always count as changed.
+	static bool HasRenderStateChanged(const UPrimitiveComponent* Primitive, uint32 SinceGeneration);
+	static bool HasRenderStateChanged(const TArray<TObjectPtr<AActor>>& Actors,
+	                                  const TArray<TWeakObjectPtr<UPrimitiveComponent>>& Components, uint32 SinceGeneration);
+	static void OnRenderStateDirty(UActorComponent& Component);
+
+	// Bumped on every render state change. Written on the game thread, which waits while mirrors are evaluated.
+	static uint32 RenderStateGeneration;
+	static TMap<TObjectKey<UPrimitiveComponent>, uint32> PrimitiveRenderStateGenerations;
+	static FDelegateHandle RenderStateDirtyHandle;
+	static int32 NumRenderStateTrackers;
+
+	FTransform LastCameraTransform = FTransform::Identity;
+	uint32 LastRenderStateHash = 0;
+	uint32 LastRenderStateGeneration = 0;
+	float LastCaptureTime = 0;
+	bool bHasCapture = false;
+	FBox LastCulledVolume = FBox(ForceInit);
+	uint32 LastCullingRevision = 0;
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
+
+// Mirror math shared by ACMirror and ACVrMirror, specialized on the number of views one capture renders.
+// Views sit side by side along the camera's right vector, ViewSpacing apart and centered on the camera.
+// One view is the camera itself, two are a pair of eyes. The mirror's plane is the local YZ plane of its transform.
+template <int32 NumViews>
+class TMirrorCore
+{
+	static_assert(NumViews > 0, "A mirror renders at least one view");
+
+public:
+	using FViewTransforms = TStaticArray<FTransform, NumViews>;
+
+	// Smallest change of a continuously adjusted capture quality that resizes the render targets.
+	static constexpr float MinContinuousQualityChange = 0.05f;
+
+	// How far the outermost view sits from the center.
+	static double CalcViewMargin(const double ViewSpacing)
+	{
+		return (NumViews - 1) * 0.5 * ViewSpacing;
+	}
+
+	static FTransform MirrorCamera(const FTransform& MirrorTransform, const FTransform& CameraTransform)
+	{
+		FVector NewCameraLocation = MirrorTransform.InverseTransformPosition(CameraTransform.GetLocation());
+		NewCameraLocation.X *= -1;
+		NewCameraLocation = MirrorTransform.TransformPosition(NewCameraLocation);
+
+		const FVector MirrorForward = MirrorTransform.GetRotation().GetForwardVector();
+		const FVector CameraForward = CameraTransform.GetRotation().GetForwardVector();
+		const FVector CameraRight = CameraTransform.GetRotation().GetRightVector();
+
+		const FVector MirroredCamForward = FMath::GetReflectionVector(CameraForward, MirrorForward);
+		const FVector MirroredCamRight = FMath::GetReflectionVector(CameraRight, MirrorForward);
+		const FRotator NewCameraRotation = FRotationMatrix::MakeFromXY(MirroredCamForward, MirroredCamRight).Rotator();
+		return FTransform(NewCameraRotation, NewCameraLocation);
+	}
+
+	// Works for mirrored cameras too, their right vector is already mirrored, so the views come out mirrored in the same order.
+	static FViewTransforms CalcViewTransforms(const FTransform& CameraTransform, const double ViewSpacing)
+	{
+		const FQuat CameraRotation = CameraTransform.GetRotation();
+		const FVector RightVector = CameraRotation.GetRightVector();
+		const double FirstOffset = -CalcViewMargin(ViewSpacing);
+
+		FViewTransforms Views;
+		for (int32 View = 0; View < NumViews; View++)
+		{
+			const FVector ViewLocation = CameraTransform.GetLocation() + RightVector * (FirstOffset + View * ViewSpacing);
+			Views[View] = FTransform(CameraRotation, ViewLocation);
+		}
+
+		return Views;
+	}
+
+	static bool IsCameraInCaptureDistance(const FTransform& MirrorTransform, const FVector& CameraLocation,
+	                                      const float MaxDistance)
+	{
+		return FVector::DistSquared(CameraLocation, MirrorTransform.GetLocation()) < FMath::Square(MaxDistance);
+	}
+
+	// False once the camera is far enough behind the mirror that no view can see it even when perpendicular.
+	static bool IsCameraInFrontOfMirror(const FTransform& MirrorTransform, const FVector& CameraLocation,
+	                                    const double ViewSpacing)
+	{
+		const FVector MirrorToCameraLocal = MirrorTransform.InverseTransformPositionNoScale(CameraLocation);
+		return MirrorToCameraLocal.X > -CalcViewMargin(ViewSpacing);
+	}
+
+	// Snaps a target capture quality to its step, keeping the current quality while the target stays within the step widened by the hysteresis.
+	// Without the hysteresis a camera hovering around a step boundary would flip between two resolutions on every check.
+	// A target at the maximum always snaps to it, the widened step above the top step would otherwise never let it be reached.
+	// Every new quality reallocates the render targets, so without steps it has to move by at least MinContinuousQualityChange.
+	static float StepCaptureQuality(float TargetQuality, const float CurrentQuality, const float MaxQuality, float StepSize,
+	                                float Hysteresis)
+	{
+		if (TargetQuality >= MaxQuality - KINDA_SMALL_NUMBER)
+		{
+			return MaxQuality;
+		}
+
+		StepSize = FMath::Max(StepSize, 0.f);
+		if (StepSize == 0)
+		{
+			Hysteresis = FMath::Max(Hysteresis, MinContinuousQualityChange);
+		}
+
+		if (TargetQuality > CurrentQuality - Hysteresis && TargetQuality < CurrentQuality + StepSize + Hysteresis)
+		{
+			return CurrentQuality;
+		}
+
+		if (StepSize > 0)
+		{
+			TargetQuality = FMath::FloorToFloat(TargetQuality / StepSize + KINDA_SMALL_NUMBER) * StepSize;
+		}
+
+		return TargetQuality;
+	}
+
+	// Frustum from the mirrored camera through the mirror's corners, widened by the view margin so every view's frustum lies inside it.
+	// Planes face inwards in the order near, far, top, bottom, left, right. Corners are top left, top right, bottom left, bottom right.
+	static void CalcCullingFrustum(const FTransform& MirrorTransform, const FVector2D& MirrorHalfSize,
+	                               const FVector& MirroredCameraLocation, const double ViewSpacing,
+	                               const float FarDistance, TArray<FPlane, TInlineAllocator<6>>& OutPlanes,
+	                               FVector (&OutCorners)[4])
+	{
+		const FVector MirrorLocation = MirrorTransform.GetLocation();
+		const FQuat MirrorRotation = MirrorTransform.GetRotation();
+		const FVector MirrorForward = MirrorRotation.GetForwardVector();
+		const FVector MirrorRight = MirrorRotation.GetRightVector();
+		const FVector MirrorUp = MirrorRotation.GetUpVector();
+		const double ViewMargin = CalcViewMargin(ViewSpacing);
+		const double MirrorHalfWidth = MirrorHalfSize.X + ViewMargin;
+		const double MirrorHalfHeight = MirrorHalfSize.Y + ViewMargin;
+
+		const FVector MirrorTop = MirrorLocation + MirrorUp * MirrorHalfHeight;
+		const FVector MirrorBottom = MirrorLocation - MirrorUp * MirrorHalfHeight;
+
+		const FVector MirrorTopLeft = MirrorTop - MirrorRight * MirrorHalfWidth;
+		const FVector MirrorTopRight = MirrorTop + MirrorRight * MirrorHalfWidth;
+		const FVector MirrorBottomLeft = MirrorBottom - MirrorRight * MirrorHalfWidth;
+		const FVector MirrorBottomRight = MirrorBottom + MirrorRight * MirrorHalfWidth;
+
+		const FVector CaptureToTopLeft = (MirrorTopLeft - MirroredCameraLocation).GetSafeNormal();
+		const FVector CaptureToTopRight = (MirrorTopRight - MirroredCameraLocation).GetSafeNormal();
+		const FVector CaptureToBottomLeft = (MirrorBottomLeft - MirroredCameraLocation).GetSafeNormal();
+		const FVector CaptureToBottomRight = (MirrorBottomRight - MirroredCameraLocation).GetSafeNormal();
+		const FVector CaptureToMirror = (MirrorLocation - MirroredCameraLocation).GetSafeNormal();
+
+		const FVector FarPlanePoint = MirrorLocation + CaptureToMirror * FarDistance;
+		const FVector TopPlaneNormal = FVector::CrossProduct(CaptureToTopRight, CaptureToTopLeft).GetSafeNormal();
+		const FVector BottomPlaneNormal = FVector::CrossProduct(CaptureToBottomLeft, CaptureToBottomRight).GetSafeNormal();
+		const FVector LeftPlaneNormal = FVector::CrossProduct(CaptureToTopLeft, CaptureToBottomLeft).GetSafeNormal();
+		const FVector RightPlaneNormal = FVector::CrossProduct(CaptureToBottomRight, CaptureToTopRight).GetSafeNormal();
+
+		OutPlanes = {
+			FPlane(MirrorTopLeft, MirrorForward),
+			FPlane(FarPlanePoint, -CaptureToMirror),
+			FPlane(MirrorTopLeft, TopPlaneNormal),
+			FPlane(MirrorBottomLeft, BottomPlaneNormal),
+			FPlane(MirrorTopLeft, LeftPlaneNormal),
+			FPlane(MirrorTopRight, RightPlaneNormal)
+		};
+
+		OutCorners[0] = MirrorTopLeft;
+		OutCorners[1] = MirrorTopRight;
+		OutCorners[2] = MirrorBottomLeft;
+		OutCorners[3] = MirrorBottomRight;
+	}
+};
@@ -0,0 +1,62 @@
+#include "MirrorCore.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMirrorStepCaptureQualityTest, "UE5_Mirrors.Core.StepCaptureQuality",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMirrorStepCaptureQualityTest::RunTest(const FString& Parameters)
+{
+	constexpr float MaxQuality = 1;
+	constexpr float MinQuality = 0.3f;
+	constexpr float Hysteresis = 0.05f;
+
+	// Walks the target down to the minimum and back up in small increments, the way a camera walking away and back would.
+	auto Walk = [&](const float Step, const TCHAR* Mode)
+	{
+		constexpr int32 NumIncrements = 70;
+		float Quality = MaxQuality;
+		for (int32 Increment = 0; Increment <= NumIncrements; Increment++)
+		{
+			const float Target = FMath::Lerp(MaxQuality, MinQuality, static_cast<float>(Increment) / NumIncrements);
+			const float NewQuality = TMirrorCore<1>::StepCaptureQuality(Target, Quality, MaxQuality, Step, Hysteresis);
+			TestTrue(FString::Printf(TEXT("%s: never rises while walking down"), Mode), NewQuality <= Quality);
+			Quality = NewQuality;
+		}
+		TestTrue(FString::Printf(TEXT("%s: dropped within a step of the minimum"), Mode),
+		         Quality <= MinQuality + Hysteresis + KINDA_SMALL_NUMBER);
+
+		for (int32 Increment = NumIncrements; Increment >= 0; Increment--)
+		{
+			const float Target = FMath::Lerp(MaxQuality, MinQuality, static_cast<float>(Increment) / NumIncrements);
+			const float NewQuality = TMirrorCore<1>::StepCaptureQuality(Target, Quality, MaxQuality, Step, Hysteresis);
+			TestTrue(FString::Printf(TEXT("%s: never drops while walking up"), Mode), NewQuality >= Quality);
+			TestTrue(FString::Printf(TEXT("%s: never exceeds the maximum"), Mode), NewQuality <= MaxQuality);
+			Quality = NewQuality;
+		}
+		TestEqual(FString::Printf(TEXT("%s: climbs back to the maximum"), Mode), Quality, MaxQuality);
+	};
+
+	Walk(0.1f, TEXT("Stepped"));
+	Walk(0, TEXT("Continuous"));
+
+	// The top step has to be reachable from the step right below it.
+	TestEqual(TEXT("Top step is reachable"),
+	          TMirrorCore<1>::StepCaptureQuality(MaxQuality, 0.9f, MaxQuality, 0.1f, Hysteresis), MaxQuality);
+
+	// Within the hysteresis the current quality is kept.
+	TestEqual(TEXT("Small drop keeps the current step"),
+	          TMirrorCore<1>::StepCaptureQuality(0.97f, MaxQuality, MaxQuality, 0.1f, Hysteresis), MaxQuality);
+	TestEqual(TEXT("Small rise keeps the current step"),
+	          TMirrorCore<1>::StepCaptureQuality(0.62f, 0.5f, MaxQuality, 0.1f, Hysteresis), 0.5f);
+
+	// Each change reallocates the render target, so continuous quality ignores small changes even without hysteresis.
+	TestEqual(TEXT("Continuous quality keeps small changes"),
+	          TMirrorCore<1>::StepCaptureQuality(0.78f, 0.8f, MaxQuality, 0, 0), 0.8f);
+	TestEqual(TEXT("Continuous quality follows large changes"),
+	          TMirrorCore<1>::StepCaptureQuality(0.7f, 0.8f, MaxQuality, 0, 0), 0.7f);
+	return true;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#include "MirrorCullingCache.h"
+#include "MirrorPrimitiveIndex.h"
+
+FIntVector FMirrorCullingCache::QuantizeLocation(const FVector& Location, const float CellSize)
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize),
+	                  FMath::FloorToInt(Location.Y / CellSize),
+	                  FMath::FloorToInt(Location.Z / CellSize));
+}
+
+bool FMirrorCullingCache::IsValid(const FIntVector& CameraCell, const FTransform& MirrorTransform,
+                                  const FMirrorPrimitiveIndex& Index, const float Time, const float MaxAge) const
+{
+	if (!bIsStored || CameraCell != CachedCameraCell)
+	{
+		return false;
+	}
+
+	if (MaxAge > 0 && Time - StoreTime >= MaxAge)
+	{
+		return false;
+	}
+
+	if (!MirrorTransform.Equals(CachedMirrorTransform))
+	{
+		return false;
+	}
+
+	return !Index.HasChangedSince(CachedRevision, CachedVolume);
+}
+
+void FMirrorCullingCache::Store(const FIntVector& CameraCell, const FTransform& MirrorTransform,
+                                const FMirrorPrimitiveIndex& Index, const FBox& CulledVolume, const float Time)
+{
+	CachedCameraCell = CameraCell;
+	CachedMirrorTransform = MirrorTransform;
+	CachedVolume = CulledVolume;
+	CachedRevision = Index.GetRevision();
+	StoreTime = Time;
+	bIsStored = true;
+}
+
+void FMirrorCullingCache::Invalidate()
+{
+	bIsStored = false;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FMirrorPrimitiveIndex;
+
+// Lets a mirror reuse its last culling result while the mirrored camera stays inside the same grid cell.
+class UE5_MIRRORS_API FMirrorCullingCache
+{
+public:
+	static FIntVector QuantizeLocation(const FVector& Location, float CellSize);
+
+	// True if the last stored result was made from the same cell and mirror transform, it isn't older than MaxAge
+	// and the primitive index saw no change inside the culled volume since.
+	bool IsValid(const FIntVector& CameraCell, const FTransform& MirrorTransform, const FMirrorPrimitiveIndex& Index,
+	             float Time, float MaxAge) const;
+
+	// CulledVolume has to enclose everything the culling could have seen, so that a primitive moving into view invalidates the result.
+	void Store(const FIntVector& CameraCell, const FTransform& MirrorTransform, const FMirrorPrimitiveIndex& Index,
+	           const FBox& CulledVolume, float Time);
+
+	void Invalidate();
+
+private:
+	FTransform CachedMirrorTransform = FTransform::Identity;
+	FIntVector CachedCameraCell = FIntVector::ZeroValue;
+	FBox CachedVolume = FBox(ForceInit);
+	uint32 CachedRevision = 0;
+	float StoreTime = 0;
+	bool bIsStored = false;
+};
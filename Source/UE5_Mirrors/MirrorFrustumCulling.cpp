@@ -0,0 +1,172 @@
+#include "MirrorFrustumCulling.h"
+#include "MirrorStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/VectorRegister.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMirrorCulling, Log, All);
+
+#if !UE_BUILD_SHIPPING
+static TAutoConsoleVariable<bool> CVarMirrorVerifyCullingKernel(
+	TEXT("Mirror.VerifyCullingKernel"), false,
+	TEXT("Run the scalar culling path next to the vector kernel and log every candidate they disagree on."));
+#endif
+
+void FMirrorCullingBounds::Add(const FBox& Box)
+{
+	const FVector3f Center(Box.GetCenter());
+	const FVector3f Extent(Box.GetExtent());
+	CenterX.Add(Center.X);
+	CenterY.Add(Center.Y);
+	CenterZ.Add(Center.Z);
+	ExtentX.Add(Extent.X);
+	ExtentY.Add(Extent.Y);
+	ExtentZ.Add(Extent.Z);
+	Radius.Add(Extent.Size());
+}
+
+void FMirrorCullingBounds::Reset()
+{
+	CenterX.Reset();
+	CenterY.Reset();
+	CenterZ.Reset();
+	ExtentX.Reset();
+	ExtentY.Reset();
+	ExtentZ.Reset();
+	Radius.Reset();
+}
+
+void FMirrorFrustumCulling::TestBounds(const FMirrorCullingBounds& Bounds, TConstArrayView<FPlane> Planes,
+                                       const bool bUseBoxes, TArray<uint8>& OutVisible)
+{
+	MIRROR_SCOPE_CYCLE_COUNTER(PlaneTests);
+
+	OutVisible.SetNumUninitialized(Bounds.Num());
+
+	const int32 NumVectorized = Bounds.Num() & ~3;
+	TestBoundsVector(Bounds, Planes, bUseBoxes, NumVectorized, OutVisible);
+	TestBoundsScalar(Bounds, Planes, bUseBoxes, NumVectorized, OutVisible);
+
+#if !UE_BUILD_SHIPPING
+	// Also runs on the async culling task, so the game thread value can't be used.
+	if (CVarMirrorVerifyCullingKernel.GetValueOnAnyThread())
+	{
+		VerifyBounds(Bounds, Planes, bUseBoxes, OutVisible);
+	}
+#endif
+}
+
+void FMirrorFrustumCulling::TestBoundsScalar(const FMirrorCullingBounds& Bounds, TConstArrayView<FPlane> Planes,
+                                             const bool bUseBoxes, const int32 StartIndex, TArray<uint8>& OutVisible)
+{
+	OutVisible.SetNumUninitialized(Bounds.Num());
+
+	for (int32 Index = StartIndex; Index < Bounds.Num(); Index++)
+	{
+		bool bIsVisible = true;
+		for (const FPlane& Plane : Planes)
+		{
+			const float PlaneX = Plane.X;
+			const float PlaneY = Plane.Y;
+			const float PlaneZ = Plane.Z;
+			const float PlaneW = Plane.W;
+
+			// Same operation order as the vector kernel. Platforms with fused multiply-add can still differ in the last bit.
+			const float Distance = Bounds.CenterX[Index] * PlaneX +
+				(Bounds.CenterY[Index] * PlaneY + (Bounds.CenterZ[Index] * PlaneZ - PlaneW));
+			const float Radius = bUseBoxes
+				                     ? Bounds.ExtentX[Index] * FMath::Abs(PlaneX) +
+				                     (Bounds.ExtentY[Index] * FMath::Abs(PlaneY) +
+					                     Bounds.ExtentZ[Index] * FMath::Abs(PlaneZ))
+				                     : Bounds.Radius[Index];
+
+			if (Distance < -Radius)
+			{
+				bIsVisible = false;
+				break;
+			}
+		}
+
+		OutVisible[Index] = bIsVisible;
+	}
+}
+
+void FMirrorFrustumCulling::TestBoundsVector(const FMirrorCullingBounds& Bounds, TConstArrayView<FPlane> Planes,
+                                             const bool bUseBoxes, const int32 NumVectorized,
+                                             TArray<uint8>& OutVisible)
+{
+	struct FPlaneVectors
+	{
+		VectorRegister4Float X;
+		VectorRegister4Float Y;
+		VectorRegister4Float Z;
+		VectorRegister4Float NegW;
+		VectorRegister4Float AbsX;
+		VectorRegister4Float AbsY;
+		VectorRegister4Float AbsZ;
+	};
+
+	// Splat every plane component once instead of per block of candidates.
+	TArray<FPlaneVectors, TInlineAllocator<8>> PlaneVectors;
+	for (const FPlane& Plane : Planes)
+	{
+		FPlaneVectors& Vectors = PlaneVectors.AddDefaulted_GetRef();
+		Vectors.X = VectorSetFloat1(static_cast<float>(Plane.X));
+		Vectors.Y = VectorSetFloat1(static_cast<float>(Plane.Y));
+		Vectors.Z = VectorSetFloat1(static_cast<float>(Plane.Z));
+		Vectors.NegW = VectorSetFloat1(-static_cast<float>(Plane.W));
+		Vectors.AbsX = VectorAbs(Vectors.X);
+		Vectors.AbsY = VectorAbs(Vectors.Y);
+		Vectors.AbsZ = VectorAbs(Vectors.Z);
+	}
+
+	for (int32 Index = 0; Index < NumVectorized; Index += 4)
+	{
+		const VectorRegister4Float CenterX = VectorLoad(&Bounds.CenterX[Index]);
+		const VectorRegister4Float CenterY = VectorLoad(&Bounds.CenterY[Index]);
+		const VectorRegister4Float CenterZ = VectorLoad(&Bounds.CenterZ[Index]);
+		const VectorRegister4Float ExtentX = bUseBoxes ? VectorLoad(&Bounds.ExtentX[Index]) : VectorZeroFloat();
+		const VectorRegister4Float ExtentY = bUseBoxes ? VectorLoad(&Bounds.ExtentY[Index]) : VectorZeroFloat();
+		const VectorRegister4Float ExtentZ = bUseBoxes ? VectorLoad(&Bounds.ExtentZ[Index]) : VectorZeroFloat();
+		const VectorRegister4Float SphereRadius = bUseBoxes ? VectorZeroFloat() : VectorLoad(&Bounds.Radius[Index]);
+
+		VectorRegister4Float Outside = VectorZeroFloat();
+		for (const FPlaneVectors& Plane : PlaneVectors)
+		{
+			const VectorRegister4Float Distance = VectorMultiplyAdd(
+				CenterX, Plane.X, VectorMultiplyAdd(CenterY, Plane.Y, VectorMultiplyAdd(CenterZ, Plane.Z, Plane.NegW)));
+			const VectorRegister4Float Radius = bUseBoxes
+				                                    ? VectorMultiplyAdd(
+					                                    ExtentX, Plane.AbsX,
+					                                    VectorMultiplyAdd(ExtentY, Plane.AbsY,
+					                                                      VectorMultiply(ExtentZ, Plane.AbsZ)))
+				                                    : SphereRadius;
+
+			Outside = VectorBitwiseOr(Outside, VectorCompareLT(Distance, VectorNegate(Radius)));
+		}
+
+		const int32 OutsideMask = VectorMaskBits(Outside);
+		OutVisible[Index] = !(OutsideMask & 1);
+		OutVisible[Index + 1] = !(OutsideMask & 2);
+		OutVisible[Index + 2] = !(OutsideMask & 4);
+		OutVisible[Index + 3] = !(OutsideMask & 8);
+	}
+}
+
+void FMirrorFrustumCulling::VerifyBounds(const FMirrorCullingBounds& Bounds, TConstArrayView<FPlane> Planes,
+                                         const bool bUseBoxes, const TArray<uint8>& Visible)
+{
+	TArray<uint8> Reference;
+	TestBoundsScalar(Bounds, Planes, bUseBoxes, 0, Reference);
+
+	for (int32 Index = 0; Index < Bounds.Num(); Index++)
+	{
+		if (Reference[Index] != Visible[Index])
+		{
+			UE_LOG(LogMirrorCulling, Warning,
+			       TEXT("Culling kernel mismatch for candidate %d: center (%f, %f, %f), extent (%f, %f, %f), scalar %d, vector %d."),
+			       Index, Bounds.CenterX[Index], Bounds.CenterY[Index], Bounds.CenterZ[Index],
+			       Bounds.ExtentX[Index], Bounds.ExtentY[Index], Bounds.ExtentZ[Index], Reference[Index],
+			       Visible[Index]);
+		}
+	}
+}
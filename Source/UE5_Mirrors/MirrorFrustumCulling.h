@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Culling candidates in structure of arrays form, so the vector kernel can load four of them at once.
+struct UE5_MIRRORS_API FMirrorCullingBounds
+{
+	void Add(const FBox& Box);
+	void Reset();
+	int32 Num() const { return CenterX.Num(); }
+
+	TArray<float> CenterX;
+	TArray<float> CenterY;
+	TArray<float> CenterZ;
+	TArray<float> ExtentX;
+	TArray<float> ExtentY;
+	TArray<float> ExtentZ;
+
+	// Radius of the sphere around the box.
+	TArray<float> Radius;
+};
+
+// Batched test of culling candidates against a set of planes. Planes face inwards.
+class UE5_MIRRORS_API FMirrorFrustumCulling
+{
+public:
+	// Sets OutVisible[i] to 1 if candidate i is not completely behind one of the planes, 0 otherwise.
+	// Boxes cull tighter than spheres but cost three multiplies more per plane.
+	static void TestBounds(const FMirrorCullingBounds& Bounds, TConstArrayView<FPlane> Planes, bool bUseBoxes,
+	                       TArray<uint8>& OutVisible);
+
+	// One candidate at a time. Reference for the vector kernel and used for the remainder that doesn't fill a vector.
+	static void TestBoundsScalar(const FMirrorCullingBounds& Bounds, TConstArrayView<FPlane> Planes, bool bUseBoxes,
+	                             int32 StartIndex, TArray<uint8>& OutVisible);
+
+private:
+	static void TestBoundsVector(const FMirrorCullingBounds& Bounds, TConstArrayView<FPlane> Planes, bool bUseBoxes,
+	                             int32 NumVectorized, TArray<uint8>& OutVisible);
+
+	// Runs the scalar path next to the vector kernel and reports any candidate they disagree on.
+	static void VerifyBounds(const FMirrorCullingBounds& Bounds, TConstArrayView<FPlane> Planes, bool bUseBoxes,
+	                         const TArray<uint8>& Visible);
+};
@@ -0,0 +1,105 @@
+#include "MirrorFrustumCulling.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMirrorFrustumCullingKernelTest, "UE5_Mirrors.Culling.VectorKernelMatchesScalar",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMirrorFrustumCullingKernelTest::RunTest(const FString& Parameters)
+{
+	// An axis aligned box from -100 to 100 with integer planes, so both paths compute every distance exactly.
+	const TArray<FPlane> BoxPlanes = {
+		FPlane(1, 0, 0, -100), FPlane(-1, 0, 0, -100),
+		FPlane(0, 1, 0, -100), FPlane(0, -1, 0, -100),
+		FPlane(0, 0, 1, -100), FPlane(0, 0, -1, -100)
+	};
+
+	// A frustum like the mirrors make, with tilted planes.
+	const FVector Apex(-500, 0, 0);
+	const TArray<FPlane> TiltedPlanes = {
+		FPlane(FVector::ZeroVector, FVector::ForwardVector),
+		FPlane(FVector(3000, 0, 0), FVector::BackwardVector),
+		FPlane(Apex, FVector(0.3, 0, -1).GetSafeNormal()),
+		FPlane(Apex, FVector(0.3, 0, 1).GetSafeNormal()),
+		FPlane(Apex, FVector(0.4, 1, 0).GetSafeNormal()),
+		FPlane(Apex, FVector(0.4, -1, 0).GetSafeNormal())
+	};
+
+	// Inside, outside, straddling a plane and exactly touching it from outside.
+	const TArray<FBox> EdgeBoxes = {
+		FBox(FVector(-10), FVector(10)),
+		FBox(FVector(200), FVector(300)),
+		FBox(FVector(90, -10, -10), FVector(110, 10, 10)),
+		FBox(FVector(-110, 50, 50), FVector(-90, 60, 60)),
+		FBox(FVector(100, 0, 0), FVector(120, 20, 20)),
+		FBox(FVector(-120, -20, -20), FVector(-101, 20, 20)),
+		FBox(FVector(-300, -300, -300), FVector(300, 300, 300))
+	};
+
+	FRandomStream Random(1234);
+	TArray<FBox> RandomBoxes;
+	for (int32 Index = 0; Index < 257; Index++)
+	{
+		const FVector Center(Random.FRandRange(-600, 3200), Random.FRandRange(-1500, 1500), Random.FRandRange(-1000, 1000));
+		const FVector Extent(Random.FRandRange(1, 200), Random.FRandRange(1, 200), Random.FRandRange(1, 200));
+		RandomBoxes.Add(FBox(Center - Extent, Center + Extent));
+	}
+
+	FMirrorCullingBounds Bounds;
+	TArray<uint8> Visible;
+	TArray<uint8> Reference;
+	auto Compare = [&](const TArray<FBox>& Boxes, const int32 Count, TConstArrayView<FPlane> Planes, const TCHAR* Name)
+	{
+		Bounds.Reset();
+		for (int32 Index = 0; Index < Count; Index++)
+		{
+			Bounds.Add(Boxes[Index % Boxes.Num()]);
+		}
+
+		for (const bool bUseBoxes : {false, true})
+		{
+			// TestBounds runs the vector kernel on whole blocks of four and the scalar path on the remainder.
+			FMirrorFrustumCulling::TestBounds(Bounds, Planes, bUseBoxes, Visible);
+			FMirrorFrustumCulling::TestBoundsScalar(Bounds, Planes, bUseBoxes, 0, Reference);
+
+			const FString What = FString::Printf(TEXT("%s, %d candidates, %s"), Name, Count,
+			                                     bUseBoxes ? TEXT("boxes") : TEXT("spheres"));
+			if (!TestEqual(What + TEXT(": result count"), Visible.Num(), Count))
+			{
+				continue;
+			}
+
+			for (int32 Index = 0; Index < Count; Index++)
+			{
+				if (Visible[Index] != Reference[Index])
+				{
+					AddError(FString::Printf(TEXT("%s: candidate %d is %d with the vector kernel and %d with the scalar path."),
+					                         *What, Index, Visible[Index], Reference[Index]));
+				}
+			}
+		}
+	};
+
+	// Every remainder from an empty batch up to a few whole blocks.
+	for (int32 Count = 0; Count <= 13; Count++)
+	{
+		Compare(EdgeBoxes, Count, BoxPlanes, TEXT("Edge cases"));
+	}
+
+	Compare(RandomBoxes, RandomBoxes.Num(), TiltedPlanes, TEXT("Random"));
+	Compare(RandomBoxes, RandomBoxes.Num() - 2, TiltedPlanes, TEXT("Random"));
+
+	// The edge cases have to cover both answers, otherwise agreeing would prove little.
+	Bounds.Reset();
+	for (const FBox& Box : EdgeBoxes)
+	{
+		Bounds.Add(Box);
+	}
+	FMirrorFrustumCulling::TestBoundsScalar(Bounds, BoxPlanes, true, 0, Reference);
+	TestTrue(TEXT("Straddling box is visible"), Reference[2] == 1);
+	TestTrue(TEXT("Outside box is culled"), Reference[1] == 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include "MirrorPortal.h"
+#include "MirrorSubsystem.h"
+#include "Components/BoxComponent.h"
+#include "Engine/CollisionProfile.h"
+
+AMirrorPortal::AMirrorPortal()
+{
+	PortalBounds = CreateDefaultSubobject<UBoxComponent>("PortalBounds");
+	PortalBounds->SetBoxExtent(FVector(10, 100, 100));
+	PortalBounds->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+	PortalBounds->SetGenerateOverlapEvents(false);
+	SetRootComponent(PortalBounds);
+	SetHidden(true);
+}
+
+void AMirrorPortal::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (const UGameInstance* GameInstance = GetGameInstance())
+	{
+		if (UMirrorSubsystem* MirrorSubsystem = GameInstance->GetSubsystem<UMirrorSubsystem>())
+		{
+			MirrorSubsystem->RegisterPortal(this);
+		}
+	}
+}
+
+void AMirrorPortal::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (const UGameInstance* GameInstance = GetGameInstance())
+	{
+		if (UMirrorSubsystem* MirrorSubsystem = GameInstance->GetSubsystem<UMirrorSubsystem>())
+		{
+			MirrorSubsystem->UnregisterPortal(this);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "MirrorPortal.generated.h"
+
+class AMirrorZoneVolume;
+class UBoxComponent;
+
+// An opening between two mirror zones, like a door or a window. A zone is visible from its neighbour while the portal is in view.
+UCLASS()
+class UE5_MIRRORS_API AMirrorPortal : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AMirrorPortal();
+
+	// Size of the opening.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TObjectPtr<UBoxComponent> PortalBounds;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	TObjectPtr<AMirrorZoneVolume> ZoneA;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	TObjectPtr<AMirrorZoneVolume> ZoneB;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+};
@@ -0,0 +1,390 @@
+#include "MirrorPrimitiveIndex.h"
+#include "MirrorStats.h"
+#include "EngineUtils.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+
+FMirrorPrimitiveIndex::~FMirrorPrimitiveIndex()
+{
+	Reset();
+}
+
+void FMirrorPrimitiveIndex::Build(UWorld* World)
+{
+	Reset();
+	if (!World)
+	{
+		return;
+	}
+
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		AddActor(*It);
+	}
+
+	// Nothing was cached against the previous contents, so there is no point in remembering the initial inserts.
+	ChangeRecords.Reset();
+	OldestTrackedRevision = Revision;
+}
+
+void FMirrorPrimitiveIndex::Reset()
+{
+	for (const FEntry& Entry : Entries)
+	{
+		if (UPrimitiveComponent* Primitive = Entry.Primitive.Get())
+		{
+			Primitive->TransformUpdated.Remove(Entry.TransformUpdatedHandle);
+		}
+	}
+
+	Entries.Empty();
+	EntryIndices.Empty();
+	StaticTree.Reset();
+	MovableTree.Reset();
+	DirtyEntries.Reset();
+	AlwaysDirtyEntries.Reset();
+	StaleEntries.Reset();
+	PendingAddedActors.Reset();
+	PendingRemovedPrimitives.Reset();
+	TrackedActors.Empty();
+	RescanCursor = 0;
+	ChangeRecords.Reset();
+
+	Revision++;
+	OldestTrackedRevision = Revision;
+}
+
+void FMirrorPrimitiveIndex::AddActor(const AActor* Actor)
+{
+	if (!Actor)
+	{
+		return;
+	}
+
+	TrackedActors.Add(Actor);
+	Actor->ForEachComponent<UPrimitiveComponent>(false, [this](UPrimitiveComponent* Primitive)
+	{
+		AddPrimitive(Primitive);
+	});
+}
+
+void FMirrorPrimitiveIndex::RemoveActor(const AActor* Actor)
+{
+	if (!Actor)
+	{
+		return;
+	}
+
+	TrackedActors.Remove(Actor);
+	Actor->ForEachComponent<UPrimitiveComponent>(false, [this](UPrimitiveComponent* Primitive)
+	{
+		if (const int32* EntryIndex = EntryIndices.Find(Primitive))
+		{
+			RemoveEntry(*EntryIndex);
+		}
+	});
+}
+
+void FMirrorPrimitiveIndex::AddLevel(const ULevel* Level)
+{
+	if (Level)
+	{
+		for (const AActor* Actor : Level->Actors)
+		{
+			AddActor(Actor);
+		}
+	}
+}
+
+void FMirrorPrimitiveIndex::RemoveLevel(const ULevel* Level)
+{
+	if (Level)
+	{
+		for (const AActor* Actor : Level->Actors)
+		{
+			RemoveActor(Actor);
+		}
+	}
+}
+
+void FMirrorPrimitiveIndex::QueueAddActor(const AActor* Actor)
+{
+	if (Actor)
+	{
+		PendingAddedActors.Add(Actor);
+	}
+}
+
+void FMirrorPrimitiveIndex::QueueRemoveActor(const AActor* Actor)
+{
+	if (!Actor)
+	{
+		return;
+	}
+
+	// The components may be gone by the next update, so remember their keys now.
+	Actor->ForEachComponent<UPrimitiveComponent>(false, [this](UPrimitiveComponent* Primitive)
+	{
+		PendingRemovedPrimitives.Add(Primitive);
+	});
+}
+
+void FMirrorPrimitiveIndex::Update()
+{
+	for (const TObjectKey<UPrimitiveComponent>& Key : PendingRemovedPrimitives)
+	{
+		if (const int32* EntryIndex = EntryIndices.Find(Key))
+		{
+			RemoveEntry(*EntryIndex);
+		}
+	}
+	PendingRemovedPrimitives.Reset();
+
+	// An actor destroyed in the same frame it was spawned is no longer valid here and is skipped.
+	for (const TWeakObjectPtr<const AActor>& Actor : PendingAddedActors)
+	{
+		AddActor(Actor.Get());
+	}
+	PendingAddedActors.Reset();
+
+	for (const int32 EntryIndex : StaleEntries)
+	{
+		if (Entries.IsValidIndex(EntryIndex) && !Entries[EntryIndex].Primitive.IsValid())
+		{
+			RemoveEntry(EntryIndex);
+		}
+	}
+	StaleEntries.Reset();
+
+	for (const int32 EntryIndex : DirtyEntries)
+	{
+		if (Entries.IsValidIndex(EntryIndex))
+		{
+			UpdateEntry(EntryIndex);
+		}
+	}
+	DirtyEntries.Reset();
+
+	for (const int32 EntryIndex : AlwaysDirtyEntries)
+	{
+		UpdateEntry(EntryIndex);
+	}
+
+	RescanActors();
+}
+
+void FMirrorPrimitiveIndex::QueryFrustum(TConstArrayView<FPlane> Planes, const bool bUseBoxes,
+                                         TArray<UPrimitiveComponent*>& OutPrimitives, const bool bMovableOnly)
+{
+	MIRROR_SCOPE_CYCLE_COUNTER(IndexQuery);
+
+	TArray<FVector4f, TInlineAllocator<8>> TreePlanes;
+	for (const FPlane& Plane : Planes)
+	{
+		TreePlanes.Add(FVector4f(Plane.X, Plane.Y, Plane.Z, Plane.W));
+	}
+
+	QueryResults.Reset();
+	MovableTree.QueryFrustum(TreePlanes, QueryResults);
+	if (!bMovableOnly)
+	{
+		StaticTree.QueryFrustum(TreePlanes, QueryResults);
+	}
+
+	// The tree only knows the enlarged leaf boxes, so test the actual bounds once more, all candidates in one batch.
+	QueryBounds.Reset();
+	for (const int32 EntryIndex : QueryResults)
+	{
+		QueryBounds.Add(Entries[EntryIndex].Bounds);
+	}
+
+	FMirrorFrustumCulling::TestBounds(QueryBounds, Planes, bUseBoxes, QueryVisibility);
+
+	for (int32 Index = 0; Index < QueryResults.Num(); Index++)
+	{
+		if (!QueryVisibility[Index])
+		{
+			continue;
+		}
+
+		const int32 EntryIndex = QueryResults[Index];
+		if (UPrimitiveComponent* Primitive = Entries[EntryIndex].Primitive.Get())
+		{
+			OutPrimitives.Add(Primitive);
+		}
+		else
+		{
+			StaleEntries.Add(EntryIndex);
+		}
+	}
+}
+
+bool FMirrorPrimitiveIndex::HasChangedSince(const uint32 SinceRevision, const FBox& Region) const
+{
+	if (SinceRevision < OldestTrackedRevision)
+	{
+		return true;
+	}
+
+	const FVector3f Min(Region.Min);
+	const FVector3f Max(Region.Max);
+	for (int32 Index = ChangeRecords.Num() - 1; Index >= 0 && ChangeRecords[Index].Revision > SinceRevision; --Index)
+	{
+		const FChangeRecord& Record = ChangeRecords[Index];
+		if (Record.Min.X <= Max.X && Record.Max.X >= Min.X &&
+			Record.Min.Y <= Max.Y && Record.Max.Y >= Min.Y &&
+			Record.Min.Z <= Max.Z && Record.Max.Z >= Min.Z)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FMirrorPrimitiveIndex::AddPrimitive(UPrimitiveComponent* Primitive)
+{
+	if (!Primitive || !Primitive->IsRegistered() || EntryIndices.Contains(Primitive))
+	{
+		return;
+	}
+
+	const int32 EntryIndex = Entries.Add(FEntry());
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.Primitive = Primitive;
+	Entry.Key = Primitive;
+	Entry.Bounds = Primitive->Bounds.GetBox();
+	Entry.bIsMovable = Primitive->Mobility == EComponentMobility::Movable;
+	Entry.LeafId = GetTree(Entry).Insert(Entry.Bounds, EntryIndex);
+
+	// Static and stationary primitives can't move at runtime, so only movable ones need to be watched.
+	if (Entry.bIsMovable)
+	{
+		Entry.TransformUpdatedHandle = Primitive->TransformUpdated.AddRaw(
+			this, &FMirrorPrimitiveIndex::OnTransformUpdated, EntryIndex);
+
+		if (Primitive->IsA<USkinnedMeshComponent>())
+		{
+			Entry.bIsAlwaysDirty = true;
+			AlwaysDirtyEntries.Add(EntryIndex);
+		}
+	}
+
+	EntryIndices.Add(Primitive, EntryIndex);
+	RecordChange(Entry.Bounds);
+}
+
+void FMirrorPrimitiveIndex::RescanActors()
+{
+	const int32 MaxIndex = TrackedActors.GetMaxIndex();
+	for (int32 Scanned = 0; Scanned < FMath::Min(ActorsRescannedPerUpdate, MaxIndex); Scanned++)
+	{
+		RescanCursor = RescanCursor < MaxIndex ? RescanCursor : 0;
+		const FSetElementId Id = FSetElementId::FromInteger(RescanCursor++);
+		if (!TrackedActors.IsValidId(Id))
+		{
+			continue;
+		}
+
+		// Destroyed actors had their primitives removed already.
+		if (const AActor* Actor = TrackedActors[Id].Get())
+		{
+			RescanActor(Actor);
+		}
+		else
+		{
+			TrackedActors.Remove(Id);
+		}
+	}
+}
+
+void FMirrorPrimitiveIndex::RescanActor(const AActor* Actor)
+{
+	Actor->ForEachComponent<UPrimitiveComponent>(false, [this](UPrimitiveComponent* Primitive)
+	{
+		const int32* FoundEntryIndex = EntryIndices.Find(Primitive);
+		if (!FoundEntryIndex)
+		{
+			AddPrimitive(Primitive);
+			return;
+		}
+
+		// Unregistered primitives are dropped, and ones that changed mobility are moved to the other tree.
+		const int32 EntryIndex = *FoundEntryIndex;
+		const bool bIsMovable = Primitive->Mobility == EComponentMobility::Movable;
+		if (!Primitive->IsRegistered() || Entries[EntryIndex].bIsMovable != bIsMovable)
+		{
+			RemoveEntry(EntryIndex);
+			AddPrimitive(Primitive);
+		}
+	});
+}
+
+void FMirrorPrimitiveIndex::RemoveEntry(const int32 EntryIndex)
+{
+	const FEntry& Entry = Entries[EntryIndex];
+	if (UPrimitiveComponent* Primitive = Entry.Primitive.Get(true))
+	{
+		Primitive->TransformUpdated.Remove(Entry.TransformUpdatedHandle);
+	}
+
+	if (Entry.bIsAlwaysDirty)
+	{
+		AlwaysDirtyEntries.RemoveSingleSwap(EntryIndex, false);
+	}
+
+	GetTree(Entry).Remove(Entry.LeafId);
+	RecordChange(Entry.Bounds);
+	EntryIndices.Remove(Entry.Key);
+	Entries.RemoveAt(EntryIndex);
+}
+
+void FMirrorPrimitiveIndex::UpdateEntry(const int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.bIsDirty = false;
+
+	const UPrimitiveComponent* Primitive = Entry.Primitive.Get();
+	if (!Primitive)
+	{
+		StaleEntries.Add(EntryIndex);
+		return;
+	}
+
+	const FBox NewBounds = Primitive->Bounds.GetBox();
+	if (NewBounds == Entry.Bounds)
+	{
+		return;
+	}
+
+	RecordChange(Entry.Bounds + NewBounds);
+	Entry.Bounds = NewBounds;
+	GetTree(Entry).Move(Entry.LeafId, NewBounds);
+}
+
+void FMirrorPrimitiveIndex::RecordChange(const FBox& Region)
+{
+	Revision++;
+
+	if (ChangeRecords.Num() >= MaxChangeRecords)
+	{
+		const int32 NumDropped = MaxChangeRecords / 2;
+		OldestTrackedRevision = ChangeRecords[NumDropped - 1].Revision;
+		ChangeRecords.RemoveAt(0, NumDropped, false);
+	}
+
+	ChangeRecords.Add({Revision, FVector3f(Region.Min), FVector3f(Region.Max)});
+}
+
+void FMirrorPrimitiveIndex::OnTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags,
+                                               ETeleportType Teleport, const int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	if (!Entry.bIsDirty)
+	{
+		Entry.bIsDirty = true;
+		DirtyEntries.Add(EntryIndex);
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MirrorBoundsTree.h"
+#include "MirrorFrustumCulling.h"
+#include "Components/SceneComponent.h"
+#include "UObject/ObjectKey.h"
+
+class UPrimitiveComponent;
+
+// Bounds of every primitive in a world, kept in a bounds tree so mirror culling can query it with frustum planes directly.
+// Movable primitives are tracked through their transform updates. Moves, spawned and destroyed actors are collected during
+// the frame and applied in Update. A query may run on another thread while they are collected. Any other call has to wait for it.
+// Components registered after their actor was added, or changing mobility, are picked up by rescanning a few actors per update.
+class UE5_MIRRORS_API FMirrorPrimitiveIndex
+{
+public:
+	~FMirrorPrimitiveIndex();
+
+	void Build(UWorld* World);
+	void Reset();
+
+	void AddActor(const AActor* Actor);
+	void RemoveActor(const AActor* Actor);
+	void AddLevel(const ULevel* Level);
+	void RemoveLevel(const ULevel* Level);
+
+	// Collects an actor to add or remove in the next Update. Safe to call while a query runs.
+	void QueueAddActor(const AActor* Actor);
+	void QueueRemoveActor(const AActor* Actor);
+
+	// Applies the moves collected since the last update to the tree.
+	void Update();
+
+	// Appends every primitive whose bounds are not completely behind one of the planes. Planes face inwards.
+	// Without bUseBoxes the primitives are tested with the sphere around their box, which is cheaper but culls less.
+	// With bMovableOnly static and stationary primitives are skipped without being tested, for callers that already know which of them are visible.
+	void QueryFrustum(TConstArrayView<FPlane> Planes, bool bUseBoxes, TArray<UPrimitiveComponent*>& OutPrimitives,
+	                  bool bMovableOnly = false);
+
+	// Incremented for every primitive that was added, removed or moved.
+	uint32 GetRevision() const { return Revision; }
+
+	// True if any primitive changed inside the region after the given revision.
+	bool HasChangedSince(uint32 SinceRevision, const FBox& Region) const;
+
+	int32 GetNumPrimitives() const { return Entries.Num(); }
+
+private:
+	struct FEntry
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Primitive;
+		TObjectKey<UPrimitiveComponent> Key;
+		FBox Bounds;
+		FDelegateHandle TransformUpdatedHandle;
+		int32 LeafId = INDEX_NONE;
+		bool bIsMovable = false;
+		bool bIsDirty = false;
+		bool bIsAlwaysDirty = false;
+	};
+
+	struct FChangeRecord
+	{
+		uint32 Revision;
+		FVector3f Min;
+		FVector3f Max;
+	};
+
+	// Older changes are forgotten and caches made before them are treated as invalid.
+	static constexpr int32 MaxChangeRecords = 8192;
+
+	// Actors rescanned per update. With N tracked actors, each is rescanned every N / ActorsRescannedPerUpdate updates.
+	static constexpr int32 ActorsRescannedPerUpdate = 64;
+
+	void AddPrimitive(UPrimitiveComponent* Primitive);
+	void RescanActors();
+	void RescanActor(const AActor* Actor);
+	void RemoveEntry(int32 EntryIndex);
+	void UpdateEntry(int32 EntryIndex);
+	void RecordChange(const FBox& Region);
+	void OnTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags,
+	                        ETeleportType Teleport, int32 EntryIndex);
+
+	FMirrorBoundsTree& GetTree(const FEntry& Entry) { return Entry.bIsMovable ? MovableTree : StaticTree; }
+
+	// Movable primitives have their own tree, so they can be queried on their own.
+	FMirrorBoundsTree StaticTree;
+	FMirrorBoundsTree MovableTree;
+	TSparseArray<FEntry> Entries;
+	TMap<TObjectKey<UPrimitiveComponent>, int32> EntryIndices;
+
+	// Entries that moved since the last update.
+	TArray<int32> DirtyEntries;
+
+	// Skinned meshes change their bounds without moving, so they are refreshed every update.
+	TArray<int32> AlwaysDirtyEntries;
+
+	// Entries whose primitive was found destroyed during a query.
+	TArray<int32> StaleEntries;
+
+	// Actors spawned and primitives of actors destroyed since the last update.
+	TArray<TWeakObjectPtr<const AActor>> PendingAddedActors;
+	TArray<TObjectKey<UPrimitiveComponent>> PendingRemovedPrimitives;
+
+	// Actors whose primitives were added, rescanned in turn from RescanCursor on.
+	TSet<TWeakObjectPtr<const AActor>> TrackedActors;
+	int32 RescanCursor = 0;
+
+	TArray<FChangeRecord> ChangeRecords;
+	uint32 Revision = 0;
+	uint32 OldestTrackedRevision = 0;
+
+	// Scratch buffers for queries.
+	TArray<int32> QueryResults;
+	FMirrorCullingBounds QueryBounds;
+	TArray<uint8> QueryVisibility;
+};
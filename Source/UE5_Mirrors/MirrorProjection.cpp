@@ -0,0 +1,209 @@
+#include "MirrorProjection.h"
+#include "Components/PrimitiveComponent.h"
+#include "Math/PerspectiveMatrix.h"
+
+bool FMirrorProjection::CalcOffAxisProjection(const FTransform& ViewTransform, const FVector (&Corners)[4],
+                                              FMatrix& OutProjection)
+{
+	float Left = MAX_flt;
+	float Right = -MAX_flt;
+	float Bottom = MAX_flt;
+	float Top = -MAX_flt;
+
+	for (const FVector& Corner : Corners)
+	{
+		// Unreal's view space has X right, Y up and Z forward, which is the view transform's Y, Z and X.
+		const FVector LocalCorner = ViewTransform.InverseTransformPositionNoScale(Corner);
+		if (LocalCorner.X <= KINDA_SMALL_NUMBER)
+		{
+			return false;
+		}
+
+		const float SlopeX = LocalCorner.Y / LocalCorner.X;
+		const float SlopeY = LocalCorner.Z / LocalCorner.X;
+		Left = FMath::Min(Left, SlopeX);
+		Right = FMath::Max(Right, SlopeX);
+		Bottom = FMath::Min(Bottom, SlopeY);
+		Top = FMath::Max(Top, SlopeY);
+	}
+
+	if (Right - Left <= KINDA_SMALL_NUMBER || Top - Bottom <= KINDA_SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	// Same layout as FReversedZPerspectiveMatrix with an infinite far plane, with the center shifted to the mirror.
+	OutProjection = FMatrix(
+		FPlane(2 / (Right - Left), 0, 0, 0),
+		FPlane(0, 2 / (Top - Bottom), 0, 0),
+		FPlane(-(Right + Left) / (Right - Left), -(Top + Bottom) / (Top - Bottom), 0, 1),
+		FPlane(0, 0, GNearClippingPlane, 0));
+
+	return true;
+}
+
+float FMirrorProjection::CalcMirrorAspectRatio(const UPrimitiveComponent* MirrorMesh)
+{
+	FVector Min;
+	FVector Max;
+	MirrorMesh->GetLocalBounds(Min, Max);
+
+	const FVector Scale = MirrorMesh->GetComponentScale().GetAbs();
+	const float Width = (Max.Y - Min.Y) * Scale.Y;
+	const float Height = (Max.Z - Min.Z) * Scale.Z;
+	return Height > KINDA_SMALL_NUMBER ? Width / Height : 1;
+}
+
+FVector2D FMirrorProjection::FitToAspectRatio(const float NumPixels, const float AspectRatio)
+{
+	const float Height = FMath::Sqrt(NumPixels / FMath::Max(AspectRatio, KINDA_SMALL_NUMBER));
+	return FVector2D(FMath::Max(Height * AspectRatio, 1.f), FMath::Max(Height, 1.f));
+}
+
+FMatrix FMirrorProjection::CalcPerspectiveProjection(const float FovDegrees, const float AspectRatio)
+{
+	const float HalfFov = FMath::DegreesToRadians(FovDegrees) / 2;
+	const float SafeAspectRatio = FMath::Max(AspectRatio, KINDA_SMALL_NUMBER);
+	if (SafeAspectRatio >= 1)
+	{
+		return FReversedZPerspectiveMatrix(HalfFov, HalfFov, 1, SafeAspectRatio, GNearClippingPlane, GNearClippingPlane);
+	}
+
+	return FReversedZPerspectiveMatrix(HalfFov, HalfFov, 1 / SafeAspectRatio, 1, GNearClippingPlane, GNearClippingPlane);
+}
+
+FBox2D FMirrorProjection::CalcVisibleRegion(const FTransform& ViewerTransform, const FVector2D& ViewerFovDegrees,
+                                            const FVector (&Corners)[4], const FTransform& CaptureTransform,
+                                            const FMatrix& CaptureProjection)
+{
+	const float TanX = FMath::Tan(FMath::DegreesToRadians(ViewerFovDegrees.X) / 2);
+	const float TanY = FMath::Tan(FMath::DegreesToRadians(ViewerFovDegrees.Y) / 2);
+
+	// Viewer space is X forward, Y right and Z up. The planes face into the frustum.
+	const FPlane FrustumPlanes[5] = {
+		FPlane(1, 0, 0, GNearClippingPlane),
+		FPlane(TanX, -1, 0, 0),
+		FPlane(TanX, 1, 0, 0),
+		FPlane(TanY, 0, -1, 0),
+		FPlane(TanY, 0, 1, 0)
+	};
+
+	TArray<FVector, TInlineAllocator<16>> Polygon;
+	for (const FVector& Corner : Corners)
+	{
+		Polygon.Add(ViewerTransform.InverseTransformPositionNoScale(Corner));
+	}
+
+	// Clip the mirror quad against each plane in turn.
+	TArray<FVector, TInlineAllocator<16>> ClippedPolygon;
+	for (const FPlane& Plane : FrustumPlanes)
+	{
+		ClippedPolygon.Reset();
+		for (int32 Index = 0; Index < Polygon.Num(); Index++)
+		{
+			const FVector& Current = Polygon[Index];
+			const FVector& Next = Polygon[(Index + 1) % Polygon.Num()];
+			const float CurrentDistance = Plane.PlaneDot(Current);
+			const float NextDistance = Plane.PlaneDot(Next);
+
+			if (CurrentDistance >= 0)
+			{
+				ClippedPolygon.Add(Current);
+			}
+
+			if ((CurrentDistance >= 0) != (NextDistance >= 0))
+			{
+				ClippedPolygon.Add(FMath::Lerp(Current, Next, CurrentDistance / (CurrentDistance - NextDistance)));
+			}
+		}
+
+		Swap(Polygon, ClippedPolygon);
+		if (Polygon.Num() == 0)
+		{
+			return FBox2D(ForceInit);
+		}
+	}
+
+	FBox2D Region(ForceInit);
+	for (const FVector& Point : Polygon)
+	{
+		const FVector CapturePoint = CaptureTransform.InverseTransformPositionNoScale(
+			ViewerTransform.TransformPositionNoScale(Point));
+
+		// Unreal's view space has X right, Y up and Z forward, which is the capture transform's Y, Z and X.
+		const FVector4 ClipPoint = CaptureProjection.TransformFVector4(
+			FVector4(CapturePoint.Y, CapturePoint.Z, CapturePoint.X, 1));
+		if (ClipPoint.W <= KINDA_SMALL_NUMBER)
+		{
+			return FBox2D(FVector2D::ZeroVector, FVector2D::UnitVector);
+		}
+
+		Region += FVector2D((ClipPoint.X / ClipPoint.W + 1) / 2, (1 - ClipPoint.Y / ClipPoint.W) / 2);
+	}
+
+	return Region;
+}
+
+FBox2D FMirrorProjection::SnapRegion(const FBox2D& Region, const float Step)
+{
+	if (!Region.bIsValid)
+	{
+		return Region;
+	}
+
+	FBox2D Snapped = Region;
+	if (Step > 0)
+	{
+		Snapped.Min.X = FMath::FloorToFloat(Region.Min.X / Step) * Step;
+		Snapped.Min.Y = FMath::FloorToFloat(Region.Min.Y / Step) * Step;
+		Snapped.Max.X = FMath::CeilToFloat(Region.Max.X / Step) * Step;
+		Snapped.Max.Y = FMath::CeilToFloat(Region.Max.Y / Step) * Step;
+	}
+
+	Snapped.Min = Snapped.Min.ClampAxes(0, 1);
+	Snapped.Max = Snapped.Max.ClampAxes(0, 1);
+
+	// A region squeezed to nothing by the clamp only happens on precision issues at the capture's edge.
+	const float MinSize = FMath::Max(Step, KINDA_SMALL_NUMBER);
+	if (Snapped.Max.X - Snapped.Min.X < MinSize || Snapped.Max.Y - Snapped.Min.Y < MinSize)
+	{
+		return FBox2D(FVector2D::ZeroVector, FVector2D::UnitVector);
+	}
+
+	return Snapped;
+}
+
+FBox2D FMirrorProjection::CoverRegion(const FBox2D& Current, const FBox2D& Region)
+{
+	const FVector2D Size = Current.GetSize();
+	FVector2D Min;
+	for (int32 Axis = 0; Axis < 2; Axis++)
+	{
+		Min[Axis] = FMath::Clamp(Current.Min[Axis], Region.Max[Axis] - Size[Axis], Region.Min[Axis]);
+		Min[Axis] = FMath::Clamp(Min[Axis], 0.0, 1.0 - Size[Axis]);
+	}
+
+	return FBox2D(Min, Min + Size);
+}
+
+FMatrix FMirrorProjection::CropProjection(const FMatrix& Projection, const FBox2D& Region)
+{
+	const FVector2D Size = Region.GetSize();
+	if (Size.X <= KINDA_SMALL_NUMBER || Size.Y <= KINDA_SMALL_NUMBER)
+	{
+		return Projection;
+	}
+
+	// Moves the region's center to the middle of clip space and stretches it over the whole capture. Clip space Y points up, UV space V down.
+	const float ScaleX = 1 / Size.X;
+	const float ScaleY = 1 / Size.Y;
+	const float CenterX = Region.Min.X + Region.Max.X - 1;
+	const float CenterY = 1 - Region.Min.Y - Region.Max.Y;
+	const FMatrix Crop(
+		FPlane(ScaleX, 0, 0, 0),
+		FPlane(0, ScaleY, 0, 0),
+		FPlane(0, 0, 1, 0),
+		FPlane(-CenterX * ScaleX, -CenterY * ScaleY, 0, 1));
+
+	return Projection * Crop;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Off-axis projection through the corners of a mirror, so a capture only renders what the mirror shows.
+class UE5_MIRRORS_API FMirrorProjection
+{
+public:
+	// Projection for a view looking along the mirror's forward vector from behind it, with the frustum going through the corners.
+	// ViewTransform has the mirror's rotation and the mirrored eye's location. Returns false if a corner is not in front of the view.
+	static bool CalcOffAxisProjection(const FTransform& ViewTransform, const FVector (&Corners)[4], FMatrix& OutProjection);
+
+	// Width over height of the mirror surface, which is the shape of the off-axis view when looking at the mirror head-on.
+	static float CalcMirrorAspectRatio(const UPrimitiveComponent* MirrorMesh);
+
+	// Size with the given number of pixels and aspect ratio.
+	static FVector2D FitToAspectRatio(float NumPixels, float AspectRatio);
+
+	// The projection a scene capture builds from its field of view, with the field of view applied to the longer side.
+	static FMatrix CalcPerspectiveProjection(float FovDegrees, float AspectRatio);
+
+	// Bounds in the capture's UV space of the part of the mirror inside the viewer's frustum. Invalid if no part of it is.
+	static FBox2D CalcVisibleRegion(const FTransform& ViewerTransform, const FVector2D& ViewerFovDegrees,
+	                                const FVector (&Corners)[4], const FTransform& CaptureTransform,
+	                                const FMatrix& CaptureProjection);
+
+	// Grows the region outwards to multiples of Step, clamped to the capture.
+	static FBox2D SnapRegion(const FBox2D& Region, float Step);
+
+	// Moves Current as little as possible to cover Region, keeping its size. Current has to be at least as large as Region.
+	static FBox2D CoverRegion(const FBox2D& Current, const FBox2D& Region);
+
+	// Narrows the projection to a region of its UV space, so the whole render target shows only that region.
+	static FMatrix CropProjection(const FMatrix& Projection, const FBox2D& Region);
+};
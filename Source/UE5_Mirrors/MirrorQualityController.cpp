@@ -0,0 +1,62 @@
+#include "MirrorQualityController.h"
+
+void FMirrorQualityController::AddFrameTime(const float GameThreadMs, const float RenderThreadMs, const float GpuMs)
+{
+	const float FrameTimeMs = FMath::Max3(GameThreadMs, RenderThreadMs, GpuMs);
+	if (FrameTimeMs <= 0)
+	{
+		return;
+	}
+
+	// Smoothing is applied in Update, so a frame time added between updates just replaces the pending one.
+	PendingFrameTimeMs = FrameTimeMs;
+	bHasPendingFrameTime = true;
+}
+
+float FMirrorQualityController::Update(const FMirrorQualityControllerSettings& Settings)
+{
+	if (!bHasPendingFrameTime)
+	{
+		return QualityScale;
+	}
+
+	SmoothedFrameTimeMs = bHasFrameTime
+		                      ? FMath::Lerp(SmoothedFrameTimeMs, PendingFrameTimeMs,
+		                                    FMath::Clamp(Settings.Smoothing, 0.f, 1.f))
+		                      : PendingFrameTimeMs;
+	bHasFrameTime = true;
+	bHasPendingFrameTime = false;
+
+	const float Ratio = SmoothedFrameTimeMs / FMath::Max(Settings.TargetFrameTimeMs, KINDA_SMALL_NUMBER);
+	if (FMath::Abs(Ratio - 1) <= Settings.Deadband)
+	{
+		return QualityScale;
+	}
+
+	// Mirror cost grows roughly with the captured pixels, which is the quality squared.
+	const float MinScale = FMath::Clamp(Settings.MinQualityScale, 0.f, 1.f);
+	const float IdealScale = FMath::Clamp(QualityScale / FMath::Sqrt(Ratio), MinScale, 1.f);
+	QualityScale = FMath::Clamp(FMath::Lerp(QualityScale, IdealScale, FMath::Clamp(Settings.Gain, 0.f, 1.f)), MinScale,
+	                            1.f);
+
+	// The lerp only approaches full quality, so snap once it is close.
+	if (IdealScale == 1 && QualityScale > 0.99f)
+	{
+		QualityScale = 1;
+	}
+
+	return QualityScale;
+}
+
+void FMirrorQualityController::Reset()
+{
+	SmoothedFrameTimeMs = 0;
+	QualityScale = 1;
+	bHasFrameTime = false;
+	bHasPendingFrameTime = false;
+}
+
+float FMirrorQualityController::GetScaleForPriority(const float QualityScale, const float Priority)
+{
+	return FMath::Pow(QualityScale, 1 / FMath::Max(Priority, 0.1f));
+}
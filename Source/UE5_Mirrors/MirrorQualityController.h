@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FMirrorQualityControllerSettings
+{
+	// Frame time the controller tries to hold, in milliseconds.
+	float TargetFrameTimeMs = 16.6f;
+
+	// Frame times within this fraction around the target don't change the quality.
+	float Deadband = 0.05f;
+
+	// How much of the gap between the current and the ideal quality is closed per update.
+	float Gain = 0.1f;
+
+	// Weight of the newest frame time in the smoothed frame time.
+	float Smoothing = 0.1f;
+
+	// Quality scale is kept within [MinQualityScale, 1].
+	float MinQualityScale = 0.25f;
+};
+
+// Turns recent frame times into a quality scale for all mirrors of a subsystem. Frame times are fed in from the outside,
+// so the controller can be driven by synthetic timings as well as the engine's.
+class UE5_MIRRORS_API FMirrorQualityController
+{
+public:
+	// The slowest of the game thread, render thread and GPU decides the frame time.
+	void AddFrameTime(float GameThreadMs, float RenderThreadMs, float GpuMs);
+
+	// Moves the quality scale towards the value that would bring the smoothed frame time to the target. Returns the new scale.
+	float Update(const FMirrorQualityControllerSettings& Settings);
+
+	void Reset();
+
+	float GetQualityScale() const { return QualityScale; }
+	float GetSmoothedFrameTimeMs() const { return SmoothedFrameTimeMs; }
+
+	// Higher priority mirrors lose less quality. Priority 1 gets the plain scale, 2 its square root.
+	static float GetScaleForPriority(float QualityScale, float Priority);
+
+private:
+	float PendingFrameTimeMs = 0;
+	float SmoothedFrameTimeMs = 0;
+	float QualityScale = 1;
+	bool bHasFrameTime = false;
+	bool bHasPendingFrameTime = false;
+};
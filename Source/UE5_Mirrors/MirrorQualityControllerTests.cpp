@@ -0,0 +1,49 @@
+#include "MirrorQualityController.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMirrorQualityControllerConvergenceTest, "UE5_Mirrors.QualityController.Convergence",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMirrorQualityControllerConvergenceTest::RunTest(const FString& Parameters)
+{
+	const FMirrorQualityControllerSettings Settings;
+	FMirrorQualityController Controller;
+	bool bStayedInRange = true;
+
+	// Feeds the frame time for the current scale into the controller for a number of updates.
+	auto Run = [&](const int32 NumUpdates, TFunctionRef<float(float)> FrameTimeForScale)
+	{
+		for (int32 Update = 0; Update < NumUpdates; Update++)
+		{
+			Controller.AddFrameTime(FrameTimeForScale(Controller.GetQualityScale()), 0, 0);
+			const float Scale = Controller.Update(Settings);
+			bStayedInRange &= Scale >= Settings.MinQualityScale && Scale <= 1;
+		}
+	};
+
+	// A scene over budget at full quality, with the mirror cost growing with the captured pixels.
+	auto SceneFrameTime = [](const float Scale) { return 10 + 12 * Scale * Scale; };
+	Run(600, SceneFrameTime);
+	const float SettledScale = Controller.GetQualityScale();
+	const float SettledRatio = SceneFrameTime(SettledScale) / Settings.TargetFrameTimeMs;
+	TestTrue(TEXT("Frame time settles inside the deadband"), FMath::Abs(SettledRatio - 1) <= Settings.Deadband);
+	TestTrue(TEXT("Scale went down to get there"), SettledScale < 1);
+
+	Run(100, SceneFrameTime);
+	TestEqual(TEXT("Scale stays put once settled"), Controller.GetQualityScale(), SettledScale);
+
+	// Frames that stay over budget whatever the scale drive it to the minimum, but not below.
+	Run(300, [](float) { return 40.f; });
+	TestEqual(TEXT("Constant over budget reaches the minimum scale"), Controller.GetQualityScale(), Settings.MinQualityScale);
+
+	// Frames well under budget bring it all the way back.
+	Run(300, [](float) { return 8.f; });
+	TestEqual(TEXT("Constant under budget returns to full quality"), Controller.GetQualityScale(), 1.f);
+
+	TestTrue(TEXT("Scale stays within [MinQualityScale, 1]"), bStayedInRange);
+	return true;
+}
+
+#endif
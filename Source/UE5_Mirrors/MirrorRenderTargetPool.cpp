@@ -0,0 +1,59 @@
+#include "MirrorRenderTargetPool.h"
+
+UTextureRenderTarget2D* FMirrorRenderTargetPool::Acquire(UObject* Outer, int32 Width, int32 Height,
+                                                         const ETextureRenderTargetFormat Format)
+{
+	Width = FMath::Max(Width, 1);
+	Height = FMath::Max(Height, 1);
+
+	const int32 FreeIndex = FreeTargets.IndexOfByPredicate([Width, Height, Format](const UTextureRenderTarget2D* Target)
+	{
+		return Target && Target->SizeX == Width && Target->SizeY == Height && Target->RenderTargetFormat == Format;
+	});
+
+	if (FreeIndex != INDEX_NONE)
+	{
+		UTextureRenderTarget2D* RenderTarget = FreeTargets[FreeIndex];
+		FreeTargets.RemoveAt(FreeIndex);
+		return RenderTarget;
+	}
+
+	// Same setup as UKismetRenderingLibrary::CreateRenderTarget2D, but owned by the pool's owner instead of the calling mirror.
+	UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>(Outer);
+	RenderTarget->RenderTargetFormat = Format;
+	RenderTarget->ClearColor = FLinearColor::Black;
+	RenderTarget->bAutoGenerateMips = false;
+	RenderTarget->InitAutoFormat(Width, Height);
+	RenderTarget->UpdateResourceImmediate(true);
+	return RenderTarget;
+}
+
+void FMirrorRenderTargetPool::Release(UTextureRenderTarget2D* RenderTarget)
+{
+	if (!RenderTarget)
+	{
+		return;
+	}
+
+	FreeTargets.AddUnique(RenderTarget);
+	while (FreeTargets.Num() > FMath::Max(MaxFreeTargets, 0))
+	{
+		FreeTargets.RemoveAt(0);
+	}
+}
+
+SIZE_T FMirrorRenderTargetPool::GetFreeMemory() const
+{
+	SIZE_T Size = 0;
+	for (const UTextureRenderTarget2D* Target : FreeTargets)
+	{
+		Size += Target ? Target->CalcTextureMemorySizeEnum(TMC_ResidentMips) : 0;
+	}
+
+	return Size;
+}
+
+void FMirrorRenderTargetPool::Empty()
+{
+	FreeTargets.Empty();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "MirrorRenderTargetPool.generated.h"
+
+// Recycles mirror render targets by size and format, so resolution changes don't allocate new targets and leave the old ones to garbage collection.
+USTRUCT()
+struct UE5_MIRRORS_API FMirrorRenderTargetPool
+{
+	GENERATED_BODY()
+
+	// Returns a free target of exactly this size and format, or creates a new one owned by Outer.
+	UTextureRenderTarget2D* Acquire(UObject* Outer, int32 Width, int32 Height,
+	                                ETextureRenderTargetFormat Format = RTF_RGBA16f);
+
+	// Hands a target back to the pool. Null is ignored.
+	void Release(UTextureRenderTarget2D* RenderTarget);
+
+	void Empty();
+
+	int32 GetNumFree() const { return FreeTargets.Num(); }
+
+	SIZE_T GetFreeMemory() const;
+
+	// Free targets beyond this number are dropped, oldest first.
+	int32 MaxFreeTargets = 8;
+
+private:
+	UPROPERTY()
+	TArray<TObjectPtr<UTextureRenderTarget2D>> FreeTargets;
+};
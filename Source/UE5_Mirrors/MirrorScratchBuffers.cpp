@@ -0,0 +1,56 @@
+#include "MirrorScratchBuffers.h"
+#include "HAL/IConsoleManager.h"
+
+#if !UE_BUILD_SHIPPING
+static TAutoConsoleVariable<bool> CVarMirrorsAssertNoCaptureAllocations(
+	TEXT("Mirrors.AssertNoCaptureAllocations"), false,
+	TEXT("Ensure when a mirror capture grows its reusable containers after warm-up."));
+
+int32 FMirrorAllocationCounter::NumAllocatingCaptures = 0;
+#endif
+
+void FMirrorCullingScratch::Reset()
+{
+	VisiblePrimitives.Reset();
+	BakedActors.Reset();
+	BakedComponents.Reset();
+	VisibleActors.Reset();
+}
+
+SIZE_T FMirrorCullingScratch::GetAllocatedSize() const
+{
+	return VisiblePrimitives.GetAllocatedSize() + BakedActors.GetAllocatedSize() + BakedComponents.GetAllocatedSize() +
+		VisibleActors.GetAllocatedSize();
+}
+
+void FMirrorAllocationCounter::BeginCapture(const SIZE_T AllocatedSize)
+{
+#if !UE_BUILD_SHIPPING
+	AllocatedSizeAtBegin = AllocatedSize;
+#endif
+}
+
+void FMirrorAllocationCounter::EndCapture(const SIZE_T AllocatedSize, const AActor* Mirror)
+{
+#if !UE_BUILD_SHIPPING
+	NumCaptures++;
+	if (AllocatedSize <= AllocatedSizeAtBegin || NumCaptures <= WarmupCaptures)
+	{
+		return;
+	}
+
+	NumAllocatingCaptures++;
+	ensureMsgf(!CVarMirrorsAssertNoCaptureAllocations.GetValueOnGameThread(),
+	           TEXT("%s grew its capture buffers from %llu to %llu bytes after warm-up."),
+	           *GetNameSafe(Mirror), static_cast<uint64>(AllocatedSizeAtBegin), static_cast<uint64>(AllocatedSize));
+#endif
+}
+
+int32 FMirrorAllocationCounter::GetNumAllocatingCaptures()
+{
+#if !UE_BUILD_SHIPPING
+	return NumAllocatingCaptures;
+#else
+	return 0;
+#endif
+}
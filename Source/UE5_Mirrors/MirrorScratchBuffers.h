@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPrimitiveComponent;
+
+// Containers reused by every culling pass of a mirror. Resetting keeps their memory, so once they have grown to fit the
+// largest reflection the capture path stops allocating.
+struct UE5_MIRRORS_API FMirrorCullingScratch
+{
+	TArray<UPrimitiveComponent*> VisiblePrimitives;
+	TArray<AActor*> BakedActors;
+	TArray<UPrimitiveComponent*> BakedComponents;
+	TSet<AActor*> VisibleActors;
+
+	void Reset();
+	SIZE_T GetAllocatedSize() const;
+};
+
+// Counts captures that had to grow one of a mirror's reusable containers after the mirror's first WarmupCaptures.
+// Set Mirrors.AssertNoCaptureAllocations to hit an ensure on such a capture. Does nothing in shipping builds.
+class UE5_MIRRORS_API FMirrorAllocationCounter
+{
+public:
+	static constexpr int32 WarmupCaptures = 30;
+
+	// Pass the summed allocated size of the mirror's reusable containers before and after its capture.
+	void BeginCapture(SIZE_T AllocatedSize);
+	void EndCapture(SIZE_T AllocatedSize, const AActor* Mirror);
+
+	// Over all mirrors since the game started.
+	static int32 GetNumAllocatingCaptures();
+
+private:
+#if !UE_BUILD_SHIPPING
+	SIZE_T AllocatedSizeAtBegin = 0;
+	int32 NumCaptures = 0;
+	static int32 NumAllocatingCaptures;
+#endif
+};
@@ -0,0 +1,68 @@
+#include "MirrorScreenCoverage.h"
+#include "Components/PrimitiveComponent.h"
+
+void FMirrorScreenCoverage::GetMirrorCorners(const UPrimitiveComponent* MirrorMesh, FVector (&OutCorners)[4])
+{
+	FVector Min;
+	FVector Max;
+	MirrorMesh->GetLocalBounds(Min, Max);
+
+	const float SurfaceX = (Min.X + Max.X) / 2;
+	const FTransform& MeshTransform = MirrorMesh->GetComponentTransform();
+	OutCorners[0] = MeshTransform.TransformPosition(FVector(SurfaceX, Min.Y, Max.Z));
+	OutCorners[1] = MeshTransform.TransformPosition(FVector(SurfaceX, Max.Y, Max.Z));
+	OutCorners[2] = MeshTransform.TransformPosition(FVector(SurfaceX, Max.Y, Min.Z));
+	OutCorners[3] = MeshTransform.TransformPosition(FVector(SurfaceX, Min.Y, Min.Z));
+}
+
+float FMirrorScreenCoverage::CalcCoveredPixels(const FTransform& ViewTransform, const FVector (&Corners)[4],
+                                               const FVector2D& FovDegrees, const FVector2D& ViewSize)
+{
+	const float ViewPixels = ViewSize.X * ViewSize.Y;
+	const float FocalLengthX = ViewSize.X / 2 / FMath::Tan(FMath::DegreesToRadians(FovDegrees.X) / 2);
+	const float FocalLengthY = ViewSize.Y / 2 / FMath::Tan(FMath::DegreesToRadians(FovDegrees.Y) / 2);
+
+	FVector2D ScreenCorners[4];
+	FBox2D ScreenBounds(ForceInit);
+	for (int32 Index = 0; Index < 4; Index++)
+	{
+		// View space is X forward, Y right and Z up.
+		const FVector ViewCorner = ViewTransform.InverseTransformPositionNoScale(Corners[Index]);
+		if (ViewCorner.X <= KINDA_SMALL_NUMBER)
+		{
+			return ViewPixels;
+		}
+
+		ScreenCorners[Index] = FVector2D(ViewCorner.Y / ViewCorner.X * FocalLengthX,
+		                                 ViewCorner.Z / ViewCorner.X * FocalLengthY);
+		ScreenBounds += ScreenCorners[Index];
+	}
+
+	// Shoelace area of the projected quad. It is exact while the mirror is fully on screen.
+	float QuadArea = 0;
+	for (int32 Index = 0; Index < 4; Index++)
+	{
+		const FVector2D& Current = ScreenCorners[Index];
+		const FVector2D& Next = ScreenCorners[(Index + 1) % 4];
+		QuadArea += Current.X * Next.Y - Next.X * Current.Y;
+	}
+	QuadArea = FMath::Abs(QuadArea) / 2;
+
+	// Partly off screen mirrors are limited by their on screen bounding rectangle.
+	const FBox2D Screen(-ViewSize / 2, ViewSize / 2);
+	const FBox2D OnScreenBounds(FVector2D::Max(ScreenBounds.Min, Screen.Min), FVector2D::Min(ScreenBounds.Max, Screen.Max));
+	const FVector2D OnScreenSize = FVector2D::Max(OnScreenBounds.Max - OnScreenBounds.Min, FVector2D::ZeroVector);
+
+	return FMath::Min3(QuadArea, OnScreenSize.X * OnScreenSize.Y, ViewPixels);
+}
+
+float FMirrorScreenCoverage::CalcVerticalFov(const float HorizontalFovDegrees, const FVector2D& ViewSize)
+{
+	if (ViewSize.X <= 0)
+	{
+		return HorizontalFovDegrees;
+	}
+
+	const float HalfTan = FMath::Tan(FMath::DegreesToRadians(HorizontalFovDegrees) / 2) * ViewSize.Y / ViewSize.X;
+	return FMath::RadiansToDegrees(FMath::Atan(HalfTan)) * 2;
+}
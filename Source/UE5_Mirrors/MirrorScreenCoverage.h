@@ -0,0 +1,19 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Estimates how many pixels a mirror covers on screen, so its capture doesn't get more texels than it can show.
+class UE5_MIRRORS_API FMirrorScreenCoverage
+{
+public:
+	// World space corners of the mirror surface, in winding order.
+	static void GetMirrorCorners(const UPrimitiveComponent* MirrorMesh, FVector (&OutCorners)[4]);
+
+	// Pixels covered by the quad in a perspective view with the given fields of view in degrees and view size in pixels.
+	// Returns the whole view if a corner is behind the camera.
+	static float CalcCoveredPixels(const FTransform& ViewTransform, const FVector (&Corners)[4], const FVector2D& FovDegrees,
+	                               const FVector2D& ViewSize);
+
+	// Vertical field of view for a horizontal one and the view's aspect ratio.
+	static float CalcVerticalFov(float HorizontalFovDegrees, const FVector2D& ViewSize);
+};
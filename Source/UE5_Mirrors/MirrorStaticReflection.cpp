@@ -0,0 +1,59 @@
+#include "MirrorStaticReflection.h"
+#include "MirrorProjection.h"
+#include "MirrorScreenCoverage.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+
+float FMirrorStaticReflection::CalcBlend(const float Distance, const float MaxDistance, const float FadeDistance)
+{
+	if (FadeDistance <= 0)
+	{
+		return Distance >= MaxDistance ? 1 : 0;
+	}
+
+	return FMath::Clamp((Distance - (MaxDistance - FadeDistance)) / FadeDistance, 0.f, 1.f);
+}
+
+FIntPoint FMirrorStaticReflection::CalcResolution(const UPrimitiveComponent* MirrorMesh, const int32 LongSide)
+{
+	const float AspectRatio = FMirrorProjection::CalcMirrorAspectRatio(MirrorMesh);
+	const int32 ShortSide = FMath::Max(FMath::RoundToInt(LongSide / FMath::Max(AspectRatio, 1 / AspectRatio)), 1);
+	return AspectRatio >= 1 ? FIntPoint(LongSide, ShortSide) : FIntPoint(ShortSide, LongSide);
+}
+
+bool FMirrorStaticReflection::Capture(USceneCaptureComponent2D* SceneCapture, const UPrimitiveComponent* MirrorMesh,
+                                      const FTransform& MirrorTransform, const float ViewDistance,
+                                      UTextureRenderTarget2D* Target)
+{
+	FVector MirrorCorners[4];
+	FMirrorScreenCoverage::GetMirrorCorners(MirrorMesh, MirrorCorners);
+
+	// The mirrored viewer of someone standing ViewDistance in front of the mirror, looking straight through it.
+	const FVector MirrorForward = MirrorTransform.GetRotation().GetForwardVector();
+	const FTransform ViewTransform(MirrorTransform.GetRotation(),
+	                               MirrorTransform.GetLocation() - MirrorForward * FMath::Max(ViewDistance, 1.f));
+	FMatrix Projection;
+	if (!FMirrorProjection::CalcOffAxisProjection(ViewTransform, MirrorCorners, Projection))
+	{
+		return false;
+	}
+
+	UTextureRenderTarget2D* LiveTarget = SceneCapture->TextureTarget;
+	const ESceneCapturePrimitiveRenderMode LiveRenderMode = SceneCapture->PrimitiveRenderMode;
+
+	// Culled show only lists belong to the live viewpoint, the static one sees the whole scene behind the mirror.
+	SceneCapture->TextureTarget = Target;
+	SceneCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_RenderScenePrimitives;
+	SceneCapture->ClipPlaneBase = MirrorTransform.GetLocation();
+	SceneCapture->ClipPlaneNormal = MirrorForward;
+	SceneCapture->bUseCustomProjectionMatrix = true;
+	SceneCapture->CustomProjectionMatrix = Projection;
+	SceneCapture->SetWorldTransform(ViewTransform);
+	SceneCapture->CaptureScene();
+
+	// Live captures set their own view, projection and clip plane every time.
+	SceneCapture->TextureTarget = LiveTarget;
+	SceneCapture->PrimitiveRenderMode = LiveRenderMode;
+	return true;
+}
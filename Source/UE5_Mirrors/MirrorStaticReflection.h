@@ -0,0 +1,25 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPrimitiveComponent;
+class USceneCaptureComponent2D;
+class UTextureRenderTarget2D;
+
+// The cheap reflection distant mirrors show instead of capturing. It's one capture from a representative viewpoint in front of
+// the mirror, projected onto the mirror's corners, so the mirror material samples it with the mesh UVs from any viewpoint.
+class UE5_MIRRORS_API FMirrorStaticReflection
+{
+public:
+	// How much of the static reflection shows at a camera distance, 0 for only the live capture and 1 for only the static one.
+	// The fade ends at MaxDistance, where the live capture stops.
+	static float CalcBlend(float Distance, float MaxDistance, float FadeDistance);
+
+	// Render target size with LongSide pixels along the mirror's longer side.
+	static FIntPoint CalcResolution(const UPrimitiveComponent* MirrorMesh, int32 LongSide);
+
+	// Captures the mirror as seen head-on from ViewDistance in front of it into Target. MirrorTransform has the mirror's
+	// rotation and the center of its surface. The scene capture renders the whole scene for it and gets its target and render mode back afterwards.
+	static bool Capture(USceneCaptureComponent2D* SceneCapture, const UPrimitiveComponent* MirrorMesh,
+	                    const FTransform& MirrorTransform, float ViewDistance, UTextureRenderTarget2D* Target);
+};
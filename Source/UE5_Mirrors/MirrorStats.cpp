@@ -0,0 +1,144 @@
+#include "MirrorStats.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "GameFramework/Actor.h"
+
+DEFINE_STAT(STAT_MirrorEvaluateMirrors);
+DEFINE_STAT(STAT_MirrorCaptureScene);
+DEFINE_STAT(STAT_MirrorCulling);
+DEFINE_STAT(STAT_MirrorIndexQuery);
+DEFINE_STAT(STAT_MirrorPlaneTests);
+DEFINE_STAT(STAT_MirrorAsyncCulling);
+
+DEFINE_STAT(STAT_MirrorCaptures);
+DEFINE_STAT(STAT_MirrorSkippedTriggers);
+DEFINE_STAT(STAT_MirrorSkippedNotRendered);
+DEFINE_STAT(STAT_MirrorSkippedNotReady);
+DEFINE_STAT(STAT_MirrorSkippedDistance);
+DEFINE_STAT(STAT_MirrorSkippedBehindMirror);
+DEFINE_STAT(STAT_MirrorSkippedZone);
+DEFINE_STAT(STAT_MirrorSkippedUnchanged);
+DEFINE_STAT(STAT_MirrorSkippedSharedCapture);
+DEFINE_STAT(STAT_MirrorDeferred);
+DEFINE_STAT(STAT_MirrorShowOnlyActors);
+DEFINE_STAT(STAT_MirrorShowOnlyComponents);
+DEFINE_STAT(STAT_MirrorRenderTargetMemory);
+DEFINE_STAT(STAT_MirrorPooledRenderTargetMemory);
+
+CSV_DEFINE_CATEGORY_MODULE(UE5_MIRRORS_API, Mirrors, true);
+
+FMirrorFrameCounts FMirrorStats::FrameCounts;
+bool FMirrorStats::bCountingFrames = false;
+
+void FMirrorStatNames::Init(const AActor* Mirror)
+{
+	TraceName = Mirror ? Mirror->GetActorNameOrLabel() : TEXT("None");
+	CsvCaptureTimeName = FName(TEXT("CaptureTime/") + TraceName);
+}
+
+void FMirrorStats::CountSkippedCapture(const EMirrorSkipReason Reason)
+{
+	if (bCountingFrames && Reason != EMirrorSkipReason::None)
+	{
+		FrameCounts.NumSkippedCaptures++;
+	}
+
+	switch (Reason)
+	{
+	case EMirrorSkipReason::Triggers:
+		MIRROR_INC_COUNTER(SkippedTriggers, 1);
+		break;
+	case EMirrorSkipReason::NotRendered:
+		MIRROR_INC_COUNTER(SkippedNotRendered, 1);
+		break;
+	case EMirrorSkipReason::NotReady:
+		MIRROR_INC_COUNTER(SkippedNotReady, 1);
+		break;
+	case EMirrorSkipReason::Distance:
+		MIRROR_INC_COUNTER(SkippedDistance, 1);
+		break;
+	case EMirrorSkipReason::BehindMirror:
+		MIRROR_INC_COUNTER(SkippedBehindMirror, 1);
+		break;
+	case EMirrorSkipReason::Zone:
+		MIRROR_INC_COUNTER(SkippedZone, 1);
+		break;
+	case EMirrorSkipReason::Unchanged:
+		MIRROR_INC_COUNTER(SkippedUnchanged, 1);
+		break;
+	case EMirrorSkipReason::SharedCapture:
+		MIRROR_INC_COUNTER(SkippedSharedCapture, 1);
+		break;
+	default:
+		break;
+	}
+}
+
+void FMirrorStats::CountCapture(const int32 NumShowOnlyActors, const int32 NumShowOnlyComponents)
+{
+	if (bCountingFrames)
+	{
+		FrameCounts.NumCaptures++;
+		FrameCounts.NumShowOnlyActors += NumShowOnlyActors;
+		FrameCounts.NumShowOnlyComponents += NumShowOnlyComponents;
+	}
+
+	MIRROR_INC_COUNTER(Captures, 1);
+	MIRROR_INC_COUNTER(ShowOnlyActors, NumShowOnlyActors);
+	MIRROR_INC_COUNTER(ShowOnlyComponents, NumShowOnlyComponents);
+}
+
+void FMirrorStats::AddMirrorTime(const double TimeMs)
+{
+	if (bCountingFrames)
+	{
+		FrameCounts.MirrorTimeMs += TimeMs;
+	}
+}
+
+FMirrorFrameCounts FMirrorStats::TakeFrameCounts()
+{
+	const FMirrorFrameCounts Counts = FrameCounts;
+	FrameCounts = FMirrorFrameCounts();
+	return Counts;
+}
+
+void FMirrorStats::SetCountingFrames(const bool bEnable)
+{
+	bCountingFrames = bEnable;
+	FrameCounts = FMirrorFrameCounts();
+}
+
+void FMirrorStats::AddRenderTargetMemory(const UTextureRenderTarget2D* RenderTarget)
+{
+	if (!RenderTarget)
+	{
+		return;
+	}
+
+	const float SizeMB = RenderTarget->CalcTextureMemorySizeEnum(TMC_ResidentMips) / (1024.f * 1024.f);
+	INC_FLOAT_STAT_BY(STAT_MirrorRenderTargetMemory, SizeMB);
+	CSV_CUSTOM_STAT(Mirrors, RenderTargetMemoryMB, SizeMB, ECsvCustomStatOp::Accumulate);
+}
+
+void FMirrorStats::AddPooledRenderTargetMemory(const SIZE_T Size)
+{
+	const float SizeMB = Size / (1024.f * 1024.f);
+	INC_FLOAT_STAT_BY(STAT_MirrorPooledRenderTargetMemory, SizeMB);
+	CSV_CUSTOM_STAT(Mirrors, PooledRenderTargetMemoryMB, SizeMB, ECsvCustomStatOp::Accumulate);
+}
+
+FMirrorCsvCaptureScope::FMirrorCsvCaptureScope(const FMirrorStatNames& InNames)
+#if CSV_PROFILER
+	: Names(InNames), StartCycles(FPlatformTime::Cycles64())
+#endif
+{
+}
+
+FMirrorCsvCaptureScope::~FMirrorCsvCaptureScope()
+{
+#if CSV_PROFILER
+	const double CaptureTimeMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+	FCsvProfiler::RecordCustomStat(Names.CsvCaptureTimeName, CSV_CATEGORY_INDEX(Mirrors),
+	                               static_cast<float>(CaptureTimeMs), ECsvCustomStatOp::Accumulate);
+#endif
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+
+class AActor;
+class UTextureRenderTarget2D;
+
+// stat Mirrors, the Mirrors CSV category and the Mirror events in Insights. Counters are per frame, summed over all mirrors.
+DECLARE_STATS_GROUP(TEXT("Mirrors"), STATGROUP_Mirrors, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Evaluate mirrors"), STAT_MirrorEvaluateMirrors, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Capture scene"), STAT_MirrorCaptureScene, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mirror culling"), STAT_MirrorCulling, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Primitive index query"), STAT_MirrorIndexQuery, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Plane tests"), STAT_MirrorPlaneTests, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Async culling"), STAT_MirrorAsyncCulling, STATGROUP_Mirrors, UE5_MIRRORS_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Captures"), STAT_MirrorCaptures, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped: no active trigger"), STAT_MirrorSkippedTriggers, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped: not rendered"), STAT_MirrorSkippedNotRendered, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped: not ready"), STAT_MirrorSkippedNotReady, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped: distance"), STAT_MirrorSkippedDistance, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped: behind mirror"), STAT_MirrorSkippedBehindMirror, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped: zone not visible"), STAT_MirrorSkippedZone, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped: unchanged"), STAT_MirrorSkippedUnchanged, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Skipped: shared capture"), STAT_MirrorSkippedSharedCapture, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Deferred by budget"), STAT_MirrorDeferred, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Show only actors"), STAT_MirrorShowOnlyActors, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Show only components"), STAT_MirrorShowOnlyComponents, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Render target memory (MB)"), STAT_MirrorRenderTargetMemory, STATGROUP_Mirrors, UE5_MIRRORS_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Pooled render target memory (MB)"), STAT_MirrorPooledRenderTargetMemory, STATGROUP_Mirrors, UE5_MIRRORS_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(UE5_MIRRORS_API, Mirrors);
+
+// Times a scope for stat Mirrors, the CSV profiler and Insights. Name is the stat without its STAT_Mirror prefix.
+#define MIRROR_SCOPE_CYCLE_COUNTER(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_Mirror##Name); \
+	CSV_SCOPED_TIMING_STAT(Mirrors, Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Mirror##Name)
+
+// Adds to a per frame counter of stat Mirrors and the CSV stat of the same name.
+#define MIRROR_INC_COUNTER(Name, Amount) \
+	INC_DWORD_STAT_BY(STAT_Mirror##Name, Amount); \
+	CSV_CUSTOM_STAT(Mirrors, Name, static_cast<int32>(Amount), ECsvCustomStatOp::Accumulate)
+
+// Why a mirror didn't capture this frame.
+enum class EMirrorSkipReason : uint8
+{
+	None,
+	Triggers,
+	NotRendered,
+	NotReady,
+	Distance,
+	BehindMirror,
+	Zone,
+	Unchanged,
+	SharedCapture
+};
+
+// A mirror's own names in Insights and the CSV profiler. Made once in BeginPlay, so captures don't format names.
+struct UE5_MIRRORS_API FMirrorStatNames
+{
+	FString TraceName;
+	FName CsvCaptureTimeName;
+
+	void Init(const AActor* Mirror);
+};
+
+// Totals since they were last taken. Kept in every build configuration, unlike the stats, for the camera path replay log.
+// Only counted while a replay has them turned on, so they can't grow for a whole session.
+struct FMirrorFrameCounts
+{
+	int32 NumCaptures = 0;
+	int32 NumSkippedCaptures = 0;
+	int32 NumShowOnlyActors = 0;
+	int32 NumShowOnlyComponents = 0;
+	double MirrorTimeMs = 0;
+};
+
+// Game thread only.
+struct UE5_MIRRORS_API FMirrorStats
+{
+	static void CountSkippedCapture(EMirrorSkipReason Reason);
+	static void CountCapture(int32 NumShowOnlyActors, int32 NumShowOnlyComponents);
+	static void AddMirrorTime(double TimeMs);
+	static void AddRenderTargetMemory(const UTextureRenderTarget2D* RenderTarget);
+	static void AddPooledRenderTargetMemory(SIZE_T Size);
+
+	// Returns the counts and starts over.
+	static FMirrorFrameCounts TakeFrameCounts();
+
+	// Turning the counts off drops what they hold.
+	static void SetCountingFrames(bool bEnable);
+
+private:
+	static FMirrorFrameCounts FrameCounts;
+	static bool bCountingFrames;
+};
+
+// Records how long one mirror's capture took as its own CSV stat, next to the summed CaptureScene timing.
+class UE5_MIRRORS_API FMirrorCsvCaptureScope
+{
+public:
+	explicit FMirrorCsvCaptureScope(const FMirrorStatNames& InNames);
+	~FMirrorCsvCaptureScope();
+
+private:
+#if CSV_PROFILER
+	const FMirrorStatNames& Names;
+	uint64 StartCycles;
+#endif
+};
@@ -1,31 +1,59 @@
 #include "MirrorSubsystem.h"
 #include "CMirror.h"
+#include "MirrorCaptureGroups.h"
+#include "MirrorChangeDetector.h"
+#include "MirrorScratchBuffers.h"
+#include "MirrorStats.h"
+#include "Camera/CameraComponent.h"
 #include "Components/SceneCaptureComponent2D.h"
+#include "Engine/World.h"
+#include "Misc/CoreDelegates.h"
+#include "UObject/UObjectGlobals.h"
+#include "RenderCore.h"
+#include "RHI.h"
+
+void UMirrorSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddUObject(this, &UMirrorSubsystem::OnWorldPreActorTick);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UMirrorSubsystem::OnWorldPostActorTick);
+	CameraPathPlayer.OnViewCameraChanged.AddUObject(this, &UMirrorSubsystem::UpdateActiveCamera);
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UMirrorSubsystem::OnEndFrame);
+	PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(
+		this, &UMirrorSubsystem::OnPreGarbageCollect);
+	FMirrorChangeDetector::StartTrackingRenderState();
+}
+
+void UMirrorSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+	FMirrorChangeDetector::StopTrackingRenderState();
+	AsyncCulling.Reset();
+	CameraPathPlayer.OnViewCameraChanged.Clear();
+	CameraPathPlayer.Stop();
+	UnbindWorldDelegates();
+	PrimitiveIndex.Reset();
+	ZoneGraph.Reset();
+	CaptureLoop.Reset();
+	RegroupReleasedTargets.Reset();
+	RenderTargetPool.Empty();
+	Super::Deinitialize();
+}
 
 void UMirrorSubsystem::OnMirrorCreated(ACMirror* NewMirror)
 {
+	// Mirror meshes are hidden in all scene captures, so registering doesn't touch the other mirrors.
 	WorldMirrors.Add(NewMirror);
-	NewMirror->SceneCapture->HiddenActors.Append(WorldMirrors);
-
-	for (const auto Mirror : WorldMirrors)
-	{
-		if (Mirror)
-		{
-			Mirror->SceneCapture->HiddenActors.AddUnique(NewMirror);
-		}
-	}
+	bCaptureGroupsDirty = true;
 }
 
 void UMirrorSubsystem::OnMirrorDestroyed(ACMirror* DestroyedMirror)
 {
-	WorldMirrors.Remove(DestroyedMirror);
-	for (const auto Mirror : WorldMirrors)
-	{
-		if (Mirror)
-		{
-			Mirror->SceneCapture->HiddenActors.Remove(DestroyedMirror);
-		}
-	}
+	WorldMirrors.RemoveSingleSwap(DestroyedMirror);
+	bCaptureGroupsDirty = true;
 }
 
 int32 UMirrorSubsystem::GetMirrorsNumber() const
@@ -65,9 +93,367 @@ void UMirrorSubsystem::UpdateActiveCamera(UCameraComponent* NewActiveCamera) con
 			Mirror->Init();
 		}
 	}
-	
-	if (GEngine)
+}
+
+UTextureRenderTarget2D* UMirrorSubsystem::AcquireRenderTarget(const int32 Width, const int32 Height)
+{
+	return RenderTargetPool.Acquire(this, Width, Height);
+}
+
+void UMirrorSubsystem::ReleaseRenderTarget(UTextureRenderTarget2D* RenderTarget)
+{
+	RenderTargetPool.MaxFreeTargets = MaxPooledRenderTargets;
+	RenderTargetPool.Release(RenderTarget);
+}
+
+void UMirrorSubsystem::OnCaptureGroupSurfaceMoved()
+{
+	bCaptureGroupsDirty = true;
+}
+
+void UMirrorSubsystem::ReleaseRenderTargetAfterRegroup(UTextureRenderTarget2D* RenderTarget)
+{
+	if (RenderTarget)
+	{
+		RegroupReleasedTargets.Add(RenderTarget);
+	}
+}
+
+void UMirrorSubsystem::QueueEvaluation(ACMirror* Mirror)
+{
+	CaptureLoop.QueueEvaluation(Mirror);
+}
+
+void UMirrorSubsystem::RequestCapture(const FMirrorCaptureRequest& Request)
+{
+	CaptureLoop.RequestCapture(Request);
+}
+
+void UMirrorSubsystem::SetCaptureBudget(const int32 NewMaxCapturesPerFrame, const float NewMaxCaptureCostPerFrame)
+{
+	MaxCapturesPerFrame = FMath::Max(NewMaxCapturesPerFrame, 0);
+	MaxCaptureCostPerFrame = FMath::Max(NewMaxCaptureCostPerFrame, 0.f);
+}
+
+void UMirrorSubsystem::OnUnchangedCaptureSkipped()
+{
+	CaptureLoop.OnUnchangedCaptureSkipped();
+}
+
+float UMirrorSubsystem::GetFrameBudgetQualityScale() const
+{
+	return QualityController.GetQualityScale();
+}
+
+int32 UMirrorSubsystem::GetNumDeferredCaptures() const
+{
+	return CaptureLoop.GetNumDeferredCaptures();
+}
+
+int32 UMirrorSubsystem::GetNumUnchangedCaptureSkips() const
+{
+	return CaptureLoop.GetNumUnchangedCaptureSkips();
+}
+
+int32 UMirrorSubsystem::GetNumAllocatingCaptures() const
+{
+	return FMirrorAllocationCounter::GetNumAllocatingCaptures();
+}
+
+void UMirrorSubsystem::OnWorldPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World && World->GetGameInstance() == GetGameInstance())
+	{
+		CameraPathPlayer.PlaceReplayCamera(World);
+	}
+}
+
+void UMirrorSubsystem::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	// Mirrors tick in TG_PostUpdateWork, after the camera has been updated, so every request for this frame is in by now.
+	if (World && World->GetGameInstance() == GetGameInstance())
+	{
+		CameraPathPlayer.Update(World);
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		ExecuteCaptureRequests();
+		FMirrorStats::AddMirrorTime(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+	}
+}
+
+void UMirrorSubsystem::OnEndFrame()
+{
+	// The queries run while the next frame starts. Anything changing the index before the captures waits for them.
+	// Launching without queries still retires the last results, so a mirror never picks up a result older than a frame.
+	if (BoundWorld.IsValid())
+	{
+		if (AsyncCulling.HasPendingQueries())
+		{
+			AsyncCulling.Wait();
+			PrimitiveIndex.Update();
+		}
+
+		AsyncCulling.Launch(PrimitiveIndex);
+	}
+}
+
+void UMirrorSubsystem::OnPreGarbageCollect()
+{
+	AsyncCulling.DiscardResults();
+	FMirrorChangeDetector::PruneRenderStateGenerations();
+}
+
+float UMirrorSubsystem::UpdateFrameBudget()
+{
+	if (!bEnableFrameBudget || FrameBudgetUpdateFrame == GFrameCounter)
+	{
+		return QualityController.GetQualityScale();
+	}
+
+	FrameBudgetUpdateFrame = GFrameCounter;
+	QualityController.AddFrameTime(FPlatformTime::ToMilliseconds(GGameThreadTime),
+	                               FPlatformTime::ToMilliseconds(GRenderThreadTime),
+	                               FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles()));
+
+	FMirrorQualityControllerSettings Settings;
+	Settings.TargetFrameTimeMs = TargetFrameTimeMs;
+	Settings.MinQualityScale = MinFrameBudgetQualityScale;
+	const float QualityScale = QualityController.Update(Settings);
+	TMirrorCaptureLoop<ACMirror>::SetFrameBudgetScale(WorldMirrors, QualityScale);
+	return QualityScale;
+}
+
+void UMirrorSubsystem::UpdateCaptureGroups()
+{
+	// Grouping waits for the first flush after mirrors come and go, so a level streaming in many mirrors is grouped once.
+	if (!bCaptureGroupsDirty)
+	{
+		return;
+	}
+
+	bCaptureGroupsDirty = false;
+
+	TArray<ACMirror*> SharingMirrors;
+	TArray<FMirrorCaptureGroupSurface> Surfaces;
+	for (ACMirror* Mirror : WorldMirrors)
+	{
+		FMirrorCaptureGroupSurface Surface;
+		if (IsValid(Mirror) && Mirror->GetCaptureGroupSurface(Surface))
+		{
+			SharingMirrors.Add(Mirror);
+			Surfaces.Add(Surface);
+		}
+	}
+
+	FMirrorCaptureGroupSettings Settings;
+	Settings.DistanceTolerance = CoplanarDistanceTolerance;
+	Settings.AngleTolerance = CoplanarAngleTolerance;
+	Settings.MaxGap = CoplanarMaxGap;
+	TArray<FMirrorCaptureGroup> Groups;
+	FMirrorCaptureGroups::FindGroups(Surfaces, Settings, Groups);
+
+	// Every mirror is set before any is applied, so a leader moving to a new render target finds its members already in place.
+	TSet<ACMirror*> GroupedMirrors;
+	TArray<ACMirror*> ChangedMirrors;
+	TArray<ACMirror*, TInlineAllocator<8>> Members;
+	for (const FMirrorCaptureGroup& Group : Groups)
+	{
+		Members.Reset();
+		for (const int32 Member : Group.Members)
+		{
+			Members.Add(SharingMirrors[Member]);
+		}
+
+		ACMirror* Leader = Members[0];
+		const bool bLeaderChanged = Leader->LeadCaptureGroup(Members, Group.Corners);
+		for (int32 Index = 0; Index < Members.Num(); Index++)
+		{
+			ACMirror* Member = Members[Index];
+			GroupedMirrors.Add(Member);
+			if (Member->SetCaptureGroup(Leader, Group.Regions[Index]) || (Member == Leader && bLeaderChanged))
+			{
+				ChangedMirrors.Add(Member);
+			}
+		}
+	}
+
+	for (ACMirror* Mirror : WorldMirrors)
+	{
+		if (IsValid(Mirror) && !GroupedMirrors.Contains(Mirror) &&
+			Mirror->SetCaptureGroup(nullptr, FBox2D(FVector2D::ZeroVector, FVector2D::UnitVector)))
+		{
+			ChangedMirrors.Add(Mirror);
+		}
+	}
+
+	for (ACMirror* Mirror : ChangedMirrors)
+	{
+		Mirror->ApplyCaptureGroup();
+	}
+
+	// No member samples a destroyed leader's target anymore.
+	for (UTextureRenderTarget2D* RenderTarget : RegroupReleasedTargets)
+	{
+		ReleaseRenderTarget(RenderTarget);
+	}
+
+	RegroupReleasedTargets.Reset();
+}
+
+void UMirrorSubsystem::ExecuteCaptureRequests()
+{
+	const float QualityScale = UpdateFrameBudget();
+	UpdateCaptureGroups();
+
+	FMirrorCaptureBudget Budget;
+	Budget.MaxCaptures = MaxCapturesPerFrame;
+	Budget.MaxCost = MaxCaptureCostPerFrame;
+	Budget.StalenessWeight = CaptureStalenessWeight;
+	CaptureLoop.Execute(Budget, bEnableFrameBudget ? QualityScale : 1, MirrorsPerEvaluationTask);
+	TMirrorCaptureLoop<ACMirror>::AddRenderTargetStats(WorldMirrors, RenderTargetPool);
+}
+
+FMirrorPrimitiveIndex* UMirrorSubsystem::GetPrimitiveIndex(UWorld* World)
+{
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	AsyncCulling.Wait();
+	if (BoundWorld != World)
+	{
+		BindWorldDelegates(World);
+		PrimitiveIndex.Build(World);
+		PrimitiveIndexUpdateFrame = GFrameCounter;
+	}
+	else if (PrimitiveIndexUpdateFrame != GFrameCounter)
 	{
-		GEngine->ForceGarbageCollection();
+		PrimitiveIndex.Update();
+		PrimitiveIndexUpdateFrame = GFrameCounter;
+	}
+
+	return &PrimitiveIndex;
+}
+
+FMirrorCullingQuery& UMirrorSubsystem::QueueAsyncCulling(const AActor* Mirror)
+{
+	return AsyncCulling.AddQuery(Mirror);
+}
+
+const FMirrorCullingQuery* UMirrorSubsystem::GetAsyncCullingResult(const AActor* Mirror)
+{
+	return AsyncCulling.FindResult(Mirror);
+}
+
+void UMirrorSubsystem::RegisterZone(AMirrorZoneVolume* Zone)
+{
+	ZoneGraph.AddZone(Zone);
+}
+
+void UMirrorSubsystem::UnregisterZone(AMirrorZoneVolume* Zone)
+{
+	ZoneGraph.RemoveZone(Zone);
+}
+
+void UMirrorSubsystem::RegisterPortal(AMirrorPortal* Portal)
+{
+	ZoneGraph.AddPortal(Portal);
+}
+
+void UMirrorSubsystem::UnregisterPortal(AMirrorPortal* Portal)
+{
+	ZoneGraph.RemovePortal(Portal);
+}
+
+bool UMirrorSubsystem::IsMirrorInVisibleZone(const AActor* Mirror, const FTransform& ViewTransform,
+                                             const FVector2D& FovDegrees)
+{
+	if (ZoneGraph.IsEmpty())
+	{
+		return true;
+	}
+
+	if (ZoneGraphUpdateFrame != GFrameCounter || FovDegrees.X > ZoneGraphFov.X || FovDegrees.Y > ZoneGraphFov.Y)
+	{
+		ZoneGraphFov = ZoneGraphUpdateFrame == GFrameCounter ? FVector2D::Max(ZoneGraphFov, FovDegrees) : FovDegrees;
+		ZoneGraph.Update(ViewTransform.GetLocation(), ViewTransform.GetRotation().GetForwardVector(), ZoneGraphFov,
+		                 MaxZonePortalDepth);
+		ZoneGraphUpdateFrame = GFrameCounter;
+	}
+
+	return ZoneGraph.IsMirrorPotentiallyVisible(Mirror);
+}
+
+bool UMirrorSubsystem::WasRecentlyRendered(const UPrimitiveComponent* Surface) const
+{
+	return CameraPathPlayer.WasRecentlyRendered(Surface);
+}
+
+void UMirrorSubsystem::BindWorldDelegates(UWorld* World)
+{
+	UnbindWorldDelegates();
+	BoundWorld = World;
+	ActorSpawnedHandle = World->AddOnActorSpawnedHandler(
+		FOnActorSpawned::FDelegate::CreateUObject(this, &UMirrorSubsystem::OnActorSpawned));
+	ActorDestroyedHandle = World->AddOnActorDestroyedHandler(
+		FOnActorDestroyed::FDelegate::CreateUObject(this, &UMirrorSubsystem::OnActorDestroyed));
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UMirrorSubsystem::OnLevelAddedToWorld);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UMirrorSubsystem::OnLevelRemovedFromWorld);
+}
+
+void UMirrorSubsystem::UnbindWorldDelegates()
+{
+	if (UWorld* World = BoundWorld.Get())
+	{
+		World->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+		World->RemoveOnActorDestroyededHandler(ActorDestroyedHandle);
+	}
+
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	BoundWorld.Reset();
+	ActorSpawnedHandle.Reset();
+	ActorDestroyedHandle.Reset();
+	LevelAddedHandle.Reset();
+	LevelRemovedHandle.Reset();
+}
+
+// Spawns and destroys are queued instead of waiting for the culling task, they are applied with the index's next update.
+void UMirrorSubsystem::OnActorSpawned(AActor* SpawnedActor)
+{
+	PrimitiveIndex.QueueAddActor(SpawnedActor);
+}
+
+void UMirrorSubsystem::OnActorDestroyed(AActor* DestroyedActor)
+{
+	PrimitiveIndex.QueueRemoveActor(DestroyedActor);
+}
+
+void UMirrorSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World)
+{
+	if (World == BoundWorld)
+	{
+		AsyncCulling.Wait();
+		PrimitiveIndex.AddLevel(Level);
+	}
+}
+
+void UMirrorSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World)
+{
+	if (World == BoundWorld)
+	{
+		AsyncCulling.Wait();
+
+		// A null level means the whole world is being cleaned up.
+		if (Level)
+		{
+			PrimitiveIndex.RemoveLevel(Level);
+		}
+		else
+		{
+			UnbindWorldDelegates();
+			AsyncCulling.Reset();
+			PrimitiveIndex.Reset();
+		}
 	}
 }
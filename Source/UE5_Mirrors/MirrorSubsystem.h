@@ -1,21 +1,83 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "MirrorAsyncCulling.h"
+#include "MirrorCameraPath.h"
+#include "MirrorCaptureLoop.h"
+#include "MirrorQualityController.h"
+#include "MirrorRenderTargetPool.h"
+#include "MirrorPrimitiveIndex.h"
+#include "MirrorZoneGraph.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "MirrorSubsystem.generated.h"
 
 class UCameraComponent;
+class UPrimitiveComponent;
 class ACMirror;
+class AMirrorPortal;
+class AMirrorZoneVolume;
 
-UCLASS()
+UCLASS(Config=Game)
 class UE5_MIRRORS_API UMirrorSubsystem : public UGameInstanceSubsystem
 {
 	GENERATED_BODY()
 
 public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
 	void OnMirrorCreated(ACMirror* NewMirror);
 	void OnMirrorDestroyed(ACMirror* DestroyedMirror);
-	
+
+	// Queue a ticking mirror for this frame's evaluation. All queued mirrors are evaluated at once, spread over worker threads.
+	void QueueEvaluation(ACMirror* Mirror);
+
+	// Queue a capture for this frame. Queued captures are ranked and executed after all actors have ticked.
+	void RequestCapture(const FMirrorCaptureRequest& Request);
+
+	// Render targets are recycled between mirrors and resolution changes. Release a target once it is no longer shown.
+	UTextureRenderTarget2D* AcquireRenderTarget(int32 Width, int32 Height);
+	void ReleaseRenderTarget(UTextureRenderTarget2D* RenderTarget);
+
+	// Called by mirrors with bShareCoplanarCapture as they move. They are grouped again with the next flush.
+	void OnCaptureGroupSurfaceMoved();
+
+	// For the target of a destroyed capture group leader, which its members sample until the next regroup has rebound them.
+	void ReleaseRenderTargetAfterRegroup(UTextureRenderTarget2D* RenderTarget);
+
+	// Called by mirrors that skipped their capture because nothing in the reflection changed.
+	void OnUnchangedCaptureSkipped();
+
+	// Bounds of all primitives in the world, used for mirror culling. Built on first use and brought up to date once per frame.
+	FMirrorPrimitiveIndex* GetPrimitiveIndex(UWorld* World);
+
+	// Queue a culling query for the next frame. Queries run on a worker thread once the frame has ended.
+	FMirrorCullingQuery& QueueAsyncCulling(const AActor* Mirror);
+
+	// The query this mirror queued last frame, with its result. Null if there is none.
+	const FMirrorCullingQuery* GetAsyncCullingResult(const AActor* Mirror);
+
+	// Called by zone volumes and portals as they begin and end play.
+	void RegisterZone(AMirrorZoneVolume* Zone);
+	void UnregisterZone(AMirrorZoneVolume* Zone);
+	void RegisterPortal(AMirrorPortal* Portal);
+	void UnregisterPortal(AMirrorPortal* Portal);
+
+	// False if the mirror's zone can't be seen from the viewer's zone. The zone graph is updated with the first view asked about each frame,
+	// and again for a wider field of view, so flat and VR mirrors asking in the same frame both get a graph covering their view.
+	// FovDegrees holds the view's horizontal and vertical field of view.
+	bool IsMirrorInVisibleZone(const AActor* Mirror, const FTransform& ViewTransform, const FVector2D& FovDegrees);
+
+	// Records and replays camera paths for profiling. Driven by both mirror subsystems, whichever flushes first in a frame.
+	FMirrorCameraPathPlayer& GetCameraPathPlayer() { return CameraPathPlayer; }
+
+	// Feeds the last frame's time into the frame budget on the first call of a frame and returns its quality scale.
+	// The frame budget is shared with the VR mirrors, so UVrMirrorSubsystem calls this too.
+	float UpdateFrameBudget();
+
+	// Whether a mirror surface was seen last frame. While a camera path replays, whether the replayed camera sees it.
+	bool WasRecentlyRendered(const UPrimitiveComponent* Surface) const;
+
 protected:
 	UFUNCTION(BlueprintCallable)
 	void UpdateActiveCamera(UCameraComponent* NewActiveCamera) const;
@@ -26,7 +88,117 @@ protected:
 	UFUNCTION(BlueprintCallable)
 	void DestroyAllMirrors();
 
+	UFUNCTION(BlueprintCallable)
+	void SetCaptureBudget(int32 NewMaxCapturesPerFrame, float NewMaxCaptureCostPerFrame);
+
+	// Current quality scale of the frame budget. 1 while frames stay within TargetFrameTimeMs.
+	UFUNCTION(BlueprintCallable)
+	float GetFrameBudgetQualityScale() const;
+
+	// Number of mirrors that wanted a capture last frame but did not fit into the budget.
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumDeferredCaptures() const;
+
+	// Number of mirrors that skipped their capture last frame because neither the camera nor the reflected actors changed.
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumUnchangedCaptureSkips() const;
+
+	// Captures of any mirror that had to grow its reusable buffers after warm-up. Should stay flat while playing. Always 0 in shipping builds.
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumAllocatingCaptures() const;
+
+	// Maximum number of mirror captures per frame. Mirrors that don't fit keep showing their last capture. 0 for unlimited.
+	UPROPERTY(Config, BlueprintReadOnly)
+	int32 MaxCapturesPerFrame = 4;
+
+	// Maximum summed capture cost per frame, measured in captured megapixels. 0 for unlimited.
+	UPROPERTY(Config, BlueprintReadOnly)
+	float MaxCaptureCostPerFrame = 0;
+
+	// How much each second without a capture raises a mirror's priority over closer or larger mirrors.
+	UPROPERTY(Config, BlueprintReadOnly)
+	float CaptureStalenessWeight = 4;
+
+	// Lower mirror capture resolution, capture rate and culling distance while frames take longer than TargetFrameTimeMs.
+	// Applies to the VR mirrors as well.
+	UPROPERTY(Config, BlueprintReadOnly)
+	bool bEnableFrameBudget = false;
+
+	// Frame time the frame budget tries to hold, in milliseconds. VR projects set the headset's frame time, 11.1 at 90 Hz.
+	UPROPERTY(Config, BlueprintReadOnly)
+	float TargetFrameTimeMs = 16.6;
+
+	// The frame budget never scales mirror quality below this.
+	UPROPERTY(Config, BlueprintReadOnly)
+	float MinFrameBudgetQualityScale = 0.25;
+
+	// Unused render targets kept for reuse. Dynamic capture resolution steps through a few sizes, so keeping some around avoids reallocating when walking back and forth.
+	UPROPERTY(Config, BlueprintReadOnly)
+	int32 MaxPooledRenderTargets = 8;
+
+	// Smallest number of mirrors evaluated per worker task. Levels with only a few mirrors evaluate them on the game thread.
+	UPROPERTY(Config, BlueprintReadOnly)
+	int32 MirrorsPerEvaluationTask = 8;
+
+	// How many portals away from the camera's zone mirrors can still be seen.
+	UPROPERTY(Config, BlueprintReadOnly)
+	int32 MaxZonePortalDepth = 2;
+
+	// How far apart in centimeters the surfaces of mirrors with bShareCoplanarCapture may be to still share a capture.
+	UPROPERTY(Config, BlueprintReadOnly)
+	float CoplanarDistanceTolerance = 1;
+
+	// How many degrees mirrors with bShareCoplanarCapture may be turned against each other to still share a capture.
+	UPROPERTY(Config, BlueprintReadOnly)
+	float CoplanarAngleTolerance = 0.5;
+
+	// Largest gap in centimeters between neighbouring mirrors sharing a capture.
+	UPROPERTY(Config, BlueprintReadOnly)
+	float CoplanarMaxGap = 10;
+
 private:
+	void OnWorldPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnEndFrame();
+	void OnPreGarbageCollect();
+	void UpdateCaptureGroups();
+	void ExecuteCaptureRequests();
+	void BindWorldDelegates(UWorld* World);
+	void UnbindWorldDelegates();
+	void OnActorSpawned(AActor* SpawnedActor);
+	void OnActorDestroyed(AActor* DestroyedActor);
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+
 	UPROPERTY()
 	TArray<ACMirror*> WorldMirrors;
+
+	UPROPERTY()
+	FMirrorRenderTargetPool RenderTargetPool;
+
+	UPROPERTY()
+	TArray<UTextureRenderTarget2D*> RegroupReleasedTargets;
+
+	TMirrorCaptureLoop<ACMirror> CaptureLoop;
+	FMirrorQualityController QualityController;
+	uint64 FrameBudgetUpdateFrame = 0;
+	FDelegateHandle PreActorTickHandle;
+	FDelegateHandle PostActorTickHandle;
+	FMirrorPrimitiveIndex PrimitiveIndex;
+	FMirrorAsyncCulling AsyncCulling;
+	FMirrorCameraPathPlayer CameraPathPlayer;
+	FDelegateHandle EndFrameHandle;
+	FDelegateHandle PreGarbageCollectHandle;
+	uint64 PrimitiveIndexUpdateFrame = 0;
+	FMirrorZoneGraph ZoneGraph;
+	uint64 ZoneGraphUpdateFrame = 0;
+	FVector2D ZoneGraphFov = FVector2D::ZeroVector;
+	FDelegateHandle ActorSpawnedHandle;
+	FDelegateHandle ActorDestroyedHandle;
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+	TWeakObjectPtr<UWorld> BoundWorld;
+
+	// Mirrors were added, removed or moved since the coplanar mirrors were last grouped.
+	bool bCaptureGroupsDirty = false;
 };
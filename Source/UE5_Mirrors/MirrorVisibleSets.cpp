@@ -0,0 +1,40 @@
+#include "MirrorVisibleSets.h"
+
+void FMirrorVisibleSets::Reset()
+{
+	CellSize = 0;
+	Actors.Reset();
+	Components.Reset();
+	Cells.Reset();
+}
+
+FIntVector FMirrorVisibleSets::CalcCell(const FTransform& MirrorTransform, const FVector& MirroredCameraLocation) const
+{
+	FVector LocalLocation = MirrorTransform.InverseTransformPositionNoScale(MirroredCameraLocation);
+	LocalLocation.X *= -1;
+
+	return FIntVector(FMath::FloorToInt(LocalLocation.X / CellSize), FMath::FloorToInt(LocalLocation.Y / CellSize),
+	                  FMath::FloorToInt(LocalLocation.Z / CellSize));
+}
+
+void FMirrorVisibleSets::GetActors(const FMirrorVisibleSetCell& Cell, TArray<AActor*>& OutActors) const
+{
+	for (const int32 ActorIndex : Cell.ActorIndices)
+	{
+		if (AActor* Actor = Actors[ActorIndex].Get())
+		{
+			OutActors.Add(Actor);
+		}
+	}
+}
+
+void FMirrorVisibleSets::GetComponents(const FMirrorVisibleSetCell& Cell, TArray<UPrimitiveComponent*>& OutComponents) const
+{
+	for (const int32 ComponentIndex : Cell.ComponentIndices)
+	{
+		if (UPrimitiveComponent* Component = Components[ComponentIndex].Get())
+		{
+			OutComponents.Add(Component);
+		}
+	}
+}
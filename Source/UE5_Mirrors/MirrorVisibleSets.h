@@ -0,0 +1,76 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "MirrorVisibleSets.generated.h"
+
+USTRUCT()
+struct FMirrorVisibleSetCell
+{
+	GENERATED_BODY()
+
+	// Indices into FMirrorVisibleSets::Actors.
+	UPROPERTY()
+	TArray<int32> ActorIndices;
+
+	// Indices into FMirrorVisibleSets::Components.
+	UPROPERTY()
+	TArray<int32> ComponentIndices;
+};
+
+// Static actors that can appear in a mirror, baked in the editor for each cell of camera locations in front of it.
+// Mirrors culling per component bake the visible static components instead of their actors.
+// Cells are in the mirror's local space, so moving the mirror keeps the cells but makes the sets stale.
+USTRUCT()
+struct UE5_MIRRORS_API FMirrorVisibleSets
+{
+	GENERATED_BODY()
+
+	void Reset();
+	bool IsBaked() const { return CellSize > 0; }
+
+	// Cell of the unmirrored camera for a mirrored camera location.
+	FIntVector CalcCell(const FTransform& MirrorTransform, const FVector& MirroredCameraLocation) const;
+
+	// Null for cells outside the baked region.
+	const FMirrorVisibleSetCell* FindCell(const FIntVector& Cell) const { return Cells.Find(Cell); }
+
+	// Adds the cell's actors that are loaded.
+	void GetActors(const FMirrorVisibleSetCell& Cell, TArray<AActor*>& OutActors) const;
+
+	// Adds the cell's components that are loaded.
+	void GetComponents(const FMirrorVisibleSetCell& Cell, TArray<UPrimitiveComponent*>& OutComponents) const;
+
+	// Bake helper. Adds the index of every object to OutIndices, storing the objects that aren't stored yet.
+	template <typename ObjectType>
+	static void AddIndices(const TSet<ObjectType*>& Objects, TArray<TSoftObjectPtr<ObjectType>>& StoredObjects,
+	                       TMap<ObjectType*, int32>& StoredIndices, TArray<int32>& OutIndices)
+	{
+		OutIndices.Reserve(OutIndices.Num() + Objects.Num());
+		for (ObjectType* Object : Objects)
+		{
+			const int32* Index = StoredIndices.Find(Object);
+			if (!Index)
+			{
+				Index = &StoredIndices.Add(Object, StoredObjects.Add(Object));
+			}
+
+			OutIndices.Add(*Index);
+		}
+	}
+
+	// Edge length of the cells in centimeters. 0 while nothing is baked.
+	UPROPERTY()
+	float CellSize = 0;
+
+	// Every actor in any cell, stored once. Soft references, so actors in other streaming levels can be part of the sets.
+	UPROPERTY()
+	TArray<TSoftObjectPtr<AActor>> Actors;
+
+	// Every component in any cell, stored once.
+	UPROPERTY()
+	TArray<TSoftObjectPtr<UPrimitiveComponent>> Components;
+
+	UPROPERTY()
+	TMap<FIntVector, FMirrorVisibleSetCell> Cells;
+};
@@ -0,0 +1,149 @@
+#include "MirrorZoneGraph.h"
+#include "MirrorPortal.h"
+#include "MirrorZoneVolume.h"
+#include "Components/BoxComponent.h"
+
+void FMirrorZoneGraph::AddZone(AMirrorZoneVolume* Zone)
+{
+	Zones.AddUnique(Zone);
+	MirrorZones.Reset();
+}
+
+void FMirrorZoneGraph::RemoveZone(AMirrorZoneVolume* Zone)
+{
+	Zones.Remove(Zone);
+	VisibleZones.Remove(Zone);
+	MirrorZones.Reset();
+	if (ViewerZone == Zone)
+	{
+		ViewerZone.Reset();
+	}
+}
+
+void FMirrorZoneGraph::AddPortal(AMirrorPortal* Portal)
+{
+	Portals.AddUnique(Portal);
+}
+
+void FMirrorZoneGraph::RemovePortal(AMirrorPortal* Portal)
+{
+	Portals.Remove(Portal);
+}
+
+void FMirrorZoneGraph::Reset()
+{
+	Zones.Reset();
+	Portals.Reset();
+	VisibleZones.Reset();
+	ViewerZone.Reset();
+	MirrorZones.Reset();
+}
+
+void FMirrorZoneGraph::Update(const FVector& ViewLocation, const FVector& ViewDirection, const FVector2D& FovDegrees,
+                              const int32 MaxPortalDepth)
+{
+	VisibleZones.Reset();
+
+	// The viewer usually stays in the same zone, so that one is tested first.
+	AMirrorZoneVolume* CurrentZone = ViewerZone.Get();
+	if (!CurrentZone || !CurrentZone->EncompassesPoint(ViewLocation))
+	{
+		CurrentZone = FindZone(ViewLocation);
+		ViewerZone = CurrentZone;
+	}
+
+	if (!CurrentZone)
+	{
+		return;
+	}
+
+	// Half angle of the cone around the view frustum, measured to the frustum's corners.
+	const float HalfFovTanX = FMath::Tan(FMath::DegreesToRadians(FovDegrees.X) / 2);
+	const float HalfFovTanY = FMath::Tan(FMath::DegreesToRadians(FovDegrees.Y) / 2);
+	const float ViewHalfAngle = FMath::Atan(FMath::Sqrt(FMath::Square(HalfFovTanX) + FMath::Square(HalfFovTanY)));
+
+	VisibleZones.Add(CurrentZone);
+	TArray<const AMirrorZoneVolume*, TInlineAllocator<8>> Frontier;
+	TArray<const AMirrorZoneVolume*, TInlineAllocator<8>> NextFrontier;
+	Frontier.Add(CurrentZone);
+
+	// Portals further away are tested against the whole view, not just the part seen through the nearer portals, so this errs on the visible side.
+	for (int32 Depth = 0; Depth < MaxPortalDepth && Frontier.Num() > 0; Depth++)
+	{
+		NextFrontier.Reset();
+		for (const TWeakObjectPtr<AMirrorPortal>& PortalPtr : Portals)
+		{
+			const AMirrorPortal* Portal = PortalPtr.Get();
+			if (!Portal || !Portal->ZoneA || !Portal->ZoneB)
+			{
+				continue;
+			}
+
+			const AMirrorZoneVolume* OtherZone = nullptr;
+			if (Frontier.Contains(Portal->ZoneA))
+			{
+				OtherZone = Portal->ZoneB;
+			}
+			else if (Frontier.Contains(Portal->ZoneB))
+			{
+				OtherZone = Portal->ZoneA;
+			}
+
+			if (OtherZone && !VisibleZones.Contains(OtherZone) &&
+				IsPortalInView(Portal, ViewLocation, ViewDirection, ViewHalfAngle))
+			{
+				VisibleZones.Add(OtherZone);
+				NextFrontier.Add(OtherZone);
+			}
+		}
+
+		Swap(Frontier, NextFrontier);
+	}
+}
+
+bool FMirrorZoneGraph::IsMirrorPotentiallyVisible(const AActor* Mirror)
+{
+	if (!ViewerZone.IsValid() || !Mirror)
+	{
+		return true;
+	}
+
+	const TWeakObjectPtr<AMirrorZoneVolume>* MirrorZone = MirrorZones.Find(Mirror);
+	if (!MirrorZone)
+	{
+		// Mirrors often sit right on a zone's wall, so the point just in front of the surface decides.
+		MirrorZone = &MirrorZones.Add(Mirror, FindZone(Mirror->GetActorLocation() + Mirror->GetActorForwardVector() * 10));
+	}
+
+	return !MirrorZone->IsValid() || VisibleZones.Contains(MirrorZone->Get());
+}
+
+AMirrorZoneVolume* FMirrorZoneGraph::FindZone(const FVector& Location) const
+{
+	for (const TWeakObjectPtr<AMirrorZoneVolume>& Zone : Zones)
+	{
+		if (Zone.IsValid() && Zone->EncompassesPoint(Location))
+		{
+			return Zone.Get();
+		}
+	}
+
+	return nullptr;
+}
+
+bool FMirrorZoneGraph::IsPortalInView(const AMirrorPortal* Portal, const FVector& ViewLocation,
+                                      const FVector& ViewDirection, const float ViewHalfAngle)
+{
+	const FBoxSphereBounds& Bounds = Portal->PortalBounds->Bounds;
+	const FVector ToPortal = Bounds.Origin - ViewLocation;
+	const float Distance = ToPortal.Size();
+	if (Distance <= Bounds.SphereRadius)
+	{
+		return true;
+	}
+
+	// Sphere against view cone. The portal is in view if its angular radius reaches into the cone.
+	const float Angle = FMath::Acos(FMath::Clamp(ToPortal.Dot(ViewDirection) / Distance, -1.f, 1.f));
+	const float AngularRadius = FMath::Asin(Bounds.SphereRadius / Distance);
+	return Angle - AngularRadius <= ViewHalfAngle;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+class AMirrorPortal;
+class AMirrorZoneVolume;
+
+// Rooms and the portals between them. Finds the zones that can be seen from the viewer's zone, so mirrors in every other zone can skip their captures.
+class UE5_MIRRORS_API FMirrorZoneGraph
+{
+public:
+	void AddZone(AMirrorZoneVolume* Zone);
+	void RemoveZone(AMirrorZoneVolume* Zone);
+	void AddPortal(AMirrorPortal* Portal);
+	void RemovePortal(AMirrorPortal* Portal);
+	void Reset();
+
+	bool IsEmpty() const { return Zones.Num() == 0; }
+
+	// Finds the viewer's zone and walks through the portals in view, up to MaxPortalDepth portals away.
+	// FovDegrees holds the view's horizontal and vertical field of view.
+	void Update(const FVector& ViewLocation, const FVector& ViewDirection, const FVector2D& FovDegrees,
+	            int32 MaxPortalDepth);
+
+	// False only if the mirror is in a zone that can't be seen from the viewer's zone. Mirrors outside every zone,
+	// and every mirror while the viewer is outside all zones, count as visible. A mirror's zone is looked up once, so mirrors are expected to stay in place.
+	bool IsMirrorPotentiallyVisible(const AActor* Mirror);
+
+	AMirrorZoneVolume* FindZone(const FVector& Location) const;
+
+private:
+	static bool IsPortalInView(const AMirrorPortal* Portal, const FVector& ViewLocation, const FVector& ViewDirection,
+	                           float ViewHalfAngle);
+
+	TArray<TWeakObjectPtr<AMirrorZoneVolume>> Zones;
+	TArray<TWeakObjectPtr<AMirrorPortal>> Portals;
+	TSet<TObjectKey<AMirrorZoneVolume>> VisibleZones;
+	TWeakObjectPtr<AMirrorZoneVolume> ViewerZone;
+
+	// Zone of each mirror asked about, null for mirrors outside every zone. Cleared whenever zones change.
+	TMap<TObjectKey<AActor>, TWeakObjectPtr<AMirrorZoneVolume>> MirrorZones;
+};
@@ -0,0 +1,54 @@
+#include "MirrorZoneGraph.h"
+#include "MirrorZoneVolume.h"
+#include "Components/BrushComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+#include "PhysicsEngine/BodySetup.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMirrorZoneGraphFindZoneTest, "UE5_Mirrors.Zones.FindZone",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMirrorZoneGraphFindZoneTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	// Zones are 400 cm cubes around their location. Levels get their brush from the editor, here it's made by hand.
+	auto SpawnZone = [World](const FVector& Location)
+	{
+		const FTransform ZoneTransform(Location);
+		AMirrorZoneVolume* Zone = World->SpawnActorDeferred<AMirrorZoneVolume>(AMirrorZoneVolume::StaticClass(),
+		                                                                        ZoneTransform);
+		UBrushComponent* Brush = Zone->GetBrushComponent();
+		Brush->BrushBodySetup = NewObject<UBodySetup>(Brush);
+		Brush->BrushBodySetup->AggGeom.BoxElems.Add(FKBoxElem(400));
+		Brush->BrushBodySetup->CreatePhysicsMeshes();
+		Zone->FinishSpawning(ZoneTransform);
+		return Zone;
+	};
+
+	AMirrorZoneVolume* Zone = SpawnZone(FVector(1000, 0, 0));
+	AMirrorZoneVolume* OtherZone = SpawnZone(FVector(-5000, 0, 0));
+
+	FMirrorZoneGraph ZoneGraph;
+	ZoneGraph.AddZone(Zone);
+	ZoneGraph.AddZone(OtherZone);
+	TestTrue(TEXT("Point inside the zone finds it"), ZoneGraph.FindZone(FVector(1100, 50, -50)) == Zone);
+	TestNull(TEXT("Point outside every zone finds none"), ZoneGraph.FindZone(FVector(1500, 0, 0)));
+
+	// Any actor stands in for a mirror, the zone volumes themselves sit inside their zones.
+	ZoneGraph.Update(FVector(1000, 0, 0), FVector::ForwardVector, FVector2D(90, 60), 2);
+	TestTrue(TEXT("Mirror in the viewer's zone is visible"), ZoneGraph.IsMirrorPotentiallyVisible(Zone));
+	TestFalse(TEXT("Mirror in an unconnected zone is hidden"), ZoneGraph.IsMirrorPotentiallyVisible(OtherZone));
+
+	ZoneGraph.Reset();
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
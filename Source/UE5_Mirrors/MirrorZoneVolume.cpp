@@ -0,0 +1,38 @@
+#include "MirrorZoneVolume.h"
+#include "MirrorSubsystem.h"
+#include "Components/BrushComponent.h"
+#include "Engine/CollisionProfile.h"
+
+AMirrorZoneVolume::AMirrorZoneVolume()
+{
+	// Zones are only ever tested against points, they don't need overlap events. The point test still needs the brush's body.
+	GetBrushComponent()->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+	GetBrushComponent()->SetGenerateOverlapEvents(false);
+	GetBrushComponent()->bAlwaysCreatePhysicsState = true;
+}
+
+void AMirrorZoneVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (const UGameInstance* GameInstance = GetGameInstance())
+	{
+		if (UMirrorSubsystem* MirrorSubsystem = GameInstance->GetSubsystem<UMirrorSubsystem>())
+		{
+			MirrorSubsystem->RegisterZone(this);
+		}
+	}
+}
+
+void AMirrorZoneVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (const UGameInstance* GameInstance = GetGameInstance())
+	{
+		if (UMirrorSubsystem* MirrorSubsystem = GameInstance->GetSubsystem<UMirrorSubsystem>())
+		{
+			MirrorSubsystem->UnregisterZone(this);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Volume.h"
+#include "MirrorZoneVolume.generated.h"
+
+// A room for mirror capture gating. Mirrors inside it only capture while the camera is in the room or can see into it through an AMirrorPortal.
+UCLASS()
+class UE5_MIRRORS_API AMirrorZoneVolume : public AVolume
+{
+	GENERATED_BODY()
+
+public:
+	AMirrorZoneVolume();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+};
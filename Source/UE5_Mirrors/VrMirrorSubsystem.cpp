@@ -1,34 +1,47 @@
 #include "VrMirrorSubsystem.h"
 #include "CVrMirror.h"
+#include "MirrorSubsystem.h"
+#include "MirrorScratchBuffers.h"
+#include "MirrorStats.h"
+#include "Components/PrimitiveComponent.h"
 #include "Components/SceneCaptureComponent2D.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
 
-void UVrMirrorSubsystem::OnMirrorCreated(ACVrMirror* NewMirror)
+void UVrMirrorSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
-	WorldMirrors.Add(NewMirror);
-	NewMirror->SceneCaptureLeftEye->HiddenActors.Append(WorldMirrors);
-	NewMirror->SceneCaptureRightEye->HiddenActors.Append(WorldMirrors);
+	Super::Initialize(Collection);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UVrMirrorSubsystem::OnWorldPostActorTick);
 
-	for (const auto Mirror : WorldMirrors)
+	// Camera path replays are run by UMirrorSubsystem and view the level through a camera of their own.
+	if (UMirrorSubsystem* MirrorSubsystem = Collection.InitializeDependency<UMirrorSubsystem>())
 	{
-		if (Mirror)
-		{
-			Mirror->SceneCaptureLeftEye->HiddenActors.AddUnique(NewMirror);
-			Mirror->SceneCaptureRightEye->HiddenActors.AddUnique(NewMirror);
-		}
+		ViewCameraChangedHandle = MirrorSubsystem->GetCameraPathPlayer().OnViewCameraChanged.AddUObject(
+			this, &UVrMirrorSubsystem::UpdateActiveCamera);
 	}
 }
 
-void UVrMirrorSubsystem::OnMirrorDestroyed(ACVrMirror* DestroyedMirror)
+void UVrMirrorSubsystem::Deinitialize()
 {
-	WorldMirrors.Remove(DestroyedMirror);
-	for (const auto Mirror : WorldMirrors)
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	if (UMirrorSubsystem* MirrorSubsystem = GetGameInstance()->GetSubsystem<UMirrorSubsystem>())
 	{
-		if (Mirror)
-		{
-			Mirror->SceneCaptureLeftEye->HiddenActors.Remove(DestroyedMirror);
-			Mirror->SceneCaptureRightEye->HiddenActors.Remove(DestroyedMirror);
-		}
+		MirrorSubsystem->GetCameraPathPlayer().OnViewCameraChanged.Remove(ViewCameraChangedHandle);
 	}
+	CaptureLoop.Reset();
+	RenderTargetPool.Empty();
+	Super::Deinitialize();
+}
+
+void UVrMirrorSubsystem::OnMirrorCreated(ACVrMirror* NewMirror)
+{
+	// Mirror meshes are hidden in all scene captures, so registering doesn't touch the other mirrors.
+	WorldMirrors.Add(NewMirror);
+}
+
+void UVrMirrorSubsystem::OnMirrorDestroyed(ACVrMirror* DestroyedMirror)
+{
+	WorldMirrors.RemoveSingleSwap(DestroyedMirror);
 }
 
 void UVrMirrorSubsystem::DestroyAllMirrors()
@@ -63,9 +76,128 @@ void UVrMirrorSubsystem::UpdateActiveCamera(UCameraComponent* NewActiveCamera) c
 			Mirror->Init();
 		}
 	}
+}
+
+UTextureRenderTarget2D* UVrMirrorSubsystem::AcquireRenderTarget(const int32 Width, const int32 Height)
+{
+	return RenderTargetPool.Acquire(this, Width, Height);
+}
+
+void UVrMirrorSubsystem::ReleaseRenderTarget(UTextureRenderTarget2D* RenderTarget)
+{
+	RenderTargetPool.MaxFreeTargets = MaxPooledRenderTargets;
+	RenderTargetPool.Release(RenderTarget);
+}
+
+void UVrMirrorSubsystem::QueueEvaluation(ACVrMirror* Mirror)
+{
+	CaptureLoop.QueueEvaluation(Mirror);
+}
+
+void UVrMirrorSubsystem::RequestCapture(const FMirrorCaptureRequest& Request)
+{
+	CaptureLoop.RequestCapture(Request);
+}
+
+void UVrMirrorSubsystem::SetCaptureBudget(const int32 NewMaxCapturesPerFrame, const float NewMaxCaptureCostPerFrame)
+{
+	MaxCapturesPerFrame = FMath::Max(NewMaxCapturesPerFrame, 0);
+	MaxCaptureCostPerFrame = FMath::Max(NewMaxCaptureCostPerFrame, 0.f);
+}
+
+void UVrMirrorSubsystem::OnUnchangedCaptureSkipped()
+{
+	CaptureLoop.OnUnchangedCaptureSkipped();
+}
+
+float UVrMirrorSubsystem::GetFrameBudgetQualityScale() const
+{
+	return FrameBudgetQualityScale;
+}
+
+int32 UVrMirrorSubsystem::GetNumDeferredCaptures() const
+{
+	return CaptureLoop.GetNumDeferredCaptures();
+}
+
+int32 UVrMirrorSubsystem::GetNumUnchangedCaptureSkips() const
+{
+	return CaptureLoop.GetNumUnchangedCaptureSkips();
+}
+
+int32 UVrMirrorSubsystem::GetNumAllocatingCaptures() const
+{
+	return FMirrorAllocationCounter::GetNumAllocatingCaptures();
+}
+
+void UVrMirrorSubsystem::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	// Mirrors tick in TG_PostUpdateWork, after the camera has been updated, so every request for this frame is in by now.
+	if (World && World->GetGameInstance() == GetGameInstance())
+	{
+		if (UMirrorSubsystem* MirrorSubsystem = GetGameInstance()->GetSubsystem<UMirrorSubsystem>())
+		{
+			MirrorSubsystem->GetCameraPathPlayer().Update(World);
+		}
+
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		ExecuteCaptureRequests();
+		FMirrorStats::AddMirrorTime(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+	}
+}
 
-	if (GEngine)
+void UVrMirrorSubsystem::UpdateFrameBudget()
+{
+	// One frame time, one quality controller. It lives in UMirrorSubsystem, whichever subsystem flushes first updates it.
+	UMirrorSubsystem* MirrorSubsystem = GetGameInstance()->GetSubsystem<UMirrorSubsystem>();
+	if (!MirrorSubsystem)
 	{
-		GEngine->ForceGarbageCollection();
+		return;
 	}
+
+	FrameBudgetQualityScale = MirrorSubsystem->UpdateFrameBudget();
+	TMirrorCaptureLoop<ACVrMirror>::SetFrameBudgetScale(WorldMirrors, FrameBudgetQualityScale);
+}
+
+void UVrMirrorSubsystem::ExecuteCaptureRequests()
+{
+	UpdateFrameBudget();
+
+	FMirrorCaptureBudget Budget;
+	Budget.MaxCaptures = MaxCapturesPerFrame;
+	Budget.MaxCost = MaxCaptureCostPerFrame;
+	Budget.StalenessWeight = CaptureStalenessWeight;
+	CaptureLoop.Execute(Budget, FrameBudgetQualityScale, MirrorsPerEvaluationTask);
+	TMirrorCaptureLoop<ACVrMirror>::AddRenderTargetStats(WorldMirrors, RenderTargetPool);
+}
+
+FMirrorPrimitiveIndex* UVrMirrorSubsystem::GetPrimitiveIndex(UWorld* World) const
+{
+	UMirrorSubsystem* MirrorSubsystem = GetGameInstance()->GetSubsystem<UMirrorSubsystem>();
+	return MirrorSubsystem ? MirrorSubsystem->GetPrimitiveIndex(World) : nullptr;
+}
+
+bool UVrMirrorSubsystem::IsMirrorInVisibleZone(const AActor* Mirror, const FTransform& ViewTransform,
+                                               const FVector2D& FovDegrees) const
+{
+	UMirrorSubsystem* MirrorSubsystem = GetGameInstance()->GetSubsystem<UMirrorSubsystem>();
+	return !MirrorSubsystem || MirrorSubsystem->IsMirrorInVisibleZone(Mirror, ViewTransform, FovDegrees);
+}
+
+bool UVrMirrorSubsystem::WasRecentlyRendered(const UPrimitiveComponent* Surface) const
+{
+	const UMirrorSubsystem* MirrorSubsystem = GetGameInstance()->GetSubsystem<UMirrorSubsystem>();
+	return MirrorSubsystem ? MirrorSubsystem->WasRecentlyRendered(Surface) : Surface->WasRecentlyRendered();
+}
+
+FMirrorCullingQuery* UVrMirrorSubsystem::QueueAsyncCulling(const AActor* Mirror) const
+{
+	UMirrorSubsystem* MirrorSubsystem = GetGameInstance()->GetSubsystem<UMirrorSubsystem>();
+	return MirrorSubsystem ? &MirrorSubsystem->QueueAsyncCulling(Mirror) : nullptr;
+}
+
+const FMirrorCullingQuery* UVrMirrorSubsystem::GetAsyncCullingResult(const AActor* Mirror) const
+{
+	UMirrorSubsystem* MirrorSubsystem = GetGameInstance()->GetSubsystem<UMirrorSubsystem>();
+	return MirrorSubsystem ? MirrorSubsystem->GetAsyncCullingResult(Mirror) : nullptr;
 }
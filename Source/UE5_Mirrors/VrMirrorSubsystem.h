@@ -1,21 +1,53 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "MirrorCaptureLoop.h"
+#include "MirrorRenderTargetPool.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "VrMirrorSubsystem.generated.h"
 
 class UCameraComponent;
+class UPrimitiveComponent;
 class ACVrMirror;
+class FMirrorPrimitiveIndex;
+struct FMirrorCullingQuery;
 
-UCLASS()
+UCLASS(Config=Game)
 class UE5_MIRRORS_API UVrMirrorSubsystem : public UGameInstanceSubsystem
 {
 	GENERATED_BODY()
 
 public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
 	void OnMirrorCreated(ACVrMirror* NewMirror);
 	void OnMirrorDestroyed(ACVrMirror* DestroyedMirror);
 
+	// VR mirrors are evaluated, ranked and captured like the regular ones, but in their own loop with their own capture budget.
+	void QueueEvaluation(ACVrMirror* Mirror);
+
+	void RequestCapture(const FMirrorCaptureRequest& Request);
+
+	// The eye render targets are pooled apart from the regular mirrors' targets.
+	UTextureRenderTarget2D* AcquireRenderTarget(int32 Width, int32 Height);
+	void ReleaseRenderTarget(UTextureRenderTarget2D* RenderTarget);
+
+	void OnUnchangedCaptureSkipped();
+
+	// The primitive index is shared with the regular mirrors and owned by UMirrorSubsystem.
+	FMirrorPrimitiveIndex* GetPrimitiveIndex(UWorld* World) const;
+
+	// The zone graph is shared with the regular mirrors and owned by UMirrorSubsystem.
+	bool IsMirrorInVisibleZone(const AActor* Mirror, const FTransform& ViewTransform, const FVector2D& FovDegrees) const;
+
+	// Camera path replays are run by UMirrorSubsystem, which also decides whether a surface counts as rendered during one.
+	bool WasRecentlyRendered(const UPrimitiveComponent* Surface) const;
+
+	// Async culling runs on the shared primitive index, so its queries are queued with UMirrorSubsystem too. Null without it.
+	FMirrorCullingQuery* QueueAsyncCulling(const AActor* Mirror) const;
+	const FMirrorCullingQuery* GetAsyncCullingResult(const AActor* Mirror) const;
+
 protected:
 	UFUNCTION(BlueprintCallable)
 	void UpdateActiveCamera(UCameraComponent* NewActiveCamera) const;
@@ -23,7 +55,56 @@ protected:
 	UFUNCTION(BlueprintCallable)
 	void DestroyAllMirrors();
 
+	UFUNCTION(BlueprintCallable)
+	void SetCaptureBudget(int32 NewMaxCapturesPerFrame, float NewMaxCaptureCostPerFrame);
+
+	// Current quality scale of the frame budget UMirrorSubsystem runs for all mirrors.
+	UFUNCTION(BlueprintCallable)
+	float GetFrameBudgetQualityScale() const;
+
+	// Last frame's deferred captures and unchanged skips of the VR mirrors alone.
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumDeferredCaptures() const;
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumUnchangedCaptureSkips() const;
+
+	// Counted across both mirror types, the same as UMirrorSubsystem's.
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumAllocatingCaptures() const;
+
+	// Capture budget of the VR mirrors, kept apart from the regular mirrors' so a headset can be given fewer captures.
+	// A stereoscopic mirror counts as a single capture. 0 for unlimited.
+	UPROPERTY(Config, BlueprintReadOnly)
+	int32 MaxCapturesPerFrame = 2;
+
+	// Both eyes' megapixels count towards a stereoscopic mirror's cost.
+	UPROPERTY(Config, BlueprintReadOnly)
+	float MaxCaptureCostPerFrame = 0;
+
+	UPROPERTY(Config, BlueprintReadOnly)
+	float CaptureStalenessWeight = 4;
+
+	// Sized for eye render targets, which are usually larger than the regular mirrors'.
+	UPROPERTY(Config, BlueprintReadOnly)
+	int32 MaxPooledRenderTargets = 8;
+
+	UPROPERTY(Config, BlueprintReadOnly)
+	int32 MirrorsPerEvaluationTask = 8;
+
 private:
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void ExecuteCaptureRequests();
+	void UpdateFrameBudget();
+
 	UPROPERTY()
 	TArray<ACVrMirror*> WorldMirrors;
+
+	UPROPERTY()
+	FMirrorRenderTargetPool RenderTargetPool;
+
+	TMirrorCaptureLoop<ACVrMirror> CaptureLoop;
+	float FrameBudgetQualityScale = 1;
+	FDelegateHandle PostActorTickHandle;
+	FDelegateHandle ViewCameraChangedHandle;
 };